@@ -1,593 +1,1922 @@
-﻿#include "headers.h"
-#include "trianglemesh.h"
-#include "camera.h"
-#include "shaderprog.h"
-#include "light.h"
-#include "imagetexture.h"
-#include "skybox.h"
-
-
-// Global variables.
-int screenWidth = 600;
-int screenHeight = 600;
-// Triangle mesh.
-TriangleMesh* mesh = nullptr;
-// Lights.
-DirectionalLight* dirLight = nullptr;
-PointLight* pointLight = nullptr;
-SpotLight* spotLight = nullptr;
-glm::vec3 dirLightDirection = glm::vec3(0.0f, 0.0f, -1.0f);
-glm::vec3 dirLightRadiance = glm::vec3(0.6f, 0.6f, 0.6f);
-glm::vec3 pointLightPosition = glm::vec3(0.8f, 0.0f, 0.8f);
-glm::vec3 pointLightIntensity = glm::vec3(0.1f, 0.1f, 0.1f);
-glm::vec3 spotLightPosition = glm::vec3(0.0f, 1.0f, 1.0f);
-glm::vec3 spotLightDirection = glm::vec3(0.0f, -1.0f, -1.0f);
-glm::vec3 spotLightIntensity = glm::vec3(0.3f, 0.3f, 0.3f);
-float spotLightCutoffStartInDegree = 30.0f;
-float spotLightTotalWidthInDegree = 45.0f;
-glm::vec3 ambientLight = glm::vec3(0.2f, 0.2f, 0.2f);
-// Camera.
-Camera* camera = nullptr;
-glm::vec3 cameraPos = glm::vec3(0.0f, 1.0f, 5.0f);
-glm::vec3 cameraTarget = glm::vec3(0.0f, 0.0f, 0.0f);
-glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
-float fovy = 30.0f;
-float zNear = 0.1f;
-float zFar = 1000.0f;
-// Shader.
-FillColorShaderProg* fillColorShader = nullptr;
-PhongShadingDemoShaderProg* phongShadingShader = nullptr;
-SkyboxShaderProg* skyboxShader = nullptr;
-// UI.
-const float lightMoveSpeed = 0.2f;
-// Skybox.
-Skybox* skybox = nullptr;
-// Rotate.
-bool rotSkybox = false;
-bool rotModel = false;
-
-// SceneObject.
-struct SceneObject
-{
-    SceneObject() {
-        mesh = nullptr;
-        worldMatrix = glm::mat4x4(1.0f);
-    }
-    TriangleMesh* mesh;
-    glm::mat4x4 worldMatrix;
-};
-SceneObject sceneObj;
-
-// ScenePointLight (for visualization of a point light).
-struct ScenePointLight
-{
-    ScenePointLight() {
-        light = nullptr;
-        worldMatrix = glm::mat4x4(1.0f);
-        visColor = glm::vec3(1.0f, 1.0f, 1.0f);
-    }
-    PointLight* light;
-    glm::mat4x4 worldMatrix;
-    glm::vec3 visColor;
-};
-ScenePointLight pointLightObj;
-ScenePointLight spotLightObj;
-
-// Function prototypes.
-void ReleaseResources();
-// Callback functions.
-void RenderSceneCB();
-void ReshapeCB(int, int);
-void ProcessSpecialKeysCB(int, int, int);
-void ProcessKeysCB(unsigned char, int, int);
-void SetupRenderState();
-void LoadObjects(const std::string&);
-void CreateCamera();
-void CreateSkybox(const std::string);
-void CreateShaderLib();
-
-
-
-void ReleaseResources()
-{
-    // Delete scene objects and lights.
-    if (mesh != nullptr) {
-        delete mesh;
-        mesh = nullptr;
-    }
-    if (pointLight != nullptr) {
-        delete pointLight;
-        pointLight = nullptr;
-    }
-    if (dirLight != nullptr) {
-        delete dirLight;
-        dirLight = nullptr;
-    }
-    if (spotLight != nullptr) {
-        delete spotLight;
-        spotLight = nullptr;
-    }
-    // Delete camera.
-    if (camera != nullptr) {
-        delete camera;
-        camera = nullptr;
-    }
-    // Delete shaders.
-    if (fillColorShader != nullptr) {
-        delete fillColorShader;
-        fillColorShader = nullptr;
-    }
-    if (phongShadingShader != nullptr) {
-        delete phongShadingShader;
-        phongShadingShader = nullptr;
-    }
-    if (skyboxShader != nullptr) {
-        delete skyboxShader;
-        skyboxShader = nullptr;
-    }
-}
-
-static float curObjRotationY = 0.0f;
-static float curSkyboxRotationY = 249.0f;
-const float rotStep = 0.005f;
-bool objClockwise = true;
-bool skyboxClockwise = true;
-void RenderSceneCB()
-{
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    
-    TriangleMesh* pMesh = sceneObj.mesh;
-    if (pMesh != nullptr) {
-        // Update transform.
-        if (rotModel) {
-            if (objClockwise){                
-                 curObjRotationY += rotStep;
-            }
-            else{
-                curObjRotationY -= rotStep;
-            }
-        }
-        glm::mat4x4 S = glm::scale(glm::mat4x4(1.0f), glm::vec3(1.5f, 1.5f, 1.5f));
-        glm::mat4x4 R = glm::rotate(glm::mat4x4(1.0f), glm::radians(curObjRotationY), glm::vec3(0, 1, 0));
-        sceneObj.worldMatrix = S * R;
-        // -------------------------------------------------------
-		// Note: if you want to compute lighting in the View Space, 
-        //       you might need to change the code below.
-		// -------------------------------------------------------
-        glm::mat4x4 normalMatrix = glm::transpose(glm::inverse(camera->GetViewMatrix() * sceneObj.worldMatrix));
-        glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * sceneObj.worldMatrix;
-        
-        // -------------------------------------------------------
-        phongShadingShader->Bind();
-        // Transformation matrix.
-        glUniformMatrix4fv(phongShadingShader->GetLocM(), 1, GL_FALSE, glm::value_ptr(sceneObj.worldMatrix));
-        glUniformMatrix4fv(phongShadingShader->GetLocNM(), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-        glUniformMatrix4fv(phongShadingShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
-        glUniform3fv(phongShadingShader->GetLocCameraPos(), 1, glm::value_ptr(camera->GetCameraPos()));
-        for (const auto& subMesh : mesh->GetSubMeshes()) {
-            // Material properties.
-            glUniform3fv(phongShadingShader->GetLocKa(), 1, glm::value_ptr(subMesh.material->GetKa()));
-            glUniform3fv(phongShadingShader->GetLocKd(), 1, glm::value_ptr(subMesh.material->GetKd()));
-            glUniform3fv(phongShadingShader->GetLocKs(), 1, glm::value_ptr(subMesh.material->GetKs()));
-            glUniform1f(phongShadingShader->GetLocNs(), subMesh.material->GetNs());
-            // Light data.
-            if (dirLight != nullptr) {
-                glUniform3fv(phongShadingShader->GetLocDirLightDir(), 1, glm::value_ptr(dirLight->GetDirection()));
-                glUniform3fv(phongShadingShader->GetLocDirLightRadiance(), 1, glm::value_ptr(dirLight->GetRadiance()));
-            }
-            if (pointLight != nullptr) {
-                glUniform3fv(phongShadingShader->GetLocPointLightPos(), 1, glm::value_ptr(pointLight->GetPosition()));
-                glUniform3fv(phongShadingShader->GetLocPointLightIntensity(), 1, glm::value_ptr(pointLight->GetIntensity()));
-            }
-            if (spotLight != nullptr) {
-                glUniform3fv(phongShadingShader->GetLocSpotLightPos(), 1, glm::value_ptr(spotLight->GetPosition()));
-                glUniform3fv(phongShadingShader->GetLocSpotLightDir(), 1, glm::value_ptr(spotLight->GetDirection()));
-                glUniform3fv(phongShadingShader->GetLocSpotLightIntensity(), 1, glm::value_ptr(spotLight->GetIntensity()));
-                glUniform1f(phongShadingShader->GetLocSpotLightTotalWidth(), spotLight->GetTotalWidth());
-                glUniform1f(phongShadingShader->GetLocSpotLightCutoffStart(), spotLight->GetCutoffStart());
-            }
-            glUniform3fv(phongShadingShader->GetLocAmbientLight(), 1, glm::value_ptr(ambientLight));
-            if (subMesh.material->GetMapKd() != nullptr) {
-                subMesh.material->GetMapKd()->Bind(GL_TEXTURE0);
-                glUniform1i(phongShadingShader->GetLocMapKd(), 0);
-                glUniform1i(phongShadingShader->GetLocExist(), 1);
-            }
-            else {
-                glUniform1i(phongShadingShader->GetLocExist(), 0);
-            }
-
-            mesh->RenderSubMesh(subMesh);
-        }
-        phongShadingShader->UnBind();
-        // -------------------------------------------------------
-    }
-    // -------------------------------------------------------------------------------------------
-
-    // Visualize the light with fill color. ------------------------------------------------------
-    PointLight* pointLight = pointLightObj.light;
-    if (pointLight != nullptr) {
-        glm::mat4x4 T = glm::translate(glm::mat4x4(1.0f), pointLight->GetPosition());
-        pointLightObj.worldMatrix = T;
-        glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * pointLightObj.worldMatrix;
-        fillColorShader->Bind();
-        glUniformMatrix4fv(fillColorShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
-        glUniform3fv(fillColorShader->GetLocFillColor(), 1, glm::value_ptr(pointLightObj.visColor));
-        // Render the point light.
-        pointLight->Draw();
-        fillColorShader->UnBind();
-    }
-    SpotLight* spotLight = (SpotLight*)(spotLightObj.light);
-    if (spotLight != nullptr) {
-        glm::mat4x4 T = glm::translate(glm::mat4x4(1.0f), spotLight->GetPosition());
-        spotLightObj.worldMatrix = T;
-        glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * spotLightObj.worldMatrix;
-        fillColorShader->Bind();
-        glUniformMatrix4fv(fillColorShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
-        glUniform3fv(fillColorShader->GetLocFillColor(), 1, glm::value_ptr(spotLightObj.visColor));
-        // Render the spot light.
-        spotLight->Draw();
-        fillColorShader->UnBind();
-    }
-    // -------------------------------------------------------------------------------------------
-
-    // Render skybox. ----------------------------------------------------------------------------
-    if (skybox != nullptr) {
-        if (rotSkybox) {
-            if (skyboxClockwise)
-                curSkyboxRotationY += rotStep;
-            else
-                curSkyboxRotationY -= rotStep;
-        }
-        skybox->SetRotationX(-3.0f);
-        skybox->SetRotationY(curSkyboxRotationY);
-        skybox->Render(camera, skyboxShader);
-    }
-    // -------------------------------------------------------------------------------------------
-
-    glutSwapBuffers();
-}
-
-void ReshapeCB(int w, int h)
-{
-    // Update viewport.
-    screenWidth = w;
-    screenHeight = h;
-    glViewport(0, 0, screenWidth, screenHeight);
-    // Adjust camera and projection.
-    float aspectRatio = (float)screenWidth / (float)screenHeight;
-    camera->UpdateProjection(fovy, aspectRatio, zNear, zFar);
-}
-
-void ProcessSpecialKeysCB(int key, int x, int y)
-{
-    // Handle special (functional) keyboard inputs such as F1, spacebar, page up, etc. 
-    switch (key) {
-    // Rendering mode.
-    case GLUT_KEY_F1:
-        // Render with point mode.
-        glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
-        break;
-    case GLUT_KEY_F2:
-        // Render with line mode.
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        break;
-    case GLUT_KEY_F3:
-        // Render with fill mode.
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        break;
-    
-    // Light control.
-    case GLUT_KEY_LEFT:
-        if (pointLight != nullptr)
-            pointLight->MoveLeft(lightMoveSpeed);
-        break;
-    case GLUT_KEY_RIGHT:
-        if (pointLight != nullptr)
-            pointLight->MoveRight(lightMoveSpeed);
-        break;
-    case GLUT_KEY_UP:
-        if (pointLight != nullptr)
-            pointLight->MoveUp(lightMoveSpeed);
-        break;
-    case GLUT_KEY_DOWN:
-        if (pointLight != nullptr)
-            pointLight->MoveDown(lightMoveSpeed);
-        break;
-    default:
-        break;
-    }
-}
-
-void ProcessKeysCB(unsigned char key, int x, int y)
-{
-    // Handle other keyboard inputs those are not defined as special keys.
-    int mode = glutGetModifiers();
-    if (key == 27) {
-        // Release memory allocation if needed.
-        ReleaseResources();
-        exit(0);
-    }
-
-    // Rotation control. 
-    // Set the typing language into English(US) first or it won't get the shift/atl key.
-    if(key == 13) {
-        if (mode & GLUT_ACTIVE_ALT) {
-            if (rotSkybox) {
-                skyboxClockwise = !skyboxClockwise;
-                std::cout << "------------------------------" << std::endl;
-                std::cout << "Skybox Rotation Dir.: ";
-                if (skyboxClockwise)    std::cout << "Clockwise." << std::endl;
-                else                    std::cout << "Counterclockwise." << std::endl;
-                std::cout << "------------------------------" << std::endl;
-            }
-        }
-        else if (rotModel){
-            objClockwise = !objClockwise;
-            std::cout << "------------------------------" << std::endl;
-            std::cout << "Model Rotation Dir.: ";
-            if (objClockwise)   std::cout << "Clockwise." << std::endl;
-            else                std::cout << "Counterclockwise." << std::endl;
-            std::cout << "------------------------------" << std::endl;
-        }
-    }
-    if (key == 32) {
-        if (mode & GLUT_ACTIVE_ALT) {
-            rotSkybox = !rotSkybox;
-            std::cout << "------------------------------" << std::endl;
-            std::cout << "Skybox Rotation: ";
-            if (rotSkybox)  std::cout << "Rotate." << std::endl;
-            else            std::cout << "Pause." << std::endl;
-            std::cout << "------------------------------" << std::endl;
-        }
-        else {
-            rotModel = !rotModel;
-            std::cout << "------------------------------" << std::endl;
-            std::cout << "Model Rotation: ";
-            if (rotModel)   std::cout << "Rotate." << std::endl;
-            else            std::cout << "Pause." << std::endl;
-            std::cout << "------------------------------" << std::endl;
-        }
-    }
-    
-
-    // Spot light control.
-    if (spotLight != nullptr) {
-        if (key == 'a')
-            spotLight->MoveLeft(lightMoveSpeed);
-        if (key == 'd')
-            spotLight->MoveRight(lightMoveSpeed);
-        if (key == 'w')
-            spotLight->MoveUp(lightMoveSpeed);
-        if (key == 's')
-            spotLight->MoveDown(lightMoveSpeed);
-    }
-}
-
-void SetupRenderState()
-{
-    glEnable(GL_DEPTH_TEST);
-
-    glm::vec4 clearColor = glm::vec4(0.44f, 0.57f, 0.75f, 1.00f);
-    glClearColor(
-        (GLclampf)(clearColor.r), 
-        (GLclampf)(clearColor.g), 
-        (GLclampf)(clearColor.b), 
-        (GLclampf)(clearColor.a)
-    );
-}
-
-void LoadObjects(const std::string& modelPath)
-{
-    // -------------------------------------------------------
-	// Note: you can change the code below if you want to load
-    //       the model dynamically.
-	// -------------------------------------------------------
-
-    mesh = new TriangleMesh();
-    mesh->LoadFromFile(modelPath, true);
-    mesh->ShowInfo();
-    mesh->CreateBuffers();
-    sceneObj.mesh = mesh;    
-}
-
-void CreateLights()
-{
-    // Create a directional light.
-    dirLight = new DirectionalLight(dirLightDirection, dirLightRadiance);
-    /*    
-    // Create a point light.
-    pointLight = new PointLight(pointLightPosition, pointLightIntensity);
-    pointLightObj.light = pointLight;
-    pointLightObj.visColor = glm::normalize((pointLightObj.light)->GetIntensity());
-    */
-    // Create a spot light.
-    spotLight = new SpotLight(spotLightPosition, spotLightIntensity, spotLightDirection, 
-            spotLightCutoffStartInDegree, spotLightTotalWidthInDegree);
-    spotLightObj.light = spotLight;
-    spotLightObj.visColor = glm::normalize((spotLightObj.light)->GetIntensity());
-}
-
-void CreateCamera()
-{
-    // Create a camera and update view and proj matrices.
-    camera = new Camera((float)screenWidth / (float)screenHeight);
-    camera->UpdateView(cameraPos, cameraTarget, cameraUp);
-    float aspectRatio = (float)screenWidth / (float)screenHeight;
-    camera->UpdateProjection(fovy, aspectRatio, zNear, zFar);
-}
-
-void CreateSkybox(const std::string skyboxPath)
-{
-    // -------------------------------------------------------
-	// Note: you can change the code below if you want to change
-    //       the skybox texture dynamically.
-	// -------------------------------------------------------
-    if (skybox != nullptr)
-        skybox->~Skybox();
-
-    std::cout << "------------------------------" << std::endl;
-    std::cout << "Skybox backgroud: " << skyboxPath << "." << std::endl;
-    std::cout << "------------------------------" << std::endl;
-    std::string texFilePath = "./TestTextures_HW3/" + skyboxPath;
-    const int numSlices = 36;
-    const int numStacks = 18;
-    const float radius = 50.0f;
-    skybox = new Skybox(texFilePath, numSlices, numStacks, radius);
-}
-
-void CreateShaderLib()
-{
-    fillColorShader = new FillColorShaderProg();
-    if (!fillColorShader->LoadFromFiles("shaders/fixed_color.vs", "shaders/fixed_color.fs"))
-        exit(1);
-
-    phongShadingShader = new PhongShadingDemoShaderProg();
-    if (!phongShadingShader->LoadFromFiles("shaders/phong_shading_demo.vs", "shaders/phong_shading_demo.fs"))
-        exit(1);
-
-    skyboxShader = new SkyboxShaderProg();
-    if (!skyboxShader->LoadFromFiles("shaders/skybox.vs", "shaders/skybox.fs"))
-        exit(1);
-}
-
-// Menu events.
-void processModelMenuEvents(int option) {
-    std::string model;
-    switch (option) {
-    case 1:
-        model = "Arcanine";
-        break;
-    case 2:
-        model = "Ferrari";
-        break;
-    case 3:
-        model = "Gengar";
-        break;
-    case 4:
-        model = "Ivysaur";
-        break;
-    case 5:
-        model = "Koffing";
-        break;
-    case 6:
-        model = "MagikarpF";
-        break;
-    case 7:
-        model = "Rose";
-        break;
-    case 8:
-        model = "Slowbro";
-        break;
-    case 9:
-        model = "TexCube";
-        break;
-    case 10:
-        model = "AnyaForger";
-        break;
-    }
-
-    LoadObjects(model);
-}
-
-void processSkyboxMenuEvents(int option) {
-    std::string skybox;
-    switch (option) {
-    case 1:
-        skybox = "photostudio_02_2k.png";
-        break;
-    case 2:
-        skybox = "sunflowers_2k.png";
-        break;
-    case 3:
-        skybox = "veranda_2k.png";
-        break;
-    case 4:
-        skybox = "ntpu_EECSBuilding.png";
-        break;
-    }
-
-    CreateSkybox(skybox);
-}
-
-// Create menu.
-void createModelMenus() {
-
-    int menu;
-
-    // create the menu and tell glut that "processModelMenuEvents" will handle the events
-    menu = glutCreateMenu(processModelMenuEvents);
-
-    //add entries to our menu
-    glutAddMenuEntry("Arcanine", 1);
-    glutAddMenuEntry("Ferrari", 2);
-    glutAddMenuEntry("Gengar", 3);
-    glutAddMenuEntry("Ivysaur", 4);
-    glutAddMenuEntry("Koffing", 5);
-    glutAddMenuEntry("MagikarpF", 6);
-    glutAddMenuEntry("Rose", 7);
-    glutAddMenuEntry("Slowbro", 8);
-    glutAddMenuEntry("TexCube", 9);
-    glutAddMenuEntry("AnyaForger", 10);
-
-    // attach the menu to the left button
-    glutAttachMenu(GLUT_RIGHT_BUTTON);
-}
-
-void createSkyboxMenus() {
-
-    int menu;
-
-    // create the menu and tell glut that "processSkyboxMenuEvents" will handle the events
-    menu = glutCreateMenu(processSkyboxMenuEvents);
-
-    //add entries to our menu
-    glutAddMenuEntry("Photo Studio", 1);
-    glutAddMenuEntry("Sunflowers", 2);
-    glutAddMenuEntry("Veranda", 3);
-    glutAddMenuEntry("NTPU EECS Building", 4);
-
-    // attach the menu to the left button
-    glutAttachMenu(GLUT_LEFT_BUTTON);
-}
-
-int main(int argc, char** argv)
-{
-    // Setting window properties.
-    glutInit(&argc, argv);
-    glutSetOption(GLUT_MULTISAMPLE, 4);
-    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH | GLUT_MULTISAMPLE);
-    glutInitWindowSize(screenWidth, screenHeight);
-    glutInitWindowPosition(100, 100);
-    glutCreateWindow("Texture Mapping");
-
-    // Initialize GLEW.
-    // Must be done after glut is initialized!
-    GLenum res = glewInit();
-    if (res != GLEW_OK) {
-        std::cerr << "GLEW initialization error: " 
-                  << glewGetErrorString(res) << std::endl;
-        return 1;
-    }
-
-    // Initialization.
-    SetupRenderState();
-    CreateLights();
-    CreateCamera();
-    CreateSkybox("ntpu_EECSBuilding.png");
-    CreateShaderLib();
-    LoadObjects("AnyaForger");
-    createModelMenus();     // Click right mouse button.
-    createSkyboxMenus();    // Click left mouse button.
-
-    // Register callback functions.
-    glutDisplayFunc(RenderSceneCB);
-    glutIdleFunc(RenderSceneCB);
-    glutReshapeFunc(ReshapeCB);
-    glutSpecialFunc(ProcessSpecialKeysCB);
-    glutKeyboardFunc(ProcessKeysCB);
-
-    // Start rendering loop.
-    glutMainLoop();
-
-    return 0;
-}
+﻿#include "headers.h"
+#include "trianglemesh.h"
+#include "camera.h"
+#include "shaderprog.h"
+#include "light.h"
+#include "imagetexture.h"
+#include "skybox.h"
+#include "skyboxcache.h"
+#include "sphericalharmonics.h"
+#include "specularprefilter.h"
+#include "gputimer.h"
+#include "gpuprofiler.h"
+#include "mipgenerator.h"
+#include "parallel.h"
+#include "texturearray.h"
+#include "textureresidency.h"
+#include "allocationcounter.h"
+#include "renderqueue.h"
+#include "framescheduler.h"
+#include "frameclock.h"
+#include "scenegraph.h"
+#include "bvh.h"
+
+#include <chrono>
+
+
+// Global variables.
+int screenWidth = 600;
+int screenHeight = 600;
+// Triangle mesh.
+TriangleMesh* mesh = nullptr;
+std::string modelName;
+// Lights.
+DirectionalLight* dirLight = nullptr;
+PointLight* pointLight = nullptr;
+SpotLight* spotLight = nullptr;
+glm::vec3 dirLightDirection = glm::vec3(0.0f, 0.0f, -1.0f);
+glm::vec3 dirLightRadiance = glm::vec3(0.6f, 0.6f, 0.6f);
+glm::vec3 pointLightPosition = glm::vec3(0.8f, 0.0f, 0.8f);
+glm::vec3 pointLightIntensity = glm::vec3(0.1f, 0.1f, 0.1f);
+glm::vec3 spotLightPosition = glm::vec3(0.0f, 1.0f, 1.0f);
+glm::vec3 spotLightDirection = glm::vec3(0.0f, -1.0f, -1.0f);
+glm::vec3 spotLightIntensity = glm::vec3(0.3f, 0.3f, 0.3f);
+float spotLightCutoffStartInDegree = 30.0f;
+float spotLightTotalWidthInDegree = 45.0f;
+glm::vec3 ambientLight = glm::vec3(0.2f, 0.2f, 0.2f);
+// Camera.
+Camera* camera = nullptr;
+glm::vec3 cameraPos = glm::vec3(0.0f, 1.0f, 5.0f);
+glm::vec3 cameraTarget = glm::vec3(0.0f, 0.0f, 0.0f);
+glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
+float fovy = 30.0f;
+float zNear = 0.1f;
+float zFar = 1000.0f;
+// Shader.
+FillColorShaderProg* fillColorShader = nullptr;
+PhongShadingDemoShaderProg* phongShadingShader = nullptr;
+SkyboxShaderProg* skyboxShader = nullptr;
+SkyboxShaderProg* skyboxFullScreenShader = nullptr;
+SkyboxShaderProg* skyboxStreamedShader = nullptr;
+// UI.
+const float lightMoveSpeed = 0.2f;
+// Skybox.
+Skybox* skybox = nullptr;
+std::string skyboxName;
+int skyboxFaceSize = 0;     // Cube map face size; 0 uses a quarter of the panorama width.
+SkyboxMode skyboxMode = SkyboxMode::FullScreenTriangle;
+// Cube maps of the menu panoramas, preloaded in the background.
+SkyboxCache* skyboxCache = nullptr;
+size_t skyboxCacheInMB = 64;
+// Streamed skybox: the models are lit from a cube map built from a coarse level of the tile
+// pyramid (at most this wide), so the full panorama is never decoded.
+CubeMapTexture* streamedEnvironment = nullptr;
+int streamedLightingWidth = 1024;
+// Ambient light from the skybox (SH9 irradiance) instead of the constant ambientLight.
+bool useSHAmbient = true;
+GLuint shLightingUbo = 0;
+// Camera and light data of the frame (FrameData block), shared by the model and skybox shaders.
+GLuint frameDataUbo = 0;
+FrameData frameData;
+// CPU time spent submitting the model pass, and the GL calls of the last frame.
+double modelPassCpuMs = 0.0;
+int numModelPassFrames = 0;
+size_t numFrameGLCalls = 0;
+// Calls of the frame that went through the GL state shadow: issued and dropped as redundant.
+size_t numFrameIssued = 0;
+size_t numFrameFiltered = 0;
+size_t numModelGLCalls = 0;
+// Draws of the model and the lights, sorted to skip redundant state changes.
+RenderQueue* renderQueue = nullptr;
+double renderQueueSortMs = 0.0;
+// Model pass state read by the per-draw uniform callbacks.
+const CubeMapTexture* modelPassEnvironment = nullptr;
+int boundMaterialBlock = -1;
+unsigned int shLightingEnvironment = 0;
+GpuTimer* modelPassTimer = nullptr;
+// GPU time per pass (phong, light gizmos, skybox), shown in an overlay on request.
+GpuProfiler* gpuProfiler = nullptr;
+bool showGpuOverlay = false;
+bool useEnvSpecular = true;
+// Material parameters from the mesh's uniform buffer (one index per draw) or set per draw.
+bool useMaterialBuffer = true;
+// Times the model pass submits the subMeshes (raised by the material benchmark).
+int modelPassRepeats = 1;
+// Replay the mesh's compiled draw list, or walk its subMeshes every frame.
+bool useDrawList = true;
+// Copies of the model in a grid behind it: drawn with one instanced draw per subMesh, or with
+// one draw per copy and subMesh for comparison.
+const int crowdSizes[] = { 1, 100, 1000, 10000 };
+int crowdSize = 1;
+bool useInstancing = true;
+std::vector<glm::mat4x4> crowdWorldMatrices;
+// The world matrix of the model the crowd was last laid out with; re-laid out when it changes.
+glm::mat4x4 crowdBaseMatrix = glm::mat4x4(0.0f);
+bool crowdDirty = true;
+int boundObject = -1;
+// Frustum culling: the copies of the model through a BVH over their boxes, then the subMeshes
+// of each copy drawn on its own. Instanced draws upload the visible copies only.
+bool useCulling = true;
+Frustum viewFrustum;
+Bvh* crowdBvh = nullptr;
+std::vector<int> visibleObjects;
+std::vector<int> uploadedObjects;
+std::vector<glm::mat4x4> visibleWorldMatrices;
+bool instancesDirty = true;
+// View depth of each subMesh of the copy being submitted, -1 if culled.
+std::vector<float> subMeshDepths;
+int numSubMeshesTested = 0;
+int numSubMeshesCulled = 0;
+const std::string skyboxNames[] = {
+    "photostudio_02_2k.png", "sunflowers_2k.png", "veranda_2k.png", "ntpu_EECSBuilding.png"
+};
+// Rotate.
+bool rotSkybox = false;
+bool rotModel = false;
+// Frame rate held while something rotates; otherwise frames are drawn on demand.
+double targetFrameRate = 60.0;
+// Animation runs in fixed steps of the frame clock, apart from the frame rate.
+FrameClock frameClock;
+// Simulated time per benchmark frame, so that frame n shows the same pose on any machine.
+const double benchmarkFrameStep = 1.0 / 60.0;
+// Texture binding: one texture per subMesh, the model's atlas, or scene-wide texture arrays.
+enum class TextureBindMode { PerSubMesh, Atlas, Array };
+TextureBindMode textureBindMode = TextureBindMode::Atlas;
+TextureArrayBuilder* textureArrays = nullptr;
+int numTextureBinds = 0;
+// GPU memory budget for model and skybox textures.
+size_t textureBudgetInMB = 256;
+
+// Transforms of the model and the light gizmos; world matrices are recomputed when they move.
+SceneGraph* sceneGraph = nullptr;
+
+// SceneObject.
+struct SceneObject
+{
+    SceneObject() {
+        mesh = nullptr;
+        node = SceneGraph::kNoParent;
+    }
+    TriangleMesh* mesh;
+    int node;
+};
+SceneObject sceneObj;
+
+// ScenePointLight (for visualization of a point light).
+struct ScenePointLight
+{
+    ScenePointLight() {
+        light = nullptr;
+        node = SceneGraph::kNoParent;
+        visColor = glm::vec3(1.0f, 1.0f, 1.0f);
+    }
+    PointLight* light;
+    int node;
+    glm::vec3 visColor;
+};
+ScenePointLight pointLightObj;
+ScenePointLight spotLightObj;
+
+// Function prototypes.
+void ReleaseResources();
+// Callback functions.
+void RenderSceneCB();
+void ReshapeCB(int, int);
+void ProcessSpecialKeysCB(int, int, int);
+void ProcessKeysCB(unsigned char, int, int);
+void SetupRenderState();
+void LoadObjects(const std::string&);
+void CreateCamera();
+void CreateSceneGraph();
+void CreateSkybox(const std::string);
+void CreateShaderLib();
+void BenchmarkSkyboxes();
+void BenchmarkSkyboxPass();
+void BenchmarkSkyboxStreaming();
+CubeMapTexture* CreateStreamedEnvironment(const VirtualTexture*, size_t* = nullptr);
+void UpdateSHLighting();
+void UpdateFrameData();
+void ReportFrameStats();
+void BenchmarkMaterialSubmission();
+void BenchmarkDrawList();
+void UpdateCrowd();
+void CullCrowd();
+void UpdateSubMeshDepths(const glm::mat4x4&, const bool);
+void BenchmarkInstancing();
+float GetViewDepth(const glm::vec3&);
+void SubmitModel();
+void SubmitLight(ScenePointLight&);
+void SetSubMeshUniforms(const RenderPacket&);
+void SetLightUniforms(const RenderPacket&);
+
+
+
+void ReleaseResources()
+{
+    // Delete texture arrays (they point into the mesh materials).
+    if (textureArrays != nullptr) {
+        delete textureArrays;
+        textureArrays = nullptr;
+    }
+    // Delete scene objects and lights.
+    if (mesh != nullptr) {
+        delete mesh;
+        mesh = nullptr;
+    }
+    if (pointLight != nullptr) {
+        delete pointLight;
+        pointLight = nullptr;
+    }
+    if (dirLight != nullptr) {
+        delete dirLight;
+        dirLight = nullptr;
+    }
+    if (spotLight != nullptr) {
+        delete spotLight;
+        spotLight = nullptr;
+    }
+    // Delete camera.
+    if (camera != nullptr) {
+        delete camera;
+        camera = nullptr;
+    }
+    // Delete shaders.
+    if (fillColorShader != nullptr) {
+        delete fillColorShader;
+        fillColorShader = nullptr;
+    }
+    if (phongShadingShader != nullptr) {
+        delete phongShadingShader;
+        phongShadingShader = nullptr;
+    }
+    if (skyboxShader != nullptr) {
+        delete skyboxShader;
+        skyboxShader = nullptr;
+    }
+    if (skyboxFullScreenShader != nullptr) {
+        delete skyboxFullScreenShader;
+        skyboxFullScreenShader = nullptr;
+    }
+    if (skyboxStreamedShader != nullptr) {
+        delete skyboxStreamedShader;
+        skyboxStreamedShader = nullptr;
+    }
+    // Delete skybox (before the cache that owns its cube map).
+    if (skybox != nullptr) {
+        delete skybox;
+        skybox = nullptr;
+    }
+    if (streamedEnvironment != nullptr) {
+        delete streamedEnvironment;
+        streamedEnvironment = nullptr;
+    }
+    if (skyboxCache != nullptr) {
+        delete skyboxCache;
+        skyboxCache = nullptr;
+    }
+    if (shLightingUbo != 0) {
+        glDeleteBuffers(1, &shLightingUbo);
+        shLightingUbo = 0;
+    }
+    if (frameDataUbo != 0) {
+        glDeleteBuffers(1, &frameDataUbo);
+        frameDataUbo = 0;
+    }
+    if (modelPassTimer != nullptr) {
+        delete modelPassTimer;
+        modelPassTimer = nullptr;
+    }
+    if (renderQueue != nullptr) {
+        delete renderQueue;
+        renderQueue = nullptr;
+    }
+    if (gpuProfiler != nullptr) {
+        delete gpuProfiler;
+        gpuProfiler = nullptr;
+    }
+    if (sceneGraph != nullptr) {
+        delete sceneGraph;
+        sceneGraph = nullptr;
+    }
+    if (crowdBvh != nullptr) {
+        delete crowdBvh;
+        crowdBvh = nullptr;
+    }
+}
+
+static float curObjRotationY = 0.0f;
+static float curSkyboxRotationY = 249.0f;
+// Rotations at the previous step, to draw the pose in between.
+static float prevObjRotationY = curObjRotationY;
+static float prevSkyboxRotationY = curSkyboxRotationY;
+// Degrees per second (what 0.005 degrees per frame gave at 60 fps).
+const float rotSpeed = 0.3f;
+bool objClockwise = true;
+bool skyboxClockwise = true;
+// One fixed step of the animation.
+void UpdateAnimation(const float dt)
+{
+    prevObjRotationY = curObjRotationY;
+    prevSkyboxRotationY = curSkyboxRotationY;
+    if (rotSkybox)
+        curSkyboxRotationY += (skyboxClockwise ? rotSpeed : -rotSpeed) * dt;
+    if (rotModel)
+        curObjRotationY += (objClockwise ? rotSpeed : -rotSpeed) * dt;
+}
+
+void RenderSceneCB()
+{
+    TRACE_ZONE("Frame");
+    // Heap allocations of this frame on the render thread; a steady-state frame makes none.
+    const size_t numAllocationsBefore = AllocationCounter::GetNumAllocations();
+    const size_t numBytesBefore = AllocationCounter::GetNumBytes();
+    const size_t numGLCallsBefore = GLCallCounter::GetCount();
+    const size_t numIssuedBefore = GLState::GetNumIssued();
+    const size_t numFilteredBefore = GLState::GetNumFiltered();
+    gpuProfiler->BeginFrame();
+    gpuProfiler->BeginScope("Frame");
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    TextureResidency::BeginFrame();
+    // Advance the animation by the time since the last frame, in fixed steps.
+    const int numSteps = frameClock.Tick();
+    for (int step = 0; step < numSteps; ++step)
+        UpdateAnimation((float)frameClock.GetFixedStep());
+    const float alpha = (float)frameClock.GetAlpha();
+    // Upload a preloaded skybox when one is ready.
+    if (skyboxCache != nullptr)
+        skyboxCache->Update();
+    // Rotate the skybox before the frame data is written: the model's lighting uses it too.
+    if (skybox != nullptr) {
+        skybox->SetRotationX(-3.0f);
+        skybox->SetRotationY(glm::mix(prevSkyboxRotationY, curSkyboxRotationY, alpha));
+    }
+    UpdateFrameData();
+    
+    // Update transforms: only the nodes that moved (and their children) are recomputed.
+    TriangleMesh* pMesh = sceneObj.mesh;
+    const float objRotationY = glm::mix(prevObjRotationY, curObjRotationY, alpha);
+    glm::mat4x4 S = glm::scale(glm::mat4x4(1.0f), glm::vec3(1.5f, 1.5f, 1.5f));
+    glm::mat4x4 R = glm::rotate(glm::mat4x4(1.0f), glm::radians(objRotationY), glm::vec3(0, 1, 0));
+    sceneGraph->SetLocalMatrix(sceneObj.node, S * R);
+    if (pointLightObj.light != nullptr)
+        sceneGraph->SetLocalMatrix(pointLightObj.node, glm::translate(glm::mat4x4(1.0f), pointLightObj.light->GetPosition()));
+    if (spotLightObj.light != nullptr)
+        sceneGraph->SetLocalMatrix(spotLightObj.node, glm::translate(glm::mat4x4(1.0f), spotLightObj.light->GetPosition()));
+    sceneGraph->Update();
+    if (pMesh != nullptr) {
+        UpdateSHLighting();
+        if (crowdDirty || sceneGraph->GetWorldMatrix(sceneObj.node) != crowdBaseMatrix)
+            UpdateCrowd();
+        CullCrowd();
+    }
+
+    // Render the model and the lights through the render queue. ---------------------------------
+    modelPassTimer->Begin();
+    const size_t numModelGLCallsBefore = GLCallCounter::GetCount();
+    const auto submitStart = std::chrono::high_resolution_clock::now();
+    renderQueue->Begin();
+    if (pMesh != nullptr)
+        SubmitModel();
+    SubmitLight(pointLightObj);
+    SubmitLight(spotLightObj);
+    renderQueue->Execute();
+    const auto submitEnd = std::chrono::high_resolution_clock::now();
+    modelPassCpuMs += std::chrono::duration<double, std::milli>(submitEnd - submitStart).count();
+    renderQueueSortMs += renderQueue->GetSortTime();
+    ++numModelPassFrames;
+    numModelGLCalls = GLCallCounter::GetCount() - numModelGLCallsBefore;
+    modelPassTimer->End();
+    // Report the texture binds and the queue's draws and state changes whenever they change.
+    numTextureBinds = renderQueue->GetNumTextureBinds() / modelPassRepeats;
+    static int lastNumTextureBinds = -1;
+    if (numTextureBinds != lastNumTextureBinds) {
+        std::cout << "Texture binds per frame: " << numTextureBinds << std::endl;
+        lastNumTextureBinds = numTextureBinds;
+    }
+    static int lastNumStateChanges = -1;
+    if (renderQueue->GetNumStateChanges() != lastNumStateChanges) {
+        std::cout << "Render queue: " << renderQueue->GetNumDraws() << " draws, " << renderQueue->GetNumStateChanges()
+                  << " state changes (" << renderQueue->GetNumSkipped() << " redundant skipped)" << std::endl;
+        lastNumStateChanges = renderQueue->GetNumStateChanges();
+    }
+    // And what culling kept.
+    static int lastNumVisible = -1;
+    static int lastNumSubMeshesCulled = -1;
+    if (useCulling && pMesh != nullptr && ((int)visibleObjects.size() != lastNumVisible || numSubMeshesCulled != lastNumSubMeshesCulled)) {
+        const Bvh::CullStats& stats = crowdBvh->GetCullStats();
+        std::cout << "Culling: " << stats.numNodesTested << " BVH nodes and " << stats.numObjectsTested << " objects tested, "
+                  << stats.numCulled << " culled, " << stats.numVisible << " drawn; subMeshes " << numSubMeshesTested
+                  << " tested, " << numSubMeshesCulled << " culled" << std::endl;
+        lastNumVisible = (int)visibleObjects.size();
+        lastNumSubMeshesCulled = numSubMeshesCulled;
+    }
+    // -------------------------------------------------------------------------------------------
+
+    // Render skybox. ----------------------------------------------------------------------------
+    if (skybox != nullptr) {
+        GpuProfileScope skyboxScope(gpuProfiler, "Skybox");
+        if (skybox->GetMode() == SkyboxMode::Sphere)
+            skybox->Render(camera, skyboxShader);
+        else if (skybox->GetMode() == SkyboxMode::Streamed)
+            skybox->Render(camera, skyboxStreamedShader);
+        else
+            skybox->Render(camera, skyboxFullScreenShader);
+    }
+    // -------------------------------------------------------------------------------------------
+
+    // Report the heap allocations per frame whenever they change.
+    const size_t numAllocations = AllocationCounter::GetNumAllocations() - numAllocationsBefore;
+    static size_t lastNumAllocations = (size_t)-1;
+    if (numAllocations != lastNumAllocations) {
+        std::cout << "Heap allocations per frame: " << numAllocations << " ("
+                  << AllocationCounter::GetNumBytes() - numBytesBefore << " bytes)" << std::endl;
+        lastNumAllocations = numAllocations;
+    }
+    // And the GL calls whenever the model pass changes (the timer queries vary per frame).
+    numFrameGLCalls = GLCallCounter::GetCount() - numGLCallsBefore;
+    numFrameIssued = GLState::GetNumIssued() - numIssuedBefore;
+    numFrameFiltered = GLState::GetNumFiltered() - numFilteredBefore;
+    static size_t lastNumModelGLCalls = (size_t)-1;
+    static size_t lastNumFrameFiltered = (size_t)-1;
+    if (numModelGLCalls != lastNumModelGLCalls || numFrameFiltered != lastNumFrameFiltered) {
+        std::cout << "GL calls per frame: " << numFrameGLCalls << " (model pass " << numModelGLCalls << "), state calls "
+                  << numFrameIssued << " issued, " << numFrameFiltered << " filtered" << std::endl;
+        lastNumModelGLCalls = numModelGLCalls;
+        lastNumFrameFiltered = numFrameFiltered;
+    }
+
+    gpuProfiler->EndScope();
+    if (showGpuOverlay)
+        gpuProfiler->DrawOverlay(screenHeight);
+    gpuProfiler->EndFrame();
+    {
+        TRACE_ZONE("Swap buffers");
+        glutSwapBuffers();
+    }
+    // Keep drawing while preloaded skyboxes wait for their upload or streamed tiles are missing.
+    const VirtualTexture* virtualTexture = (skybox != nullptr) ? skybox->GetVirtualTexture() : nullptr;
+    const bool streaming = (virtualTexture != nullptr && !virtualTexture->IsComplete());
+    FrameScheduler::EndFrame(streaming || (skyboxCache != nullptr && skyboxCache->HasPendingUploads()));
+}
+
+// Depth of a world space point in [0, 1] between the near and far planes, for the sort keys.
+float GetViewDepth(const glm::vec3& worldPos)
+{
+    const float viewZ = -(camera->GetViewMatrix() * glm::vec4(worldPos, 1.0f)).z;
+    return (viewZ - zNear) / (zFar - zNear);
+}
+
+// Lay out the crowd in rows behind the model, columns alternating right and left of it so
+// that the first copy is the model itself, and build the BVH over it, or refit the BVH when
+// only the model turned.
+void UpdateCrowd()
+{
+    TRACE_ZONE("Update crowd");
+    const glm::mat4x4& modelWorld = sceneGraph->GetWorldMatrix(sceneObj.node);
+    const int side = (int)std::ceil(std::sqrt((double)crowdSize));
+    const float spacing = 2.0f;
+    crowdWorldMatrices.resize(crowdSize);
+    for (int i = 0; i < crowdSize; ++i) {
+        const int column = i % side;
+        const int across = (column % 2 == 1) ? (column + 1) / 2 : -(column / 2);
+        const glm::vec3 offset(across * spacing, 0.0f, -(i / side) * spacing);
+        crowdWorldMatrices[i] = glm::translate(glm::mat4x4(1.0f), offset) * modelWorld;
+    }
+    if (crowdBvh == nullptr)
+        crowdBvh = new Bvh();
+    if (crowdDirty || crowdBvh->GetNumObjects() != crowdSize) {
+        std::vector<Aabb> boxes(crowdSize);
+        for (int i = 0; i < crowdSize; ++i)
+            boxes[i] = mesh->GetBounds().Transform(crowdWorldMatrices[i]);
+        crowdBvh->Build(boxes);
+    }
+    else {
+        for (int i = 0; i < crowdSize; ++i)
+            crowdBvh->SetBounds(i, mesh->GetBounds().Transform(crowdWorldMatrices[i]));
+    }
+    crowdBaseMatrix = modelWorld;
+    crowdDirty = false;
+    instancesDirty = true;
+}
+
+// Find the copies in the view frustum and upload them to the instance buffer if they changed.
+void CullCrowd()
+{
+    TRACE_ZONE("Cull crowd");
+    viewFrustum.Extract(camera->GetProjMatrix() * camera->GetViewMatrix());
+    if (useCulling) {
+        crowdBvh->Cull(viewFrustum, visibleObjects);
+    }
+    else {
+        visibleObjects.resize(crowdSize);
+        for (int i = 0; i < crowdSize; ++i)
+            visibleObjects[i] = i;
+    }
+    if (crowdSize <= 1 || !useInstancing)
+        return;
+    if (!instancesDirty && visibleObjects == uploadedObjects)
+        return;
+    visibleWorldMatrices.resize(visibleObjects.size());
+    for (size_t i = 0; i < visibleObjects.size(); ++i)
+        visibleWorldMatrices[i] = crowdWorldMatrices[visibleObjects[i]];
+    if (!visibleWorldMatrices.empty())
+        mesh->SetInstances(visibleWorldMatrices);
+    uploadedObjects = visibleObjects;
+    instancesDirty = false;
+}
+
+// The depth of the center of each subMesh's box placed by the world matrix, or -1 if the box
+// is outside the view frustum (when culling).
+void UpdateSubMeshDepths(const glm::mat4x4& objectWorld, const bool cull)
+{
+    const std::vector<SubMesh>& subMeshes = mesh->GetSubMeshes();
+    subMeshDepths.resize(subMeshes.size());
+    for (size_t i = 0; i < subMeshes.size(); ++i) {
+        const Aabb box = subMeshes[i].bounds.Transform(objectWorld);
+        subMeshDepths[i] = std::max(0.0f, GetViewDepth(box.GetCenter()));
+        if (!cull)
+            continue;
+        ++numSubMeshesTested;
+        if (box.IsEmpty() || !viewFrustum.IsVisible(box)) {
+            subMeshDepths[i] = -1.0f;
+            ++numSubMeshesCulled;
+        }
+    }
+}
+
+// Set the per-pass uniforms of the model and queue one packet per subMesh (per copy of the
+// model when the crowd is drawn without instancing).
+void SubmitModel()
+{
+    TRACE_ZONE("Submit model");
+    // -------------------------------------------------------
+	// Note: if you want to compute lighting in the View Space, 
+    //       you might need to change the code below.
+	// -------------------------------------------------------
+    const glm::mat4x4& worldMatrix = sceneGraph->GetWorldMatrix(sceneObj.node);
+    // The view is rigid: the view space normal matrix is its rotation times the world one.
+    glm::mat4x4 normalMatrix = glm::mat4x4(glm::mat3x3(camera->GetViewMatrix()) * glm::mat3x3(sceneGraph->GetNormalMatrix(sceneObj.node)));
+    glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * worldMatrix;
+
+    renderQueue->SetProgram(phongShadingShader);
+    glUniform1i(phongShadingShader->GetLocUseSHAmbient(), useSHAmbient ? 1 : 0);
+    // Prefiltered skybox for glossy reflections.
+    const CubeMapTexture* environment = (skybox != nullptr) ? skybox->GetTexture() : nullptr;
+    const bool bindEnv = useEnvSpecular && environment != nullptr && environment->HasSpecular();
+    if (bindEnv)
+        skybox->GetTexture()->BindSpecular(GL_TEXTURE2);
+    glUniform1i(phongShadingShader->GetLocUseEnvSpecular(), bindEnv ? 1 : 0);
+    modelPassEnvironment = bindEnv ? environment : nullptr;
+    // Transformation matrix.
+    glUniformMatrix4fv(phongShadingShader->GetLocM(), 1, GL_FALSE, glm::value_ptr(worldMatrix));
+    glUniformMatrix4fv(phongShadingShader->GetLocNM(), 1, GL_FALSE, glm::value_ptr(normalMatrix));
+    glUniformMatrix4fv(phongShadingShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
+    // The atlas and the per-subMesh textures share unit 0.
+    const bool bindAtlas = textureBindMode == TextureBindMode::Atlas && mesh->GetAtlas() != nullptr;
+    glUniform1i(phongShadingShader->GetLocUseAtlas(), bindAtlas ? 1 : 0);
+    glUniform1i(phongShadingShader->GetLocMapKd(), 0);
+    // Material buffer: the per-draw material uniforms become one index. The texture
+    // selection that depends only on the bind mode is set once.
+    glUniform1i(phongShadingShader->GetLocUseMaterialBuffer(), useMaterialBuffer ? 1 : 0);
+    if (useMaterialBuffer) {
+        if (bindEnv)
+            glUniform1f(phongShadingShader->GetLocEnvMaxLod(), (float)(environment->GetNumSpecularLevels() - 1));
+        glUniform1i(phongShadingShader->GetLocUseTexArray(), textureBindMode == TextureBindMode::Array ? 1 : 0);
+    }
+    boundMaterialBlock = -1;
+    // The crowd: the visible copies in each draw, or a draw per visible copy with its own
+    // transform.
+    const bool instanced = crowdSize > 1 && useInstancing;
+    glUniform1i(phongShadingShader->GetLocUseInstancing(), instanced ? 1 : 0);
+    boundObject = -1;
+    numSubMeshesTested = 0;
+    numSubMeshesCulled = 0;
+    if (visibleObjects.empty())
+        return;
+    const int numObjects = instanced ? 1 : (int)visibleObjects.size();
+
+    // What every subMesh packet shares. SubMeshes sort at the center of their box.
+    RenderPacket modelPacket;
+    modelPacket.program = phongShadingShader;
+    modelPacket.vaoId = mesh->GetVaoId();
+    modelPacket.iboId = mesh->GetIboId();
+    modelPacket.numInstances = instanced ? (GLsizei)visibleObjects.size() : 1;
+    modelPacket.setUniforms = SetSubMeshUniforms;
+    modelPacket.passName = "Phong";
+    // The atlas is one texture for the whole mesh.
+    const uint16_t atlasKey = 0xFFFF;
+    const bool arrayMode = textureBindMode == TextureBindMode::Array;
+
+    for (int v = 0; v < numObjects; ++v) {
+        // The subMeshes of an instanced draw are not culled: every copy is in it.
+        const int object = visibleObjects[v];
+        UpdateSubMeshDepths(crowdWorldMatrices[object], useCulling && !instanced);
+        modelPacket.objectIndex = object;
+        if (useDrawList) {
+            // Replay the draw list compiled at load time (one command per subMesh).
+            const std::vector<DrawCommand>& drawList = mesh->GetDrawList();
+            for (int repeat = 0; repeat < modelPassRepeats; ++repeat)
+            for (int i = 0; i < (int)drawList.size(); ++i) {
+                const DrawCommand& command = drawList[i];
+                const float depth = subMeshDepths[i];
+                if (depth < 0.0f)
+                    continue;
+                RenderPacket packet = modelPacket;
+                uint16_t textureKey = 0;
+                if (command.flags & DrawCommand::HasMapKd) {
+                    if (arrayMode && (command.flags & DrawCommand::InTextureArray)) {
+                        packet.SetTexture(command.mapKdArray, GL_TEXTURE1);
+                        textureKey = command.arrayKey;
+                    }
+                    else if (bindAtlas) {
+                        packet.SetTexture(mesh->GetAtlas(), GL_TEXTURE0);
+                        textureKey = atlasKey;
+                    }
+                    else {
+                        packet.SetTexture(command.mapKd, GL_TEXTURE0);
+                        textureKey = command.mapKdKey;
+                    }
+                }
+                packet.firstIndex = command.firstIndex;
+                packet.numElements = command.numIndices;
+                packet.userData = command.material;
+                packet.userIndex = command.materialSlot;
+                packet.key = RenderQueue::MakeKey(packet.program, textureKey, command.materialSlot, depth);
+                renderQueue->Submit(packet);
+            }
+            continue;
+        }
+
+        // Walk the subMeshes and work out each draw again, for comparison.
+        const std::vector<SubMesh>& subMeshes = mesh->GetSubMeshes();
+        for (int repeat = 0; repeat < modelPassRepeats; ++repeat)
+        for (int i = 0; i < (int)subMeshes.size(); ++i) {
+            const SubMesh& subMesh = subMeshes[i];
+            const float depth = subMeshDepths[i];
+            if (depth < 0.0f)
+                continue;
+            RenderPacket packet = modelPacket;
+            uint16_t textureKey = 0;
+            if (subMesh.material->GetMapKd() != nullptr) {
+                if (arrayMode && subMesh.material->GetMapKdArray() != nullptr) {
+                    packet.SetTexture(subMesh.material->GetMapKdArray(), GL_TEXTURE1);
+                    textureKey = mesh->GetTextureKey(subMesh.material->GetMapKdArray());
+                }
+                else if (bindAtlas) {
+                    packet.SetTexture(mesh->GetAtlas(), GL_TEXTURE0);
+                    textureKey = atlasKey;
+                }
+                else {
+                    packet.SetTexture(subMesh.material->GetMapKd(), GL_TEXTURE0);
+                    textureKey = mesh->GetTextureKey(subMesh.material->GetMapKd());
+                }
+            }
+            packet.firstIndex = subMesh.firstIndex;
+            packet.numElements = (GLsizei)subMesh.vertexIndices.size();
+            packet.userData = subMesh.material;
+            packet.userIndex = i;
+            packet.key = RenderQueue::MakeKey(packet.program, textureKey, i, depth);
+            renderQueue->Submit(packet);
+        }
+    }
+}
+
+// Per-draw uniforms of a subMesh (userData is its material, userIndex its material slot):
+// the transform of its copy when the crowd is drawn per copy, then the material index, or
+// the material parameters.
+void SetSubMeshUniforms(const RenderPacket& packet)
+{
+    if (crowdSize > 1 && !useInstancing && packet.objectIndex != boundObject) {
+        const glm::mat4x4& worldMatrix = crowdWorldMatrices[packet.objectIndex];
+        const glm::mat4x4 normalMatrix = glm::transpose(glm::inverse(camera->GetViewMatrix() * worldMatrix));
+        const glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * worldMatrix;
+        glUniformMatrix4fv(phongShadingShader->GetLocM(), 1, GL_FALSE, glm::value_ptr(worldMatrix));
+        glUniformMatrix4fv(phongShadingShader->GetLocNM(), 1, GL_FALSE, glm::value_ptr(normalMatrix));
+        glUniformMatrix4fv(phongShadingShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
+        boundObject = packet.objectIndex;
+    }
+    const int materialsPerBlock = PhongShadingDemoShaderProg::maxMaterialsPerBlock;
+    if (useMaterialBuffer) {
+        const int block = packet.userIndex / materialsPerBlock;
+        if (block != boundMaterialBlock) {
+            mesh->BindMaterialBlock(block);
+            boundMaterialBlock = block;
+        }
+        glUniform1i(phongShadingShader->GetLocMaterialIndex(), packet.userIndex % materialsPerBlock);
+        return;
+    }
+    const PhongMaterial* material = static_cast<const PhongMaterial*>(packet.userData);
+    glUniform3fv(phongShadingShader->GetLocKa(), 1, glm::value_ptr(material->GetKa()));
+    glUniform3fv(phongShadingShader->GetLocKd(), 1, glm::value_ptr(material->GetKd()));
+    glUniform3fv(phongShadingShader->GetLocKs(), 1, glm::value_ptr(material->GetKs()));
+    glUniform1f(phongShadingShader->GetLocNs(), material->GetNs());
+    if (modelPassEnvironment != nullptr) {
+        const float envLod = SpecularPrefilter::GetLod(material->GetNs(), modelPassEnvironment->GetNumSpecularLevels());
+        glUniform1f(phongShadingShader->GetLocEnvLod(), envLod);
+    }
+    if (material->GetMapKd() != nullptr) {
+        const bool inArray = textureBindMode == TextureBindMode::Array && material->GetMapKdArray() != nullptr;
+        if (inArray)
+            glUniform1f(phongShadingShader->GetLocMapKdLayer(), (float)material->GetMapKdLayer());
+        else if (textureBindMode == TextureBindMode::Atlas && mesh->GetAtlas() != nullptr)
+            glUniform4fv(phongShadingShader->GetLocUVTransform(), 1, glm::value_ptr(material->GetUVTransform()));
+        glUniform1i(phongShadingShader->GetLocUseTexArray(), inArray ? 1 : 0);
+        glUniform1i(phongShadingShader->GetLocExist(), 1);
+    }
+    else {
+        glUniform1i(phongShadingShader->GetLocExist(), 0);
+    }
+}
+
+// Queue the visualization of a light, drawn with its fill color.
+void SubmitLight(ScenePointLight& lightObj)
+{
+    if (lightObj.light == nullptr)
+        return;
+    RenderPacket packet;
+    packet.program = fillColorShader;
+    packet.vaoId = lightObj.light->GetVaoId();
+    packet.primitive = GL_POINTS;
+    packet.numElements = 1;
+    packet.pointSize = 16.0f;
+    packet.setUniforms = SetLightUniforms;
+    packet.userData = &lightObj;
+    packet.passName = "Light gizmos";
+    packet.key = RenderQueue::MakeKey(packet.program, 0, 0, GetViewDepth(lightObj.light->GetPosition()));
+    renderQueue->Submit(packet);
+}
+
+void SetLightUniforms(const RenderPacket& packet)
+{
+    const ScenePointLight* lightObj = static_cast<const ScenePointLight*>(packet.userData);
+    glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * sceneGraph->GetWorldMatrix(lightObj->node);
+    glUniformMatrix4fv(fillColorShader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
+    glUniform3fv(fillColorShader->GetLocFillColor(), 1, glm::value_ptr(lightObj->visColor));
+}
+
+void ReshapeCB(int w, int h)
+{
+    // Update viewport.
+    screenWidth = w;
+    screenHeight = h;
+    glViewport(0, 0, screenWidth, screenHeight);
+    // Adjust camera and projection.
+    float aspectRatio = (float)screenWidth / (float)screenHeight;
+    camera->UpdateProjection(fovy, aspectRatio, zNear, zFar);
+    FrameScheduler::RequestRedraw();
+}
+
+void ProcessSpecialKeysCB(int key, int x, int y)
+{
+    // Handle special (functional) keyboard inputs such as F1, spacebar, page up, etc. 
+    switch (key) {
+    // Rendering mode.
+    case GLUT_KEY_F1:
+        // Render with point mode.
+        glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
+        break;
+    case GLUT_KEY_F2:
+        // Render with line mode.
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        break;
+    case GLUT_KEY_F3:
+        // Render with fill mode.
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        break;
+    // Scene graph update cost with 100k nodes.
+    case GLUT_KEY_F4:
+        SceneGraph::Benchmark(100000);
+        break;
+    // Frustum culling on or off, reported like the material toggle.
+    case GLUT_KEY_F5:
+        std::cout << "------------------------------" << std::endl;
+        if (numModelPassFrames > 0) {
+            std::cout << "Model pass CPU submit time with" << (useCulling ? "" : "out") << " culling: "
+                      << modelPassCpuMs / numModelPassFrames << " ms (" << numModelPassFrames << " frames)" << std::endl;
+        }
+        useCulling = !useCulling;
+        instancesDirty = true;
+        modelPassCpuMs = 0.0;
+        renderQueueSortMs = 0.0;
+        numModelPassFrames = 0;
+        std::cout << "Frustum Culling: ";
+        if (useCulling) std::cout << "On." << std::endl;
+        else            std::cout << "Off." << std::endl;
+        std::cout << "------------------------------" << std::endl;
+        break;
+    // Culling a generated scene of 100k boxes with this camera.
+    case GLUT_KEY_F6:
+        Bvh::Benchmark(camera->GetProjMatrix() * camera->GetViewMatrix(), 100000);
+        break;
+    
+    // Light control.
+    case GLUT_KEY_LEFT:
+        if (pointLight != nullptr)
+            pointLight->MoveLeft(lightMoveSpeed);
+        break;
+    case GLUT_KEY_RIGHT:
+        if (pointLight != nullptr)
+            pointLight->MoveRight(lightMoveSpeed);
+        break;
+    case GLUT_KEY_UP:
+        if (pointLight != nullptr)
+            pointLight->MoveUp(lightMoveSpeed);
+        break;
+    case GLUT_KEY_DOWN:
+        if (pointLight != nullptr)
+            pointLight->MoveDown(lightMoveSpeed);
+        break;
+    default:
+        break;
+    }
+    FrameScheduler::RequestRedraw();
+}
+
+void ProcessKeysCB(unsigned char key, int x, int y)
+{
+    // Handle other keyboard inputs those are not defined as special keys.
+    int mode = glutGetModifiers();
+    if (key == 27) {
+        // Release memory allocation if needed.
+        ReleaseResources();
+        exit(0);
+    }
+
+    // Rotation control. 
+    // Set the typing language into English(US) first or it won't get the shift/atl key.
+    if(key == 13) {
+        if (mode & GLUT_ACTIVE_ALT) {
+            if (rotSkybox) {
+                skyboxClockwise = !skyboxClockwise;
+                std::cout << "------------------------------" << std::endl;
+                std::cout << "Skybox Rotation Dir.: ";
+                if (skyboxClockwise)    std::cout << "Clockwise." << std::endl;
+                else                    std::cout << "Counterclockwise." << std::endl;
+                std::cout << "------------------------------" << std::endl;
+            }
+        }
+        else if (rotModel){
+            objClockwise = !objClockwise;
+            std::cout << "------------------------------" << std::endl;
+            std::cout << "Model Rotation Dir.: ";
+            if (objClockwise)   std::cout << "Clockwise." << std::endl;
+            else                std::cout << "Counterclockwise." << std::endl;
+            std::cout << "------------------------------" << std::endl;
+        }
+    }
+    if (key == 32) {
+        if (mode & GLUT_ACTIVE_ALT) {
+            rotSkybox = !rotSkybox;
+            std::cout << "------------------------------" << std::endl;
+            std::cout << "Skybox Rotation: ";
+            if (rotSkybox)  std::cout << "Rotate." << std::endl;
+            else            std::cout << "Pause." << std::endl;
+            std::cout << "------------------------------" << std::endl;
+        }
+        else {
+            rotModel = !rotModel;
+            std::cout << "------------------------------" << std::endl;
+            std::cout << "Model Rotation: ";
+            if (rotModel)   std::cout << "Rotate." << std::endl;
+            else            std::cout << "Pause." << std::endl;
+            std::cout << "------------------------------" << std::endl;
+        }
+        FrameScheduler::SetAnimating(rotSkybox || rotModel);
+    }
+    // Target frame rate while animating.
+    if (key == '[' || key == ']') {
+        targetFrameRate = (key == '[') ? std::max(15.0, targetFrameRate / 2.0) : std::min(240.0, targetFrameRate * 2.0);
+        FrameScheduler::SetTargetRate(targetFrameRate);
+        std::cout << "------------------------------" << std::endl;
+        std::cout << "Target Frame Rate: " << targetFrameRate << " fps." << std::endl;
+        std::cout << "------------------------------" << std::endl;
+    }
+    
+
+    // Texture binding mode.
+    if (key == 't') {
+        std::cout << "------------------------------" << std::endl;
+        std::cout << "Texture Binding: ";
+        if (textureBindMode == TextureBindMode::PerSubMesh) {
+            textureBindMode = TextureBindMode::Atlas;
+            std::cout << "Atlas." << std::endl;
+        }
+        else if (textureBindMode == TextureBindMode::Atlas) {
+            textureBindMode = TextureBindMode::Array;
+            std::cout << "Texture Array." << std::endl;
+        }
+        else {
+            textureBindMode = TextureBindMode::PerSubMesh;
+            std::cout << "Per SubMesh." << std::endl;
+        }
+        std::cout << "------------------------------" << std::endl;
+    }
+
+    // Mip generation benchmark on the current panorama.
+    if (key == 'm') {
+        cv::Mat panorama;
+        if (skybox != nullptr)
+            panorama = cv::imread(skybox->GetPanoramaPath(), cv::IMREAD_COLOR);
+        if (!panorama.empty())
+            MipGenerator::Benchmark(panorama);
+    }
+
+    // Cube map conversion and skybox pass cost for every panorama.
+    if (key == 'c')
+        BenchmarkSkyboxes();
+
+    // Skybox drawing: sphere, full-screen triangle or streamed tiles.
+    if (key == 'k' && skybox != nullptr) {
+        const SkyboxMode previousMode = skyboxMode;
+        if (skyboxMode == SkyboxMode::Sphere)
+            skyboxMode = SkyboxMode::FullScreenTriangle;
+        else if (skyboxMode == SkyboxMode::FullScreenTriangle)
+            skyboxMode = SkyboxMode::Streamed;
+        else
+            skyboxMode = SkyboxMode::Sphere;
+        skybox->SetMode(skyboxMode);
+        std::cout << "------------------------------" << std::endl;
+        std::cout << "Skybox Mode: ";
+        if (skyboxMode == SkyboxMode::Sphere)               std::cout << "Sphere." << std::endl;
+        else if (skyboxMode == SkyboxMode::Streamed)        std::cout << "Streamed (virtual texture)." << std::endl;
+        else                                                std::cout << "Full-screen triangle." << std::endl;
+        std::cout << "------------------------------" << std::endl;
+        // The lighting cube map comes from the tiles in the streamed mode, from the cache otherwise.
+        if (previousMode == SkyboxMode::Streamed || skyboxMode == SkyboxMode::Streamed)
+            CreateSkybox(skyboxName);
+    }
+    if (key == 'v')
+        BenchmarkSkyboxPass();
+    // Time to first frame and memory of the full image against the streamed skybox.
+    if (key == 'b')
+        BenchmarkSkyboxStreaming();
+    // GL calls and CPU submit time of the model pass since the last report.
+    if (key == 'i')
+        ReportFrameStats();
+    // GPU time per pass: on-screen overlay, and a report written as CSV and JSON.
+    if (key == 'o')
+        showGpuOverlay = !showGpuOverlay;
+#if CPU_TRACE
+    // CPU zones of every thread, as a Chrome trace (chrome://tracing or ui.perfetto.dev).
+    if (key == 'y') {
+        std::cout << "------------------------------" << std::endl;
+        if (CpuTracer::IsRecording()) {
+            CpuTracer::Stop();
+            CpuTracer::WriteChromeTrace("cpu_trace.json");
+        }
+        else {
+            CpuTracer::Start();
+            std::cout << "CPU Trace: Recording." << std::endl;
+        }
+        std::cout << "------------------------------" << std::endl;
+    }
+#endif
+    if (key == 'x') {
+        gpuProfiler->ShowInfo();
+        if (gpuProfiler->WriteCsv("gpu_profile.csv") && gpuProfiler->WriteJson("gpu_profile.json"))
+            std::cout << "GPU profile written to gpu_profile.csv and gpu_profile.json" << std::endl;
+    }
+    // Redundant state call filtering on or off, reported like the ambient toggle.
+    if (key == 'f') {
+        std::cout << "------------------------------" << std::endl;
+        if (numModelPassFrames > 0) {
+            std::cout << "Model pass CPU submit time with" << (GLState::IsFiltering() ? "" : "out") << " state filtering: "
+                      << modelPassCpuMs / numModelPassFrames << " ms (" << numModelPassFrames << " frames)" << std::endl;
+        }
+        GLState::SetFiltering(!GLState::IsFiltering());
+        modelPassCpuMs = 0.0;
+        renderQueueSortMs = 0.0;
+        numModelPassFrames = 0;
+        std::cout << "State Filtering: ";
+        if (GLState::IsFiltering()) std::cout << "On." << std::endl;
+        else                        std::cout << "Off." << std::endl;
+        std::cout << "------------------------------" << std::endl;
+    }
+
+    // Ambient light: SH irradiance of the skybox or a constant. Report the model pass
+    // GPU time of the mode being left.
+    if (key == 'h') {
+        std::cout << "------------------------------" << std::endl;
+        std::cout << "Model pass GPU time with " << (useSHAmbient ? "SH" : "constant") << " ambient: "
+                  << modelPassTimer->GetAverageMs() << " ms (" << modelPassTimer->GetNumSamples() << " frames)" << std::endl;
+        useSHAmbient = !useSHAmbient;
+        modelPassTimer->Reset();
+        std::cout << "Ambient Light: ";
+        if (useSHAmbient)   std::cout << "SH irradiance." << std::endl;
+        else                std::cout << "Constant." << std::endl;
+        std::cout << "------------------------------" << std::endl;
+    }
+
+    // Skybox reflections on or off, reported like the ambient toggle.
+    if (key == 'g') {
+        std::cout << "------------------------------" << std::endl;
+        std::cout << "Model pass GPU time with" << (useEnvSpecular ? "" : "out") << " reflections: "
+                  << modelPassTimer->GetAverageMs() << " ms (" << modelPassTimer->GetNumSamples() << " frames)" << std::endl;
+        useEnvSpecular = !useEnvSpecular;
+        modelPassTimer->Reset();
+        std::cout << "Skybox Reflections: ";
+        if (useEnvSpecular) std::cout << "On." << std::endl;
+        else                std::cout << "Off." << std::endl;
+        std::cout << "------------------------------" << std::endl;
+    }
+    // Material parameters from the uniform buffer or per-draw uniforms. Report the model pass
+    // CPU submit time of the mode being left.
+    if (key == 'u') {
+        std::cout << "------------------------------" << std::endl;
+        if (numModelPassFrames > 0) {
+            std::cout << "Model pass CPU submit time with " << (useMaterialBuffer ? "the material buffer" : "material uniforms")
+                      << ": " << modelPassCpuMs / numModelPassFrames << " ms (" << numModelPassFrames << " frames)" << std::endl;
+        }
+        useMaterialBuffer = !useMaterialBuffer;
+        modelPassCpuMs = 0.0;
+        renderQueueSortMs = 0.0;
+        numModelPassFrames = 0;
+        std::cout << "Materials: ";
+        if (useMaterialBuffer)  std::cout << "Uniform buffer, one index per draw." << std::endl;
+        else                    std::cout << "Uniforms per draw." << std::endl;
+        std::cout << "------------------------------" << std::endl;
+    }
+    if (key == 'n')
+        BenchmarkMaterialSubmission();
+    // Compiled draw list or subMesh walk, reported like the material toggle.
+    if (key == 'l') {
+        std::cout << "------------------------------" << std::endl;
+        if (numModelPassFrames > 0) {
+            std::cout << "Model pass CPU submit time with the " << (useDrawList ? "draw list" : "subMesh walk") << ": "
+                      << modelPassCpuMs / numModelPassFrames << " ms (" << numModelPassFrames << " frames)" << std::endl;
+        }
+        useDrawList = !useDrawList;
+        modelPassCpuMs = 0.0;
+        renderQueueSortMs = 0.0;
+        numModelPassFrames = 0;
+        std::cout << "Model Submission: ";
+        if (useDrawList)    std::cout << "Compiled draw list." << std::endl;
+        else                std::cout << "SubMesh walk." << std::endl;
+        std::cout << "------------------------------" << std::endl;
+    }
+    if (key == 'j')
+        BenchmarkDrawList();
+    // Crowd of copies of the model: cycle its size, and draw it instanced or one copy at a time
+    // (reported like the material toggle).
+    if (key == 'z' && mesh != nullptr) {
+        const int numSizes = sizeof(crowdSizes) / sizeof(crowdSizes[0]);
+        int next = 0;
+        while (next < numSizes && crowdSizes[next] != crowdSize)
+            ++next;
+        crowdSize = crowdSizes[(next + 1) % numSizes];
+        crowdDirty = true;
+        std::cout << "------------------------------" << std::endl;
+        std::cout << "Crowd: " << crowdSize << " model(s)." << std::endl;
+        std::cout << "------------------------------" << std::endl;
+    }
+    if (key == 'q') {
+        std::cout << "------------------------------" << std::endl;
+        if (numModelPassFrames > 0) {
+            std::cout << "Model pass CPU submit time " << (useInstancing ? "instanced" : "per copy") << ", crowd of "
+                      << crowdSize << ": " << modelPassCpuMs / numModelPassFrames << " ms (" << numModelPassFrames
+                      << " frames)" << std::endl;
+        }
+        useInstancing = !useInstancing;
+        crowdDirty = true;
+        modelPassCpuMs = 0.0;
+        renderQueueSortMs = 0.0;
+        numModelPassFrames = 0;
+        std::cout << "Crowd Drawing: ";
+        if (useInstancing)  std::cout << "Instanced, one draw per subMesh." << std::endl;
+        else                std::cout << "One draw per copy and subMesh." << std::endl;
+        std::cout << "------------------------------" << std::endl;
+    }
+    if (key == 'e')
+        BenchmarkInstancing();
+    // Prefilter and disk cache timings on the current panorama.
+    if (key == 'p' && skybox != nullptr)
+        SpecularPrefilter::Benchmark(skybox->GetPanoramaPath(), skyboxFaceSize);
+
+    // Texture residency: print counters, shrink or grow the budget.
+    if (key == 'r')
+        TextureResidency::ShowInfo();
+    if (key == '-' || key == '=') {
+        if (key == '-')
+            textureBudgetInMB = std::max((size_t)16, textureBudgetInMB / 2);
+        else
+            textureBudgetInMB *= 2;
+        TextureResidency::SetBudget(textureBudgetInMB * 1024 * 1024);
+        std::cout << "------------------------------" << std::endl;
+        std::cout << "Texture Budget: " << textureBudgetInMB << " MB." << std::endl;
+        std::cout << "------------------------------" << std::endl;
+    }
+
+    // Spot light control.
+    if (spotLight != nullptr) {
+        if (key == 'a')
+            spotLight->MoveLeft(lightMoveSpeed);
+        if (key == 'd')
+            spotLight->MoveRight(lightMoveSpeed);
+        if (key == 'w')
+            spotLight->MoveUp(lightMoveSpeed);
+        if (key == 's')
+            spotLight->MoveDown(lightMoveSpeed);
+    }
+    FrameScheduler::RequestRedraw();
+}
+
+void SetupRenderState()
+{
+    glEnable(GL_DEPTH_TEST);
+    // Filter across cube map face edges.
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    glm::vec4 clearColor = glm::vec4(0.44f, 0.57f, 0.75f, 1.00f);
+    glClearColor(
+        (GLclampf)(clearColor.r), 
+        (GLclampf)(clearColor.g), 
+        (GLclampf)(clearColor.b), 
+        (GLclampf)(clearColor.a)
+    );
+}
+
+void LoadObjects(const std::string& modelPath)
+{
+    TRACE_ZONE("LoadObjects");
+    // -------------------------------------------------------
+	// Note: you can change the code below if you want to load
+    //       the model dynamically.
+	// -------------------------------------------------------
+
+    // Release the previous model; the texture arrays still point at its materials.
+    if (textureArrays != nullptr)
+        textureArrays->Clear();
+    if (mesh != nullptr) {
+        delete mesh;
+        mesh = nullptr;
+        sceneObj.mesh = nullptr;
+    }
+
+    mesh = new TriangleMesh();
+    mesh->LoadFromFile(modelPath, true);
+    modelName = modelPath;
+    mesh->ShowInfo();
+    mesh->CreateBuffers();
+    mesh->BuildTextureAtlas();
+    sceneObj.mesh = mesh;
+    // The new mesh has no instance buffer yet.
+    crowdDirty = true;
+
+    // Group the scene's textures into texture arrays.
+    if (textureArrays == nullptr)
+        textureArrays = new TextureArrayBuilder();
+    textureArrays->Clear();
+    for (const auto& subMesh : sceneObj.mesh->GetSubMeshes())
+        textureArrays->AddMaterial(subMesh.material);
+    textureArrays->Build();
+    textureArrays->ShowInfo();
+    ImageTexture::ShowIngestInfo();
+    // The draw list and the material buffer hold the atlas regions and array layers set above.
+    mesh->CompileDrawList();
+    TextureResidency::ShowInfo();
+}
+
+void CreateLights()
+{
+    TRACE_ZONE("CreateLights");
+    // Create a directional light.
+    dirLight = new DirectionalLight(dirLightDirection, dirLightRadiance);
+    /*    
+    // Create a point light.
+    pointLight = new PointLight(pointLightPosition, pointLightIntensity);
+    pointLightObj.light = pointLight;
+    pointLightObj.visColor = glm::normalize((pointLightObj.light)->GetIntensity());
+    */
+    // Create a spot light.
+    spotLight = new SpotLight(spotLightPosition, spotLightIntensity, spotLightDirection, 
+            spotLightCutoffStartInDegree, spotLightTotalWidthInDegree);
+    spotLightObj.light = spotLight;
+    spotLightObj.visColor = glm::normalize((spotLightObj.light)->GetIntensity());
+}
+
+void CreateSceneGraph()
+{
+    // A root, with the model and the light gizmos below it.
+    sceneGraph = new SceneGraph();
+    const int root = sceneGraph->AddNode(SceneGraph::kNoParent);
+    sceneObj.node = sceneGraph->AddNode(root);
+    pointLightObj.node = sceneGraph->AddNode(root);
+    spotLightObj.node = sceneGraph->AddNode(root);
+}
+
+void CreateCamera()
+{
+    // Create a camera and update view and proj matrices.
+    camera = new Camera((float)screenWidth / (float)screenHeight);
+    camera->UpdateView(cameraPos, cameraTarget, cameraUp);
+    float aspectRatio = (float)screenWidth / (float)screenHeight;
+    camera->UpdateProjection(fovy, aspectRatio, zNear, zFar);
+}
+
+void CreateSkybox(const std::string skyboxPath)
+{
+    TRACE_ZONE("CreateSkybox");
+    // -------------------------------------------------------
+	// Note: you can change the code below if you want to change
+    //       the skybox texture dynamically.
+	// -------------------------------------------------------
+    std::cout << "------------------------------" << std::endl;
+    std::cout << "Skybox backgroud: " << skyboxPath << "." << std::endl;
+    std::cout << "------------------------------" << std::endl;
+    std::string texFilePath = "./TestTextures_HW3/" + skyboxPath;
+    const int numSlices = 36;
+    const int numStacks = 18;
+    const float radius = 50.0f;
+
+    // Only the cube map changes; it comes from the cache when it was preloaded.
+    // The streamed mode opens the tiles first and builds its cube map from them.
+    const auto start = std::chrono::high_resolution_clock::now();
+    bool warm = false;
+    CubeMapTexture* cubeMap = nullptr;
+    if (skyboxMode == SkyboxMode::Streamed) {
+        if (skybox == nullptr)
+            skybox = new Skybox(nullptr, texFilePath, numSlices, numStacks, radius, skyboxMode);
+        else
+            skybox->SetEnvironment(nullptr, texFilePath);
+        cubeMap = CreateStreamedEnvironment(skybox->GetVirtualTexture());
+    }
+    else
+        cubeMap = skyboxCache->Acquire(texFilePath, &warm);
+    if (skybox == nullptr)
+        skybox = new Skybox(cubeMap, texFilePath, numSlices, numStacks, radius, skyboxMode);
+    else
+        skybox->SetEnvironment(cubeMap, texFilePath);
+    // The previous streamed cube map is not owned by the cache.
+    if (streamedEnvironment != nullptr && streamedEnvironment != cubeMap)
+        delete streamedEnvironment;
+    streamedEnvironment = (skyboxMode == SkyboxMode::Streamed) ? cubeMap : nullptr;
+    const auto end = std::chrono::high_resolution_clock::now();
+    skybox->ShowInfo();
+    std::cout << "Skybox switch: " << std::chrono::duration<double, std::milli>(end - start).count()
+              << " ms (" << ((skyboxMode == SkyboxMode::Streamed) ? "streamed" : (warm ? "warm" : "cold")) << ")" << std::endl;
+    skyboxName = skyboxPath;
+}
+
+void BenchmarkSkyboxes()
+{
+    const int numFrames = 120;
+    const std::string current = skyboxName;
+    std::vector<std::string> report;
+
+    // Drop every cached cube map so the first round is cold; the second round is warm
+    // unless the cache cap is smaller than all four panoramas.
+    skybox->SetEnvironment(nullptr, "");
+    skyboxCache->Clear();
+    double switchMs[2][4];
+    bool switchWarm[2][4];
+    frameClock.LockStep(benchmarkFrameStep);
+    for (int round = 0; round < 2; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            const auto start = std::chrono::high_resolution_clock::now();
+            CubeMapTexture* cubeMap = skyboxCache->Acquire("./TestTextures_HW3/" + skyboxNames[i], &switchWarm[round][i]);
+            skybox->SetEnvironment(cubeMap, "./TestTextures_HW3/" + skyboxNames[i]);
+            const auto end = std::chrono::high_resolution_clock::now();
+            switchMs[round][i] = std::chrono::duration<double, std::milli>(end - start).count();
+            if (round == 1 || cubeMap == nullptr)
+                continue;
+
+            // Let the first frames warm up, then average the skybox pass over the rest.
+            for (int frame = 0; frame < numFrames; ++frame) {
+                if (frame == numFrames / 4)
+                    skybox->ResetGpuTime();
+                RenderSceneCB();
+                glFinish();
+            }
+            std::ostringstream line;
+            line << std::fixed << std::setprecision(2)
+                 << std::setw(24) << skyboxNames[i] << ": convert " << std::setw(7) << cubeMap->GetConvertTime()
+                 << " ms, " << std::setw(7) << cubeMap->GetSizeInBytes() / (1024.0 * 1024.0)
+                 << " MB, SH " << std::setw(6) << cubeMap->GetProjectSHTime()
+                 << " ms, prefilter " << std::setw(7) << cubeMap->GetPrefilterTime()
+                 << (cubeMap->IsPrefilterCached() ? " (disk)" : "")
+                 << " ms, GPU " << std::setw(6) << skybox->GetGpuTime() << " ms";
+            report.push_back(line.str());
+        }
+    }
+    frameClock.Unlock();
+    CreateSkybox(current);
+
+    std::cout << "------------------------------" << std::endl;
+    std::cout << "Skybox benchmark (" << screenWidth << " x " << screenHeight << ", "
+              << GetNumWorkerThreads() << " threads)" << std::endl;
+    for (const auto& line : report)
+        std::cout << line << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (int i = 0; i < 4; ++i) {
+        std::cout << std::setw(24) << skyboxNames[i] << ": switch " << std::setw(8) << switchMs[0][i]
+                  << " ms (" << (switchWarm[0][i] ? "warm" : "cold") << "), " << std::setw(6) << switchMs[1][i]
+                  << " ms (" << (switchWarm[1][i] ? "warm" : "cold") << ")" << std::endl;
+    }
+    std::cout.unsetf(std::ios_base::floatfield);
+    skyboxCache->ShowInfo();
+    std::cout << "------------------------------" << std::endl;
+}
+
+void CreateShaderLib()
+{
+    TRACE_ZONE("CreateShaderLib");
+    fillColorShader = new FillColorShaderProg();
+    if (!fillColorShader->LoadFromFiles("shaders/fixed_color.vs", "shaders/fixed_color.fs"))
+        exit(1);
+
+    phongShadingShader = new PhongShadingDemoShaderProg();
+    if (!phongShadingShader->LoadFromFiles("shaders/phong_shading_demo.vs", "shaders/phong_shading_demo.fs"))
+        exit(1);
+    // mapKd and mapKdArray have different sampler types, so they must use different units.
+    phongShadingShader->Bind();
+    glUniform1i(phongShadingShader->GetLocMapKd(), 0);
+    glUniform1i(phongShadingShader->GetLocMapKdArray(), 1);
+    glUniform1i(phongShadingShader->GetLocEnvMap(), 2);
+    phongShadingShader->UnBind();
+    // SHLighting block: 9 irradiance coefficients, the rotations into skybox space and the
+    // environment scale, filled by UpdateSHLighting().
+    glGenBuffers(1, &shLightingUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, shLightingUbo);
+    glBufferData(GL_UNIFORM_BUFFER, 10 * sizeof(glm::vec4) + 2 * sizeof(glm::mat4x4), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, PhongShadingDemoShaderProg::shLightingBinding, shLightingUbo);
+    modelPassTimer = new GpuTimer();
+    gpuProfiler = new GpuProfiler();
+    renderQueue = new RenderQueue();
+    renderQueue->SetProfiler(gpuProfiler);
+    // FrameData block: one buffer for the lifetime of the app, rewritten once per frame.
+    glGenBuffers(1, &frameDataUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameDataUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, ShaderProg::frameDataBinding, frameDataUbo);
+
+    skyboxShader = new SkyboxShaderProg();
+    if (!skyboxShader->LoadFromFiles("shaders/skybox.vs", "shaders/skybox.fs"))
+        exit(1);
+    skyboxFullScreenShader = new SkyboxShaderProg();
+    if (!skyboxFullScreenShader->LoadFromFiles("shaders/skybox_fullscreen.vs", "shaders/skybox_fullscreen.fs"))
+        exit(1);
+    skyboxStreamedShader = new SkyboxShaderProg();
+    if (!skyboxStreamedShader->LoadFromFiles("shaders/skybox_fullscreen.vs", "shaders/skybox_streamed.fs"))
+        exit(1);
+}
+
+// Write the FrameData block: camera, skybox rotation and lights, once per frame.
+void UpdateFrameData()
+{
+    TRACE_ZONE("Update frame data");
+    frameData.viewMatrix = camera->GetViewMatrix();
+    frameData.projMatrix = camera->GetProjMatrix();
+    frameData.skyboxRotation = (skybox != nullptr) ? skybox->GetRotationMatrix() : glm::mat4x4(1.0f);
+    frameData.cameraPos = glm::vec4(camera->GetCameraPos(), 1.0f);
+    frameData.ambientLight = glm::vec4(ambientLight, 0.0f);
+    // Missing lights contribute nothing.
+    frameData.dirLightDir = glm::vec4(0.0f, 0.0f, -1.0f, 0.0f);
+    frameData.dirLightRadiance = glm::vec4(0.0f);
+    if (dirLight != nullptr) {
+        frameData.dirLightDir = glm::vec4(dirLight->GetDirection(), 0.0f);
+        frameData.dirLightRadiance = glm::vec4(dirLight->GetRadiance(), 0.0f);
+    }
+    frameData.pointLightPos = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    frameData.pointLightIntensity = glm::vec4(0.0f);
+    if (pointLight != nullptr) {
+        frameData.pointLightPos = glm::vec4(pointLight->GetPosition(), 1.0f);
+        frameData.pointLightIntensity = glm::vec4(pointLight->GetIntensity(), 0.0f);
+    }
+    frameData.spotLightPos = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+    frameData.spotLightDir = glm::vec4(0.0f, -1.0f, 0.0f, 1.0f);
+    frameData.spotLightIntensity = glm::vec4(0.0f);
+    if (spotLight != nullptr) {
+        frameData.spotLightPos = glm::vec4(spotLight->GetPosition(), spotLight->GetTotalWidth());
+        frameData.spotLightDir = glm::vec4(spotLight->GetDirection(), spotLight->GetCutoffStart());
+        frameData.spotLightIntensity = glm::vec4(spotLight->GetIntensity(), 0.0f);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, frameDataUbo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &frameData);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void ReportFrameStats()
+{
+    std::cout << "------------------------------" << std::endl;
+    std::cout << "GL calls per frame: " << numFrameGLCalls << " (model pass " << numModelGLCalls << ", "
+              << ((mesh != nullptr) ? mesh->GetNumSubMeshes() : 0) << " subMeshes)" << std::endl;
+    std::cout << "State calls per frame: " << numFrameIssued << " issued, " << numFrameFiltered << " filtered as redundant ("
+              << (GLState::IsFiltering() ? "filtering on" : "filtering off") << ")" << std::endl;
+    if (numModelPassFrames > 0) {
+        std::cout << "Model pass CPU submit time: " << modelPassCpuMs / numModelPassFrames << " ms ("
+                  << numModelPassFrames << " frames)" << std::endl;
+        std::cout << "Render queue: " << renderQueue->GetNumDraws() << " draws, " << renderQueue->GetNumStateChanges()
+                  << " state changes, " << renderQueue->GetNumSkipped() << " redundant skipped, sort "
+                  << renderQueueSortMs * 1000.0 / numModelPassFrames << " us" << std::endl;
+    }
+    if (useCulling && crowdBvh != nullptr) {
+        const Bvh::CullStats& stats = crowdBvh->GetCullStats();
+        std::cout << "Culling: " << crowdBvh->GetNumObjects() << " models, " << stats.numNodesTested << " BVH nodes and "
+                  << stats.numObjectsTested << " models tested, " << stats.numCulled << " culled, " << stats.numVisible
+                  << " drawn; subMeshes " << numSubMeshesTested << " tested, " << numSubMeshesCulled << " culled" << std::endl;
+    }
+    std::cout << "------------------------------" << std::endl;
+    modelPassCpuMs = 0.0;
+    renderQueueSortMs = 0.0;
+    numModelPassFrames = 0;
+    FrameScheduler::ShowInfo();
+}
+
+void BenchmarkMaterialSubmission()
+{
+    if (mesh == nullptr || mesh->GetNumSubMeshes() == 0)
+        return;
+    // Submit the model several times per frame so that there are hundreds of draws.
+    const int minDraws = 600;
+    const int numFrames = 100;
+    const int numSubMeshes = mesh->GetNumSubMeshes();
+    const bool savedUseMaterialBuffer = useMaterialBuffer;
+    const int numRepeats = (minDraws + numSubMeshes - 1) / numSubMeshes;
+    const int numDraws = numSubMeshes * numRepeats;
+    modelPassRepeats = numRepeats;
+    double cpuMs[2];
+    size_t numGLCalls[2];
+    frameClock.LockStep(benchmarkFrameStep);
+
+    for (int m = 0; m < 2; ++m) {
+        useMaterialBuffer = (m == 1);
+        for (int frame = 0; frame < numFrames + numFrames / 4; ++frame) {
+            if (frame == numFrames / 4) {
+                modelPassCpuMs = 0.0;
+                renderQueueSortMs = 0.0;
+                numModelPassFrames = 0;
+            }
+            RenderSceneCB();
+            glFinish();
+        }
+        cpuMs[m] = modelPassCpuMs / numModelPassFrames;
+        numGLCalls[m] = numModelGLCalls;
+    }
+    frameClock.Unlock();
+    useMaterialBuffer = savedUseMaterialBuffer;
+    modelPassRepeats = 1;
+    modelPassCpuMs = 0.0;
+    renderQueueSortMs = 0.0;
+    numModelPassFrames = 0;
+
+    std::cout << "------------------------------" << std::endl;
+    std::cout << "Material submission, " << numDraws << " draws per frame (" << numSubMeshes << " subMeshes x "
+              << numRepeats << ")" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    const char* names[2] = { "Uniforms per draw: ", "Material buffer:   " };
+    for (int m = 0; m < 2; ++m) {
+        std::cout << names[m] << cpuMs[m] << " ms CPU, " << cpuMs[m] * 1000.0 / numDraws << " us and "
+                  << (double)numGLCalls[m] / numDraws << " GL calls per draw" << std::endl;
+    }
+    std::cout.unsetf(std::ios_base::floatfield);
+    std::cout << "------------------------------" << std::endl;
+}
+
+void BenchmarkDrawList()
+{
+    if (mesh == nullptr)
+        return;
+    // CPU time to submit the model pass, alone and as many instances (the model submitted
+    // that many times per frame).
+    const int numFrames = 100;
+    const int instances[2] = { 1, 64 };
+    const bool savedUseDrawList = useDrawList;
+    double cpuMs[2][2];
+    frameClock.LockStep(benchmarkFrameStep);
+
+    for (int n = 0; n < 2; ++n) {
+        modelPassRepeats = instances[n];
+        for (int m = 0; m < 2; ++m) {
+            useDrawList = (m == 1);
+            for (int frame = 0; frame < numFrames + numFrames / 4; ++frame) {
+                if (frame == numFrames / 4) {
+                    modelPassCpuMs = 0.0;
+                    renderQueueSortMs = 0.0;
+                    numModelPassFrames = 0;
+                }
+                RenderSceneCB();
+                glFinish();
+            }
+            cpuMs[n][m] = modelPassCpuMs / numModelPassFrames;
+        }
+    }
+    frameClock.Unlock();
+    useDrawList = savedUseDrawList;
+    modelPassRepeats = 1;
+    modelPassCpuMs = 0.0;
+    renderQueueSortMs = 0.0;
+    numModelPassFrames = 0;
+
+    std::cout << "------------------------------" << std::endl;
+    std::cout << "Model pass CPU submit time, " << modelName << " (" << mesh->GetNumSubMeshes() << " subMeshes)" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for (int n = 0; n < 2; ++n) {
+        std::cout << std::setw(3) << instances[n] << " instance(s): subMesh walk " << cpuMs[n][0] << " ms, draw list "
+                  << cpuMs[n][1] << " ms" << std::endl;
+    }
+    std::cout.unsetf(std::ios_base::floatfield);
+    std::cout << "------------------------------" << std::endl;
+}
+
+void BenchmarkInstancing()
+{
+    if (mesh == nullptr)
+        return;
+    // Frame time and CPU submit time against the number of copies of the model, drawn
+    // instanced and one draw per copy. Per copy runs with too many draws are skipped.
+    const int numFrames = 40;
+    const int counts[5] = { 1, 10, 100, 1000, 10000 };
+    const int maxDrawsPerCopy = 200000;
+    const int savedCrowdSize = crowdSize;
+    const bool savedUseInstancing = useInstancing;
+    double frameMs[5][2];
+    double cpuMs[5][2];
+    frameClock.LockStep(benchmarkFrameStep);
+
+    for (int n = 0; n < 5; ++n) {
+        crowdSize = counts[n];
+        for (int m = 0; m < 2; ++m) {
+            useInstancing = (m == 1);
+            crowdDirty = true;
+            frameMs[n][m] = cpuMs[n][m] = -1.0;
+            if (!useInstancing && crowdSize * mesh->GetNumSubMeshes() > maxDrawsPerCopy)
+                continue;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int frame = 0; frame < numFrames + numFrames / 4; ++frame) {
+                if (frame == numFrames / 4) {
+                    modelPassCpuMs = 0.0;
+                    renderQueueSortMs = 0.0;
+                    numModelPassFrames = 0;
+                    start = std::chrono::high_resolution_clock::now();
+                }
+                RenderSceneCB();
+                glFinish();
+            }
+            const auto end = std::chrono::high_resolution_clock::now();
+            frameMs[n][m] = std::chrono::duration<double, std::milli>(end - start).count() / numFrames;
+            cpuMs[n][m] = modelPassCpuMs / numModelPassFrames;
+        }
+    }
+    frameClock.Unlock();
+    crowdSize = savedCrowdSize;
+    useInstancing = savedUseInstancing;
+    crowdDirty = true;
+    modelPassCpuMs = 0.0;
+    renderQueueSortMs = 0.0;
+    numModelPassFrames = 0;
+
+    std::cout << "------------------------------" << std::endl;
+    std::cout << "Frame time (CPU submit) by crowd size, " << modelName << " (" << mesh->GetNumSubMeshes() << " subMeshes)" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for (int n = 0; n < 5; ++n) {
+        std::cout << std::setw(5) << counts[n] << " model(s): per copy ";
+        if (frameMs[n][0] < 0.0)
+            std::cout << "skipped (" << counts[n] * mesh->GetNumSubMeshes() << " draws)";
+        else
+            std::cout << frameMs[n][0] << " ms (" << cpuMs[n][0] << " ms)";
+        std::cout << ", instanced " << frameMs[n][1] << " ms (" << cpuMs[n][1] << " ms)" << std::endl;
+    }
+    std::cout.unsetf(std::ios_base::floatfield);
+    std::cout << "------------------------------" << std::endl;
+}
+
+// Refresh the SHLighting block: the coefficients when the skybox changed, the rotations every frame.
+void UpdateSHLighting()
+{
+    TRACE_ZONE("Update SH lighting");
+    if (skybox == nullptr || skybox->GetTexture() == nullptr)
+        return;
+    glBindBuffer(GL_UNIFORM_BUFFER, shLightingUbo);
+    if (skybox->GetEnvironmentId() != shLightingEnvironment) {
+        glm::vec4 coeffs[9];
+        const float scale = SphericalHarmonics::GetIrradianceCoefficients(skybox->GetTexture()->GetRadianceSH(), ambientLight, coeffs);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(coeffs), coeffs);
+        const glm::vec4 envScale = glm::vec4(scale);
+        glBufferSubData(GL_UNIFORM_BUFFER, 9 * sizeof(glm::vec4) + 2 * sizeof(glm::mat4x4), sizeof(glm::vec4), glm::value_ptr(envScale));
+        shLightingEnvironment = skybox->GetEnvironmentId();
+    }
+    // The demo shader gets view space normals: back to world space, then into skybox space.
+    glm::mat4x4 viewRotation = glm::mat4x4(glm::mat3x3(camera->GetViewMatrix()));
+    glm::mat4x4 worldToSkybox = glm::transpose(skybox->GetRotationMatrix());
+    glm::mat4x4 normalToSkybox = worldToSkybox * glm::transpose(viewRotation);
+    glBufferSubData(GL_UNIFORM_BUFFER, 9 * sizeof(glm::vec4), sizeof(glm::mat4x4), glm::value_ptr(normalToSkybox));
+    glBufferSubData(GL_UNIFORM_BUFFER, 9 * sizeof(glm::vec4) + sizeof(glm::mat4x4), sizeof(glm::mat4x4), glm::value_ptr(worldToSkybox));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void BenchmarkSkyboxPass()
+{
+    if (skybox == nullptr)
+        return;
+    const int numFrames = 120;
+    const int sizes[2][2] = { { 600, 600 }, { 3840, 2160 } };
+    const SkyboxMode modes[2] = { SkyboxMode::Sphere, SkyboxMode::FullScreenTriangle };
+    double gpuTimes[2][2];
+    frameClock.LockStep(benchmarkFrameStep);
+
+    for (int i = 0; i < 2; ++i) {
+        // Render offscreen so that the window size does not matter.
+        const int width = sizes[i][0];
+        const int height = sizes[i][1];
+        GLuint fbo, colorBuffer, depthBuffer;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        glViewport(0, 0, width, height);
+        camera->UpdateProjection(fovy, (float)width / (float)height, zNear, zFar);
+
+        for (int m = 0; m < 2; ++m) {
+            skybox->SetMode(modes[m]);
+            for (int frame = 0; frame < numFrames; ++frame) {
+                if (frame == numFrames / 4)
+                    skybox->ResetGpuTime();
+                RenderSceneCB();
+                glFinish();
+            }
+            gpuTimes[i][m] = skybox->GetGpuTime();
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        glDeleteFramebuffers(1, &fbo);
+    }
+    frameClock.Unlock();
+    skybox->SetMode(skyboxMode);
+    glViewport(0, 0, screenWidth, screenHeight);
+    camera->UpdateProjection(fovy, (float)screenWidth / (float)screenHeight, zNear, zFar);
+
+    std::cout << "------------------------------" << std::endl;
+    std::cout << "Skybox pass GPU time (single sample, model in view)" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for (int i = 0; i < 2; ++i) {
+        std::cout << std::setw(5) << sizes[i][0] << " x " << std::setw(4) << sizes[i][1]
+                  << ": sphere " << gpuTimes[i][0] << " ms, full-screen triangle " << gpuTimes[i][1] << " ms" << std::endl;
+    }
+    std::cout.unsetf(std::ios_base::floatfield);
+    std::cout << "------------------------------" << std::endl;
+}
+
+// Lighting cube map of the streamed skybox, from the finest tile level at most
+// streamedLightingWidth wide. cpuBytes gets the memory the level and the faces took.
+CubeMapTexture* CreateStreamedEnvironment(const VirtualTexture* virtualTexture, size_t* cpuBytes)
+{
+    cv::Mat level;
+    if (virtualTexture == nullptr || !virtualTexture->ReadLevel(streamedLightingWidth, level))
+        return nullptr;
+    CubeMapFaces faces;
+    if (!CubeMapTexture::BuildFaces(level, 0, faces, virtualTexture->GetPanoramaPath()))
+        return nullptr;
+    if (cpuBytes != nullptr)
+        *cpuBytes = level.total() * level.elemSize() + faces.GetSizeInBytes();
+    return new CubeMapTexture(faces);
+}
+
+void BenchmarkSkyboxStreaming()
+{
+    if (skybox == nullptr)
+        return;
+    const std::string path = skybox->GetPanoramaPath();
+    const int maxFrames = 300;
+
+    // The tile file is baked once per panorama, so it is reported apart from the first frame.
+    bool baked = false;
+    double bakeMs = 0.0;
+    if (!VirtualTexture::PrepareTiles(path, &baked, &bakeMs))
+        return;
+    CubeMapTexture* previousEnvironment = skybox->GetTexture();
+    skybox->SetMode(SkyboxMode::FullScreenTriangle);
+
+    // Full image: decode, convert to the cube map and upload, as a cold switch does.
+    auto start = std::chrono::high_resolution_clock::now();
+    cv::Mat panorama = cv::imread(path, cv::IMREAD_COLOR);
+    CubeMapFaces faces;
+    if (!CubeMapTexture::BuildFaces(panorama, skyboxFaceSize, faces, path)) {
+        skybox->SetMode(skyboxMode);
+        return;
+    }
+    frameClock.LockStep(benchmarkFrameStep);
+    const size_t fullCpuBytes = panorama.total() * panorama.elemSize() + faces.GetSizeInBytes();
+    CubeMapTexture* fullEnvironment = new CubeMapTexture(faces);
+    panorama.release();
+    faces = CubeMapFaces();
+    skybox->SetEnvironment(fullEnvironment, path);
+    RenderSceneCB();
+    glFinish();
+    auto end = std::chrono::high_resolution_clock::now();
+    const double fullMs = std::chrono::duration<double, std::milli>(end - start).count();
+    const size_t fullGpuBytes = fullEnvironment->GetSizeInBytes();
+
+    // Streamed: open the tiles, light from a coarse level and draw with the root tile, then
+    // keep drawing until every tile the view needs is resident.
+    start = std::chrono::high_resolution_clock::now();
+    skybox->SetMode(SkyboxMode::Streamed);
+    size_t lightingCpuBytes = 0;
+    CubeMapTexture* lightingEnvironment = CreateStreamedEnvironment(skybox->GetVirtualTexture(), &lightingCpuBytes);
+    skybox->SetEnvironment(lightingEnvironment, path);
+    RenderSceneCB();
+    glFinish();
+    end = std::chrono::high_resolution_clock::now();
+    const double firstMs = std::chrono::duration<double, std::milli>(end - start).count();
+    int numFrames = 1;
+    VirtualTexture* virtualTexture = skybox->GetVirtualTexture();
+    while (virtualTexture != nullptr && !virtualTexture->IsComplete() && numFrames < maxFrames) {
+        RenderSceneCB();
+        glFinish();
+        ++numFrames;
+    }
+    end = std::chrono::high_resolution_clock::now();
+    const double sharpMs = std::chrono::duration<double, std::milli>(end - start).count();
+    const bool complete = (virtualTexture != nullptr && virtualTexture->IsComplete());
+    size_t streamedCpuBytes = lightingCpuBytes;
+    size_t streamedGpuBytes = (lightingEnvironment != nullptr) ? lightingEnvironment->GetSizeInBytes() : 0;
+    int virtualWidth = 0;
+    int virtualHeight = 0;
+    if (virtualTexture != nullptr) {
+        streamedCpuBytes += virtualTexture->GetPeakCpuBytes();
+        streamedGpuBytes += virtualTexture->GetGpuBytes();
+        virtualWidth = virtualTexture->GetWidth();
+        virtualHeight = virtualTexture->GetHeight();
+    }
+
+    // Back to the skybox as it was.
+    frameClock.Unlock();
+    skybox->SetMode(skyboxMode);
+    skybox->SetEnvironment(previousEnvironment, path);
+    delete fullEnvironment;
+    delete lightingEnvironment;
+
+    std::cout << "------------------------------" << std::endl;
+    std::cout << "Skybox streaming: " << path << " (" << virtualWidth << " x " << virtualHeight << " virtual, ";
+    if (baked)  std::cout << "tiles baked in " << bakeMs << " ms)" << std::endl;
+    else        std::cout << "tiles up to date)" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Full image: first frame " << fullMs << " ms, CPU peak " << fullCpuBytes / (1024.0 * 1024.0)
+              << " MB, GPU " << fullGpuBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    std::cout << "Streamed  : first frame " << firstMs << " ms, " << (complete ? "sharp after " : "still loading after ")
+              << sharpMs << " ms (" << numFrames << " frames), CPU peak " << streamedCpuBytes / (1024.0 * 1024.0)
+              << " MB, GPU " << streamedGpuBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    std::cout.unsetf(std::ios_base::floatfield);
+    std::cout << "(Both include the lighting cube map; the streamed one is built from the "
+              << streamedLightingWidth << " wide level. Memory is what the skybox holds, not the process total.)" << std::endl;
+    std::cout << "------------------------------" << std::endl;
+}
+
+// Menu events.
+void processModelMenuEvents(int option) {
+    TRACE_ZONE("Switch model");
+    std::string model;
+    switch (option) {
+    case 1:
+        model = "Arcanine";
+        break;
+    case 2:
+        model = "Ferrari";
+        break;
+    case 3:
+        model = "Gengar";
+        break;
+    case 4:
+        model = "Ivysaur";
+        break;
+    case 5:
+        model = "Koffing";
+        break;
+    case 6:
+        model = "MagikarpF";
+        break;
+    case 7:
+        model = "Rose";
+        break;
+    case 8:
+        model = "Slowbro";
+        break;
+    case 9:
+        model = "TexCube";
+        break;
+    case 10:
+        model = "AnyaForger";
+        break;
+    }
+
+    LoadObjects(model);
+    FrameScheduler::RequestRedraw();
+}
+
+void processSkyboxMenuEvents(int option) {
+    TRACE_ZONE("Switch skybox");
+    std::string skybox;
+    if (option >= 1 && option <= 4)
+        skybox = skyboxNames[option - 1];
+
+    CreateSkybox(skybox);
+    FrameScheduler::RequestRedraw();
+}
+
+// Create menu.
+void createModelMenus() {
+
+    int menu;
+
+    // create the menu and tell glut that "processModelMenuEvents" will handle the events
+    menu = glutCreateMenu(processModelMenuEvents);
+
+    //add entries to our menu
+    glutAddMenuEntry("Arcanine", 1);
+    glutAddMenuEntry("Ferrari", 2);
+    glutAddMenuEntry("Gengar", 3);
+    glutAddMenuEntry("Ivysaur", 4);
+    glutAddMenuEntry("Koffing", 5);
+    glutAddMenuEntry("MagikarpF", 6);
+    glutAddMenuEntry("Rose", 7);
+    glutAddMenuEntry("Slowbro", 8);
+    glutAddMenuEntry("TexCube", 9);
+    glutAddMenuEntry("AnyaForger", 10);
+
+    // attach the menu to the left button
+    glutAttachMenu(GLUT_RIGHT_BUTTON);
+}
+
+void createSkyboxMenus() {
+
+    int menu;
+
+    // create the menu and tell glut that "processSkyboxMenuEvents" will handle the events
+    menu = glutCreateMenu(processSkyboxMenuEvents);
+
+    //add entries to our menu
+    glutAddMenuEntry("Photo Studio", 1);
+    glutAddMenuEntry("Sunflowers", 2);
+    glutAddMenuEntry("Veranda", 3);
+    glutAddMenuEntry("NTPU EECS Building", 4);
+
+    // attach the menu to the left button
+    glutAttachMenu(GLUT_LEFT_BUTTON);
+}
+
+int main(int argc, char** argv)
+{
+#if CPU_TRACE
+    // Trace the startup; 'y' writes the trace and stops, or starts a new one.
+    CpuTracer::Start();
+#endif
+    TRACE_THREAD_NAME("Render");
+    // Setting window properties.
+    glutInit(&argc, argv);
+    glutSetOption(GLUT_MULTISAMPLE, 4);
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH | GLUT_MULTISAMPLE);
+    glutInitWindowSize(screenWidth, screenHeight);
+    glutInitWindowPosition(100, 100);
+    glutCreateWindow("Texture Mapping");
+
+    // Initialize GLEW.
+    // Must be done after glut is initialized!
+    GLenum res = glewInit();
+    if (res != GLEW_OK) {
+        std::cerr << "GLEW initialization error: " 
+                  << glewGetErrorString(res) << std::endl;
+        return 1;
+    }
+
+    // Initialization.
+    {
+        TRACE_ZONE("Startup");
+        TextureResidency::SetBudget(textureBudgetInMB * 1024 * 1024);
+        SetupRenderState();
+        CreateLights();
+        CreateSceneGraph();
+        CreateCamera();
+        skyboxCache = new SkyboxCache(skyboxCacheInMB * 1024 * 1024, skyboxFaceSize);
+        std::vector<std::string> skyboxPaths;
+        for (const std::string& name : skyboxNames)
+            skyboxPaths.push_back("./TestTextures_HW3/" + name);
+        skyboxCache->Preload(skyboxPaths);
+        CreateSkybox("ntpu_EECSBuilding.png");
+        CreateShaderLib();
+        LoadObjects("AnyaForger");
+        createModelMenus();     // Click right mouse button.
+        createSkyboxMenus();    // Click left mouse button.
+    }
+
+    // Register callback functions.
+    glutDisplayFunc(RenderSceneCB);
+    glutReshapeFunc(ReshapeCB);
+    glutSpecialFunc(ProcessSpecialKeysCB);
+    glutKeyboardFunc(ProcessKeysCB);
+    // Redraw on demand, and at the target rate while animating.
+    FrameScheduler::Init(targetFrameRate);
+
+    // Start rendering loop.
+    glutMainLoop();
+
+    return 0;
+}
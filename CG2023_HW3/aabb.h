@@ -0,0 +1,47 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "headers.h"
+
+#include <limits>
+
+// Aabb Declarations.
+// Axis-aligned bounding box; an empty box has min above max.
+struct Aabb
+{
+	Aabb() {
+		min = glm::vec3(std::numeric_limits<float>::max());
+		max = glm::vec3(std::numeric_limits<float>::lowest());
+	}
+	Aabb(const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		min = boxMin;
+		max = boxMax;
+	}
+
+	bool IsEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+	glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+	glm::vec3 GetExtent() const { return (max - min) * 0.5f; }
+	void Grow(const glm::vec3& point) {
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+	void Grow(const Aabb& box) {
+		min = glm::min(min, box.min);
+		max = glm::max(max, box.max);
+	}
+	// The box around this one transformed by an affine matrix (center and absolute extents).
+	Aabb Transform(const glm::mat4x4& matrix) const {
+		if (IsEmpty())
+			return *this;
+		const glm::vec3 center = glm::vec3(matrix * glm::vec4(GetCenter(), 1.0f));
+		const glm::mat3x3 absMatrix = glm::mat3x3(glm::abs(glm::vec3(matrix[0])), glm::abs(glm::vec3(matrix[1])),
+												  glm::abs(glm::vec3(matrix[2])));
+		const glm::vec3 extent = absMatrix * GetExtent();
+		return Aabb(center - extent, center + extent);
+	}
+
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "allocationcounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	thread_local size_t numAllocations = 0;
+	thread_local size_t numBytes = 0;
+
+	void* CountedAlloc(size_t size)
+	{
+		++numAllocations;
+		numBytes += size;
+		return std::malloc(size > 0 ? size : 1);
+	}
+}
+
+size_t AllocationCounter::GetNumAllocations()
+{
+	return numAllocations;
+}
+
+size_t AllocationCounter::GetNumBytes()
+{
+	return numBytes;
+}
+
+// Replacements of the global allocation functions.
+void* operator new(size_t size)
+{
+	void* p = CountedAlloc(size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	void* p = CountedAlloc(size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAlloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
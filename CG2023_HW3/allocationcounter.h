@@ -0,0 +1,18 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+// AllocationCounter Declarations.
+// Counts the calls to the global operator new (replaced in allocationcounter.cpp) made by the
+// calling thread, so that the render loop can check that a steady-state frame does not touch
+// the heap. Loader and streaming threads keep their own counts.
+class AllocationCounter
+{
+public:
+	// AllocationCounter Public Methods.
+	static size_t GetNumAllocations();
+	static size_t GetNumBytes();
+};
+
+#endif
@@ -0,0 +1,225 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <random>
+
+const int Bvh::kMaxLeafObjects;
+
+Bvh::Bvh()
+{
+	refitPending = false;
+	stats = { 0, 0, 0, 0 };
+}
+
+void Bvh::Build(const std::vector<Aabb>& objectBoxes)
+{
+	TRACE_ZONE("Build BVH");
+	boxes = objectBoxes;
+	const int numObjects = (int)boxes.size();
+	objects.resize(numObjects);
+	std::vector<glm::vec3> centers(numObjects);
+	for (int i = 0; i < numObjects; ++i) {
+		objects[i] = i;
+		centers[i] = boxes[i].GetCenter();
+	}
+	nodes.clear();
+	refitPending = false;
+	if (numObjects == 0)
+		return;
+	// A binary tree with leaves of at least one object has fewer than 2n nodes.
+	nodes.reserve(2 * numObjects);
+	Node root;
+	root.first = 0;
+	root.count = numObjects;
+	root.left = -1;
+	nodes.push_back(root);
+	BuildNode(0, centers);
+}
+
+void Bvh::BuildNode(const int node, const std::vector<glm::vec3>& centers)
+{
+	const int first = nodes[node].first;
+	const int count = nodes[node].count;
+	Aabb bounds;
+	Aabb centerBounds;
+	for (int i = first; i < first + count; ++i) {
+		bounds.Grow(boxes[objects[i]]);
+		centerBounds.Grow(centers[objects[i]]);
+	}
+	nodes[node].bounds = bounds;
+	if (count <= kMaxLeafObjects)
+		return;
+
+	// Median split along the axis the centers spread the most.
+	const glm::vec3 spread = centerBounds.max - centerBounds.min;
+	const int axis = (spread.x >= spread.y && spread.x >= spread.z) ? 0 : (spread.y >= spread.z ? 1 : 2);
+	const int half = count / 2;
+	std::nth_element(objects.begin() + first, objects.begin() + first + half, objects.begin() + first + count,
+					 [&](const int a, const int b) { return centers[a][axis] < centers[b][axis]; });
+
+	const int left = (int)nodes.size();
+	Node child;
+	child.left = -1;
+	child.first = first;
+	child.count = half;
+	nodes.push_back(child);
+	child.first = first + half;
+	child.count = count - half;
+	nodes.push_back(child);
+	nodes[node].left = left;
+	BuildNode(left, centers);
+	BuildNode(left + 1, centers);
+}
+
+void Bvh::SetBounds(const int object, const Aabb& box)
+{
+	boxes[object] = box;
+	refitPending = true;
+}
+
+void Bvh::Refit()
+{
+	if (!refitPending)
+		return;
+	TRACE_ZONE("Refit BVH");
+	// Children come after their parent: backwards, every child is done before its parent.
+	for (int i = (int)nodes.size() - 1; i >= 0; --i) {
+		Node& node = nodes[i];
+		Aabb bounds;
+		if (node.left < 0) {
+			for (int j = node.first; j < node.first + node.count; ++j)
+				bounds.Grow(boxes[objects[j]]);
+		}
+		else {
+			bounds = nodes[node.left].bounds;
+			bounds.Grow(nodes[node.left + 1].bounds);
+		}
+		node.bounds = bounds;
+	}
+	refitPending = false;
+}
+
+void Bvh::AddObjects(const Node& node, std::vector<int>& visible) const
+{
+	visible.insert(visible.end(), objects.begin() + node.first, objects.begin() + node.first + node.count);
+}
+
+void Bvh::Cull(const Frustum& frustum, std::vector<int>& visible)
+{
+	TRACE_ZONE("Cull BVH");
+	Refit();
+	visible.clear();
+	stats = { 0, 0, 0, 0 };
+	if (nodes.empty())
+		return;
+	stack.clear();
+	stack.push_back(0);
+	stack.push_back((int)Frustum::kAllPlanes);
+	while (!stack.empty()) {
+		uint32_t planeMask = (uint32_t)stack.back();
+		stack.pop_back();
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		++stats.numNodesTested;
+		const Frustum::Result result = frustum.Classify(node.bounds, planeMask);
+		if (result == Frustum::Result::Outside)
+			continue;
+		if (result == Frustum::Result::Inside) {
+			AddObjects(node, visible);
+			continue;
+		}
+		if (node.left >= 0) {
+			stack.push_back(node.left + 1);
+			stack.push_back((int)planeMask);
+			stack.push_back(node.left);
+			stack.push_back((int)planeMask);
+			continue;
+		}
+		// A leaf crossing the frustum: its objects on their own boxes.
+		for (int i = node.first; i < node.first + node.count; ++i) {
+			++stats.numObjectsTested;
+			uint32_t objectMask = planeMask;
+			if (frustum.Classify(boxes[objects[i]], objectMask) != Frustum::Result::Outside)
+				visible.push_back(objects[i]);
+		}
+	}
+	stats.numVisible = (int)visible.size();
+	stats.numCulled = GetNumObjects() - stats.numVisible;
+}
+
+void Bvh::Benchmark(const glm::mat4x4& viewProj, const int numObjects)
+{
+	if (numObjects <= 0)
+		return;
+	// Unit-sized boxes scattered through a 400 x 40 x 400 volume around the origin.
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> horizontal(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> vertical(-20.0f, 20.0f);
+	std::uniform_real_distribution<float> size(0.25f, 1.0f);
+	std::vector<Aabb> boxes(numObjects);
+	for (Aabb& box : boxes) {
+		const glm::vec3 center(horizontal(rng), vertical(rng), horizontal(rng));
+		const glm::vec3 extent(size(rng), size(rng), size(rng));
+		box = Aabb(center - extent, center + extent);
+	}
+	Frustum frustum;
+	frustum.Extract(viewProj);
+
+	typedef std::chrono::high_resolution_clock Clock;
+	const int numRuns = 10;
+	auto best = [&](auto run) {
+		double bestMs = std::numeric_limits<double>::max();
+		for (int i = 0; i < numRuns; ++i) {
+			const auto start = Clock::now();
+			run();
+			bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+		}
+		return bestMs;
+	};
+	int numScalarVisible = 0;
+	const double scalarMs = best([&]() {
+		numScalarVisible = 0;
+		for (const Aabb& box : boxes)
+			numScalarVisible += frustum.IsVisibleScalar(box) ? 1 : 0;
+	});
+	int numSimdVisible = 0;
+	const double simdMs = best([&]() {
+		numSimdVisible = 0;
+		for (const Aabb& box : boxes)
+			numSimdVisible += frustum.IsVisible(box) ? 1 : 0;
+	});
+	Bvh bvh;
+	const double buildMs = best([&]() { bvh.Build(boxes); });
+	std::vector<int> visible;
+	visible.reserve(numObjects);
+	const double cullMs = best([&]() { bvh.Cull(frustum, visible); });
+	const CullStats cullStats = bvh.GetCullStats();
+	// Move every object a little, refit and cull again.
+	std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+	for (int i = 0; i < numObjects; ++i) {
+		const glm::vec3 move(jitter(rng), jitter(rng), jitter(rng));
+		boxes[i] = Aabb(boxes[i].min + move, boxes[i].max + move);
+	}
+	const double refitMs = best([&]() {
+		for (int i = 0; i < numObjects; ++i)
+			bvh.SetBounds(i, boxes[i]);
+		bvh.Refit();
+	});
+	const double refitCullMs = best([&]() { bvh.Cull(frustum, visible); });
+
+	std::cout << "------------------------------" << std::endl;
+	std::cout << "Frustum culling benchmark: " << numObjects << " boxes, " << bvh.GetNumNodes() << " BVH nodes" << std::endl;
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "Every box, scalar:   " << scalarMs << " ms (" << numScalarVisible << " visible)" << std::endl;
+	std::cout << "Every box, SSE:      " << simdMs << " ms (" << numSimdVisible << " visible)" << std::endl;
+	std::cout << "BVH walk:            " << cullMs << " ms (" << cullStats.numNodesTested << " nodes and "
+			  << cullStats.numObjectsTested << " objects tested, " << cullStats.numCulled << " culled, "
+			  << cullStats.numVisible << " visible)" << std::endl;
+	std::cout << "BVH walk, refitted:  " << refitCullMs << " ms (" << bvh.GetCullStats().numNodesTested << " nodes tested)" << std::endl;
+	std::cout << "Build:               " << buildMs << " ms" << std::endl;
+	std::cout << "Refit, all moved:    " << refitMs << " ms" << std::endl;
+	std::cout.unsetf(std::ios_base::floatfield);
+	std::cout << "------------------------------" << std::endl;
+}
@@ -0,0 +1,75 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "headers.h"
+#include "aabb.h"
+#include "frustum.h"
+
+// Bvh Declarations.
+// Bounding volume hierarchy over the boxes of scene objects, for frustum culling. Build()
+// splits the objects top down at the median of their centers along the widest axis, down to
+// kMaxLeafObjects per leaf; the nodes are one array in which children come after their parent,
+// and the objects of every subtree are contiguous. When objects move, SetBounds() then Refit()
+// grows the boxes bottom up and keeps the tree: cheap, but the tree loosens as objects wander,
+// so build again when the set of objects changes.
+// Cull() walks the tree against a frustum: a node outside is skipped with its subtree, a node
+// inside takes its subtree without further tests, and the children of a node that crosses
+// the frustum only test the planes it crosses.
+class Bvh
+{
+public:
+	// Bvh Public Types.
+	struct CullStats
+	{
+		int numNodesTested;
+		int numObjectsTested;			// Objects tested on their own box (in crossing leaves).
+		int numCulled;
+		int numVisible;
+	};
+
+	// Bvh Public Methods.
+	Bvh();
+
+	void Build(const std::vector<Aabb>& boxes);
+	void SetBounds(const int object, const Aabb& box);
+	void Refit();
+	// Replaces visible with the indices of the objects in or crossing the frustum.
+	void Cull(const Frustum& frustum, std::vector<int>& visible);
+
+	int GetNumObjects() const { return (int)boxes.size(); }
+	int GetNumNodes() const { return (int)nodes.size(); }
+	const Aabb& GetBounds(const int object) const { return boxes[object]; }
+	// Of the last Cull().
+	const CullStats& GetCullStats() const { return stats; }
+
+	// Cull a generated scene of numObjects boxes with the view-projection matrix: every box
+	// tested with the scalar and the SSE test against the tree walk, and the cost of refitting
+	// and building the tree.
+	static void Benchmark(const glm::mat4x4& viewProj, const int numObjects = 100000);
+
+	static const int kMaxLeafObjects = 4;
+
+private:
+	// Bvh Private Types.
+	struct Node
+	{
+		Aabb bounds;
+		int first;						// Objects [first, first + count) of objects.
+		int count;
+		int left;						// Children left and left + 1; -1 for a leaf.
+	};
+
+	// Bvh Private Methods.
+	void BuildNode(const int node, const std::vector<glm::vec3>& centers);
+	void AddObjects(const Node& node, std::vector<int>& visible) const;
+
+	// Bvh Private Data.
+	std::vector<Aabb> boxes;			// By object.
+	std::vector<Node> nodes;
+	std::vector<int> objects;			// Object indices in leaf order.
+	std::vector<int> stack;				// Scratch of Cull(): node and plane mask pairs.
+	bool refitPending;
+	CullStats stats;
+};
+
+#endif
@@ -0,0 +1,208 @@
+#include "cputracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+const int CpuTracer::kChunkEvents;
+const int CpuTracer::kMaxChunksPerThread;
+const int CpuTracer::kMaxThreads;
+
+std::atomic<bool> CpuTracer::recording(false);
+std::atomic<int64_t> CpuTracer::startNs(0);
+std::atomic<CpuTracer::ThreadBuffer*> CpuTracer::buffers(nullptr);
+std::atomic<int> CpuTracer::numThreads(0);
+std::atomic<const char*> CpuTracer::threadNames[CpuTracer::kMaxThreads];
+std::atomic<int64_t> CpuTracer::numDropped(0);
+
+// The calling thread's buffer and trace id; the buffer is handed back when the thread exits.
+struct CpuTracerThreadSlot
+{
+	CpuTracerThreadSlot() {
+		buffer = nullptr;
+		thread = -1;
+	}
+	~CpuTracerThreadSlot() {
+		if (buffer != nullptr)
+			buffer->inUse.store(false, std::memory_order_release);
+	}
+	int GetThread() {
+		if (thread < 0)
+			thread = CpuTracer::numThreads.fetch_add(1, std::memory_order_relaxed);
+		return thread;
+	}
+
+	CpuTracer::ThreadBuffer* buffer;
+	int thread;
+};
+static thread_local CpuTracerThreadSlot threadSlot;
+
+void CpuTracer::Start()
+{
+	// Skip whatever is in the buffers: move every read position to the end, which also lets
+	// the threads reuse the chunks skipped.
+	for (ThreadBuffer* buffer = buffers.load(std::memory_order_acquire); buffer != nullptr;
+		 buffer = buffer->next.load(std::memory_order_acquire)) {
+		Chunk* chunk = buffer->readChunk.load(std::memory_order_relaxed);
+		int numEvents = chunk->numEvents.load(std::memory_order_acquire);
+		Chunk* next = chunk->next.load(std::memory_order_acquire);
+		while (next != nullptr) {
+			chunk = next;
+			numEvents = chunk->numEvents.load(std::memory_order_acquire);
+			next = chunk->next.load(std::memory_order_acquire);
+		}
+		buffer->readIndex = numEvents;
+		buffer->readChunk.store(chunk, std::memory_order_release);
+	}
+	numDropped.store(0, std::memory_order_relaxed);
+	startNs.store(Now(), std::memory_order_relaxed);
+	recording.store(true, std::memory_order_release);
+}
+
+void CpuTracer::Stop()
+{
+	recording.store(false, std::memory_order_release);
+}
+
+int64_t CpuTracer::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CpuTracer::SetThreadName(const char* name)
+{
+	const int thread = threadSlot.GetThread();
+	if (thread < kMaxThreads)
+		threadNames[thread].store(name, std::memory_order_release);
+}
+
+void CpuTracer::Record(const char* name, const int64_t zoneStartNs, const int64_t zoneEndNs)
+{
+	if (threadSlot.buffer == nullptr)
+		threadSlot.buffer = AcquireBuffer();
+	ThreadBuffer* buffer = threadSlot.buffer;
+	Chunk* chunk = buffer->last;
+	int numEvents = chunk->numEvents.load(std::memory_order_relaxed);
+	if (numEvents == kChunkEvents) {
+		Chunk* next;
+		if (buffer->first != buffer->readChunk.load(std::memory_order_acquire)) {
+			// The oldest chunk has been read past and is no longer touched by the reader: reuse it.
+			next = buffer->first;
+			buffer->first = next->next.load(std::memory_order_relaxed);
+			next->numEvents.store(0, std::memory_order_relaxed);
+			next->next.store(nullptr, std::memory_order_relaxed);
+		} else if (buffer->numChunks >= kMaxChunksPerThread) {
+			numDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		} else {
+			next = NewChunk();
+			buffer->numChunks++;
+		}
+		chunk->next.store(next, std::memory_order_release);
+		buffer->last = next;
+		chunk = next;
+		numEvents = 0;
+	}
+	Event& event = chunk->events[numEvents];
+	event.name = name;
+	event.startNs = zoneStartNs;
+	event.durationNs = zoneEndNs - zoneStartNs;
+	event.thread = threadSlot.GetThread();
+	// Publish the event to the writer.
+	chunk->numEvents.store(numEvents + 1, std::memory_order_release);
+}
+
+CpuTracer::ThreadBuffer* CpuTracer::AcquireBuffer()
+{
+	// Take over the buffer of a thread that has exited, if any.
+	for (ThreadBuffer* buffer = buffers.load(std::memory_order_acquire); buffer != nullptr;
+		 buffer = buffer->next.load(std::memory_order_acquire)) {
+		bool inUse = false;
+		if (buffer->inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire))
+			return buffer;
+	}
+	// Memory of the tracer comes from malloc: it is not the frame's allocations that the
+	// AllocationCounter reports. Buffers live as long as the process.
+	ThreadBuffer* buffer = new (std::malloc(sizeof(ThreadBuffer))) ThreadBuffer();
+	buffer->inUse.store(true, std::memory_order_relaxed);
+	buffer->first = NewChunk();
+	buffer->last = buffer->first;
+	buffer->numChunks = 1;
+	buffer->readChunk.store(buffer->first, std::memory_order_relaxed);
+	buffer->readIndex = 0;
+	ThreadBuffer* head = buffers.load(std::memory_order_relaxed);
+	do {
+		buffer->next.store(head, std::memory_order_relaxed);
+	} while (!buffers.compare_exchange_weak(head, buffer, std::memory_order_release, std::memory_order_relaxed));
+	return buffer;
+}
+
+CpuTracer::Chunk* CpuTracer::NewChunk()
+{
+	Chunk* chunk = new (std::malloc(sizeof(Chunk))) Chunk();
+	chunk->numEvents.store(0, std::memory_order_relaxed);
+	chunk->next.store(nullptr, std::memory_order_relaxed);
+	return chunk;
+}
+
+bool CpuTracer::WriteChromeTrace(const std::string& filePath)
+{
+	std::ofstream file(filePath, std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "[WARNING] Failed to write CPU trace: " << filePath << std::endl;
+		return false;
+	}
+	const int64_t originNs = startNs.load(std::memory_order_relaxed);
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool firstEvent = true;
+	const int numNamed = std::min(numThreads.load(std::memory_order_relaxed), kMaxThreads);
+	for (int thread = 0; thread < numNamed; ++thread) {
+		const char* name = threadNames[thread].load(std::memory_order_acquire);
+		if (name == nullptr)
+			continue;
+		file << (firstEvent ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+			 << ",\"args\":{\"name\":\"" << name << "\"}}";
+		firstEvent = false;
+	}
+
+	// Only what each thread has published; zones recorded meanwhile go to the next write.
+	size_t numEvents = 0;
+	for (ThreadBuffer* buffer = buffers.load(std::memory_order_acquire); buffer != nullptr;
+		 buffer = buffer->next.load(std::memory_order_acquire)) {
+		Chunk* chunk = buffer->readChunk.load(std::memory_order_relaxed);
+		int index = buffer->readIndex;
+		while (true) {
+			const int count = chunk->numEvents.load(std::memory_order_acquire);
+			for (; index < count; ++index) {
+				const Event& event = chunk->events[index];
+				file << (firstEvent ? "\n" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+					 << event.thread << ",\"ts\":" << (double)(event.startNs - originNs) / 1000.0 << ",\"dur\":"
+					 << (double)event.durationNs / 1000.0 << "}";
+				firstEvent = false;
+				++numEvents;
+			}
+			Chunk* next = chunk->next.load(std::memory_order_acquire);
+			if (count < kChunkEvents || next == nullptr)
+				break;
+			chunk = next;
+			index = 0;
+		}
+		buffer->readIndex = index;
+		// Hands the chunks read past back to the thread.
+		buffer->readChunk.store(chunk, std::memory_order_release);
+	}
+	file << "\n]}\n";
+
+	std::cout << "CPU trace: " << numEvents << " zones written to " << filePath;
+	const int64_t dropped = numDropped.load(std::memory_order_relaxed);
+	if (dropped > 0)
+		std::cout << " (" << dropped << " dropped, buffers full)";
+	std::cout << std::endl;
+	return file.good();
+}
@@ -0,0 +1,110 @@
+#ifndef CPU_TRACER_H
+#define CPU_TRACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Define CPU_TRACE as 0 (e.g. in the project's preprocessor definitions) to compile the zones out.
+#ifndef CPU_TRACE
+#define CPU_TRACE 1
+#endif
+
+// CpuTracer Declarations.
+// Records named CPU zones (a start and a duration) of every thread and writes them as a Chrome
+// trace (the Trace Event Format read by chrome://tracing and ui.perfetto.dev). Each thread
+// appends to its own buffer of fixed-size chunks and publishes the count with a release store:
+// a zone costs two clock reads and no lock, and the writer reads what is published without
+// stopping any thread. Chunks the writer has read past are reused by their thread, and the
+// buffer of a thread that exits is taken over by the next new thread.
+// Zone and thread names must be string literals.
+class CpuTracer
+{
+public:
+	// CpuTracer Public Methods.
+	// Forget what was recorded and record from now on.
+	static void Start();
+	static void Stop();
+	static bool IsRecording() { return recording.load(std::memory_order_relaxed); }
+	// Write the zones recorded since Start() or the last write, as a Chrome trace.
+	static bool WriteChromeTrace(const std::string& filePath);
+	// Name the calling thread in the trace.
+	static void SetThreadName(const char* name);
+
+	// In nanoseconds, from a steady clock.
+	static int64_t Now();
+	static void Record(const char* name, const int64_t startNs, const int64_t endNs);
+
+	static const int kChunkEvents = 4096;
+	// Zones past this many unread chunks of a thread are dropped (and counted).
+	static const int kMaxChunksPerThread = 256;
+	static const int kMaxThreads = 256;
+
+private:
+	// CpuTracer Private Types.
+	struct Event
+	{
+		const char* name;
+		int64_t startNs;
+		int64_t durationNs;
+		int thread;
+	};
+	struct Chunk
+	{
+		Event events[kChunkEvents];
+		std::atomic<int> numEvents;
+		std::atomic<Chunk*> next;
+	};
+	struct ThreadBuffer
+	{
+		std::atomic<bool> inUse;
+		std::atomic<ThreadBuffer*> next;	// In the list of all buffers.
+		Chunk* first;						// Owned by the recording thread.
+		Chunk* last;
+		int numChunks;
+		std::atomic<Chunk*> readChunk;		// Owned by Start() and WriteChromeTrace().
+		int readIndex;
+	};
+	friend struct CpuTracerThreadSlot;
+
+	// CpuTracer Private Methods.
+	static ThreadBuffer* AcquireBuffer();
+	static Chunk* NewChunk();
+
+	// CpuTracer Private Data.
+	static std::atomic<bool> recording;
+	static std::atomic<int64_t> startNs;
+	static std::atomic<ThreadBuffer*> buffers;
+	static std::atomic<int> numThreads;
+	static std::atomic<const char*> threadNames[kMaxThreads];
+	static std::atomic<int64_t> numDropped;
+};
+
+// Records the lifetime of the object as a zone, if the tracer is recording when it starts.
+class CpuTraceZone
+{
+public:
+	explicit CpuTraceZone(const char* name) : name(name) {
+		startNs = CpuTracer::IsRecording() ? CpuTracer::Now() : -1;
+	}
+	~CpuTraceZone() {
+		if (startNs >= 0)
+			CpuTracer::Record(name, startNs, CpuTracer::Now());
+	}
+
+private:
+	const char* name;
+	int64_t startNs;
+};
+
+#if CPU_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) CpuTraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) CpuTracer::SetThreadName(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+#endif
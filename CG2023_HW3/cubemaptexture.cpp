@@ -0,0 +1,298 @@
+#include "cubemaptexture.h"
+#include "parallel.h"
+#include "specularprefilter.h"
+#include "textureresidency.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <emmintrin.h>
+
+// Face rows handled by one worker task.
+static const int kRowsPerTask = 16;
+
+static inline uint32_t LoadTexel(const unsigned char* p, const int channels)
+{
+	if (channels == 4) {
+		uint32_t v;
+		std::memcpy(&v, p, 4);
+		return v;
+	}
+	if (channels == 3)
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+	return (uint32_t)p[0];
+}
+
+// Bilinear blend of four texels of up to 4 8-bit channels, with 7-bit fixed point weights
+// (wx, wy in [0, 128] are the weights of the right and bottom texels).
+static inline uint32_t BlendTexels(const uint32_t t00, const uint32_t t01, const uint32_t t10, const uint32_t t11,
+								   const int wx, const int wy)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi16(64);
+	const short wx0 = (short)(128 - wx);
+	const short wx1 = (short)wx;
+	const short wy0 = (short)(128 - wy);
+	const short wy1 = (short)wy;
+	const __m128i weightX = _mm_set_epi16(wx1, wx1, wx1, wx1, wx0, wx0, wx0, wx0);
+	const __m128i weightY = _mm_set_epi16(wy1, wy1, wy1, wy1, wy0, wy0, wy0, wy0);
+
+	// Lanes 0-3: left texel, lanes 4-7: right texel.
+	__m128i top = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_set_epi32(0, 0, (int)t01, (int)t00), zero), weightX);
+	__m128i bottom = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_set_epi32(0, 0, (int)t11, (int)t10), zero), weightX);
+	top = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(top, _mm_srli_si128(top, 8)), round), 7);
+	bottom = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(bottom, _mm_srli_si128(bottom, 8)), round), 7);
+
+	// Lanes 0-3: top row, lanes 4-7: bottom row.
+	__m128i v = _mm_mullo_epi16(_mm_unpacklo_epi64(top, bottom), weightY);
+	v = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(v, _mm_srli_si128(v, 8)), round), 7);
+	return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(v, zero));
+}
+
+CubeMapTexture::CubeMapTexture(const cv::Mat& panorama, const int size)
+{
+	textureObj = 0;
+	specularObj = 0;
+	faceSize = 0;
+	numChannels = 0;
+	numMipLevels = 0;
+	numSpecularLevels = 0;
+	sizeInBytes = 0;
+	sourceBytes = 0;
+	convertMs = 0.0;
+	projectSHMs = 0.0;
+	prefilterMs = 0.0;
+	prefilterCached = false;
+
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_CUBE_MAP_TEXTURE_SIZE, &maxSize);
+	int requestedSize = (size > 0) ? size : std::max(1, panorama.cols / 4);
+	if (maxSize > 0)
+		requestedSize = std::min(requestedSize, (int)maxSize);
+
+	CubeMapFaces faces;
+	if (BuildFaces(panorama, requestedSize, faces))
+		Upload(faces);
+}
+
+CubeMapTexture::CubeMapTexture(const CubeMapFaces& faces)
+{
+	textureObj = 0;
+	specularObj = 0;
+	faceSize = 0;
+	numChannels = 0;
+	numMipLevels = 0;
+	numSpecularLevels = 0;
+	sizeInBytes = 0;
+	sourceBytes = 0;
+	convertMs = 0.0;
+	projectSHMs = 0.0;
+	prefilterMs = 0.0;
+	prefilterCached = false;
+	Upload(faces);
+}
+
+CubeMapTexture::~CubeMapTexture()
+{
+	TextureResidency::RemoveFixedBytes(sizeInBytes);
+	glDeleteTextures(1, &textureObj);
+	glDeleteTextures(1, &specularObj);
+}
+
+void CubeMapTexture::Bind(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, textureObj);
+}
+
+void CubeMapTexture::BindSpecular(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, specularObj);
+}
+
+glm::vec3 CubeMapTexture::GetFaceDirection(const int face, const float s, const float t)
+{
+	switch (face) {
+	case 0:	return glm::vec3( 1.0f,    -t,    -s);	// +X
+	case 1:	return glm::vec3(-1.0f,    -t,     s);	// -X
+	case 2:	return glm::vec3(    s,  1.0f,     t);	// +Y
+	case 3:	return glm::vec3(    s, -1.0f,    -t);	// -Y
+	case 4:	return glm::vec3(    s,    -t,  1.0f);	// +Z
+	default: return glm::vec3(  -s,    -t, -1.0f);	// -Z
+	}
+}
+
+int CubeMapTexture::GetFaceCoords(const glm::vec3& dir, float& s, float& t)
+{
+	const glm::vec3 a = glm::abs(dir);
+	if (a.x >= a.y && a.x >= a.z) {
+		const float inv = 1.0f / a.x;
+		s = ((dir.x > 0.0f) ? -dir.z : dir.z) * inv;
+		t = -dir.y * inv;
+		return (dir.x > 0.0f) ? 0 : 1;
+	}
+	if (a.y >= a.z) {
+		const float inv = 1.0f / a.y;
+		s = dir.x * inv;
+		t = ((dir.y > 0.0f) ? dir.z : -dir.z) * inv;
+		return (dir.y > 0.0f) ? 2 : 3;
+	}
+	const float inv = 1.0f / a.z;
+	s = ((dir.z > 0.0f) ? dir.x : -dir.x) * inv;
+	t = -dir.y * inv;
+	return (dir.z > 0.0f) ? 4 : 5;
+}
+
+bool CubeMapTexture::BuildFaces(const cv::Mat& panorama, const int size, CubeMapFaces& faces,
+								const std::string& sourcePath)
+{
+	TRACE_ZONE("Build cube faces");
+	if (panorama.empty())
+		return false;
+	const int requestedSize = (size > 0) ? size : std::max(1, panorama.cols / 4);
+	std::vector<cv::Mat> images;
+	faces.convertMs = ConvertEquirect(panorama, requestedSize, images);
+	if (images.size() != 6)
+		return false;
+	faces.sourceBytes = panorama.total() * panorama.elemSize();
+	faces.projectSHMs = SphericalHarmonics::ProjectEquirect(panorama, faces.radianceSH);
+	faces.faces.resize(6);
+	for (int face = 0; face < 6; ++face)
+		MipGenerator::Generate(images[face], MipFilter::Box, faces.faces[face]);
+	if (sourcePath.empty()) {
+		faces.prefilterMs = SpecularPrefilter::Prefilter(faces.faces, faces.specular);
+		faces.prefilterCached = false;
+	}
+	else {
+		faces.prefilterMs = SpecularPrefilter::Build(sourcePath, faces.faces, faces.specular, &faces.prefilterCached);
+	}
+	return true;
+}
+
+void CubeMapTexture::Upload(const CubeMapFaces& faces)
+{
+	TRACE_ZONE("Upload cube faces");
+	if (faces.faces.size() != 6 || faces.faces[0].GetNumLevels() == 0)
+		return;
+	const cv::Mat& base = faces.faces[0].levels[0];
+	faceSize = base.cols;
+	numChannels = base.channels();
+	numMipLevels = faces.faces[0].GetNumLevels();
+	sourceBytes = faces.sourceBytes;
+	convertMs = faces.convertMs;
+	radianceSH = faces.radianceSH;
+	projectSHMs = faces.projectSHMs;
+	prefilterMs = faces.prefilterMs;
+	prefilterCached = faces.prefilterCached;
+
+	// Every face has its own box-filtered mip chain.
+	textureObj = UploadFaces(faces.faces, sizeInBytes);
+	if (faces.specular.size() == 6 && faces.specular[0].GetNumLevels() > 0) {
+		numSpecularLevels = faces.specular[0].GetNumLevels();
+		specularObj = UploadFaces(faces.specular, sizeInBytes);
+	}
+	TextureResidency::AddFixedBytes(sizeInBytes);
+}
+
+GLuint CubeMapTexture::UploadFaces(const std::vector<MipChain>& chains, size_t& bytes)
+{
+	const int channels = chains[0].levels[0].channels();
+	const int numLevels = chains[0].GetNumLevels();
+	GLint internalFormat = GL_RGB;
+	GLenum format = GL_BGR;
+	if (channels == 1) {
+		internalFormat = GL_RED;
+		format = GL_RED;
+	}
+	else if (channels == 4) {
+		internalFormat = GL_RGBA;
+		format = GL_BGRA;
+	}
+
+	GLuint texObj = 0;
+	glGenTextures(1, &texObj);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texObj);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int face = 0; face < 6; ++face) {
+		const MipChain& chain = chains[face];
+		for (int level = 0; level < chain.GetNumLevels(); ++level) {
+			const cv::Mat& image = chain.levels[level];
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, internalFormat, image.cols, image.rows,
+							0, format, GL_UNSIGNED_BYTE, image.ptr());
+			bytes += image.total() * image.elemSize();
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	return texObj;
+}
+
+double CubeMapTexture::ConvertEquirect(const cv::Mat& panorama, const int size, std::vector<cv::Mat>& faces)
+{
+	if (panorama.empty() || panorama.depth() != CV_8U || panorama.channels() > 4 || size <= 0)
+		return 0.0;
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	faces.resize(6);
+	for (auto& face : faces)
+		face.create(size, size, panorama.type());
+	ParallelFor(0, 6 * size, kRowsPerTask, [&](const int begin, const int end) {
+		for (int i = begin; i < end; ++i)
+			ConvertRow(panorama, i / size, i % size, faces[i / size]);
+	});
+	const auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void CubeMapTexture::ConvertRow(const cv::Mat& panorama, const int face, const int row, cv::Mat& dst)
+{
+	const int size = dst.cols;
+	const int width = panorama.cols;
+	const int height = panorama.rows;
+	const int channels = panorama.channels();
+	const float invPi = glm::one_over_pi<float>();
+	const float t = 2.0f * ((float)row + 0.5f) / (float)size - 1.0f;
+
+	unsigned char* out = dst.ptr<unsigned char>(row);
+	for (int x = 0; x < size; ++x, out += channels) {
+		const float s = 2.0f * ((float)x + 0.5f) / (float)size - 1.0f;
+		const glm::vec3 dir = GetFaceDirection(face, s, t);
+		float u = std::atan2(dir.z, dir.x) * 0.5f * invPi;
+		if (u < 0.0f)
+			u += 1.0f;
+		const float v = std::acos(glm::clamp(dir.y / glm::length(dir), -1.0f, 1.0f)) * invPi;
+
+		// Texel centers are at half-integer coordinates. u wraps around, v clamps at the poles.
+		const float px = u * (float)width - 0.5f;
+		const float py = v * (float)height - 0.5f;
+		const float fx = std::floor(px);
+		const float fy = std::floor(py);
+		const int wx = (int)((px - fx) * 128.0f + 0.5f);
+		const int wy = (int)((py - fy) * 128.0f + 0.5f);
+		int x0 = (int)fx;
+		if (x0 < 0)
+			x0 += width;
+		else if (x0 >= width)
+			x0 -= width;
+		const int x1 = (x0 + 1 == width) ? 0 : x0 + 1;
+		const int y0 = glm::clamp((int)fy, 0, height - 1);
+		const int y1 = glm::clamp((int)fy + 1, 0, height - 1);
+
+		const unsigned char* r0 = panorama.ptr<unsigned char>(y0);
+		const unsigned char* r1 = panorama.ptr<unsigned char>(y1);
+		const uint32_t texel = BlendTexels(LoadTexel(r0 + x0 * channels, channels), LoadTexel(r0 + x1 * channels, channels),
+										   LoadTexel(r1 + x0 * channels, channels), LoadTexel(r1 + x1 * channels, channels),
+										   wx, wy);
+		for (int c = 0; c < channels; ++c)
+			out[c] = (unsigned char)(texel >> (8 * c));
+	}
+}
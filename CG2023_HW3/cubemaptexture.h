@@ -0,0 +1,105 @@
+#ifndef CUBE_MAP_TEXTURE_H
+#define CUBE_MAP_TEXTURE_H
+
+#include "headers.h"
+#include "mipgenerator.h"
+#include "sphericalharmonics.h"
+
+// CubeMapFaces Declarations.
+// CPU side of a cube map: six faces with their mip chains, ready for upload.
+struct CubeMapFaces
+{
+	std::vector<MipChain> faces;
+	double convertMs;		// Resampling time, without the mip levels.
+	size_t sourceBytes;		// Level 0 of the panorama the faces were built from.
+	SH9Color radianceSH;	// Projection of the panorama, for ambient lighting.
+	double projectSHMs;
+	std::vector<MipChain> specular;	// Prefiltered environment, one roughness per level.
+	double prefilterMs;		// Prefiltering, or loading from the disk cache.
+	bool prefilterCached;
+
+	CubeMapFaces() : convertMs(0.0), sourceBytes(0), projectSHMs(0.0), prefilterMs(0.0), prefilterCached(false) {}
+	size_t GetSizeInBytes() const {
+		size_t bytes = 0;
+		for (const auto& face : faces)
+			bytes += face.GetSizeInBytes();
+		for (const auto& face : specular)
+			bytes += face.GetSizeInBytes();
+		return bytes;
+	}
+};
+
+// CubeMapTexture Declarations.
+// A GL_TEXTURE_CUBE_MAP resampled on the CPU from an equirectangular panorama.
+// Faces follow the GL convention (+X, -X, +Y, -Y, +Z, -Z) and are uploaded top row first.
+// A panorama texel (u, v) maps to the direction used by the skybox sphere:
+// x = cos(theta) cos(phi), y = sin(theta), z = cos(theta) sin(phi), with u = phi / 2PI and
+// v = (PI/2 - theta) / PI.
+class CubeMapTexture
+{
+public:
+	// CubeMapTexture Public Methods.
+	// faceSize 0 picks a quarter of the panorama width, which keeps the texel density at the horizon.
+	CubeMapTexture(const cv::Mat& panorama, const int faceSize = 0);
+	// Upload faces built by BuildFaces(), possibly on another thread.
+	CubeMapTexture(const CubeMapFaces& faces);
+	~CubeMapTexture();
+
+	void Bind(GLenum textureUnit);
+	// The prefiltered environment for glossy reflections; see SpecularPrefilter.
+	void BindSpecular(GLenum textureUnit);
+	bool IsValid() const { return textureObj != 0; }
+	bool HasSpecular() const { return specularObj != 0; }
+	int GetFaceSize() const { return faceSize; }
+	int GetNumMipLevels() const { return numMipLevels; }
+	int GetNumSpecularLevels() const { return numSpecularLevels; }
+	// Both cube maps.
+	size_t GetSizeInBytes() const { return sizeInBytes; }
+	// CPU time of the resampling (without the mip levels and the upload).
+	double GetConvertTime() const { return convertMs; }
+	size_t GetSourceBytes() const { return sourceBytes; }
+	const SH9Color& GetRadianceSH() const { return radianceSH; }
+	double GetProjectSHTime() const { return projectSHMs; }
+	double GetPrefilterTime() const { return prefilterMs; }
+	bool IsPrefilterCached() const { return prefilterCached; }
+
+	// Resample the panorama, build the mip chain of every face, project the panorama
+	// onto spherical harmonics and prefilter the specular environment. Makes no GL calls, so it
+	// can run on any thread. faceSize 0 picks a quarter of the panorama width.
+	// With a sourcePath the prefiltered environment goes through the disk cache of that file.
+	static bool BuildFaces(const cv::Mat& panorama, const int faceSize, CubeMapFaces& faces,
+						   const std::string& sourcePath = "");
+
+	// Direction through texel (s, t) in [-1, 1] of a face, t pointing down the image (not normalized).
+	static glm::vec3 GetFaceDirection(const int face, const float s, const float t);
+	// The inverse: face hit by a direction and its (s, t) on that face.
+	static int GetFaceCoords(const glm::vec3& dir, float& s, float& t);
+
+	// Resample the panorama (8-bit, 1, 3 or 4 channels) into 6 faces of faceSize x faceSize.
+	// Rows of all faces are spread over the worker threads. Returns the elapsed milliseconds.
+	static double ConvertEquirect(const cv::Mat& panorama, const int faceSize, std::vector<cv::Mat>& faces);
+
+private:
+	// CubeMapTexture Private Methods.
+	void Upload(const CubeMapFaces& faces);
+	// Upload six face chains into a new cube map texture and add their size to bytes.
+	static GLuint UploadFaces(const std::vector<MipChain>& chains, size_t& bytes);
+	static void ConvertRow(const cv::Mat& panorama, const int face, const int row, cv::Mat& dst);
+
+	// CubeMapTexture Private Data.
+	GLuint textureObj;
+	GLuint specularObj;
+	int faceSize;
+	int numChannels;
+	int numMipLevels;
+	int numSpecularLevels;
+	size_t sizeInBytes;
+	size_t sourceBytes;
+	double convertMs;
+	SH9Color radianceSH;
+	double projectSHMs;
+	double prefilterMs;
+	bool prefilterCached;
+};
+
+#endif
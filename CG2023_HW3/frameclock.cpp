@@ -0,0 +1,51 @@
+#include "frameclock.h"
+
+#include <algorithm>
+
+constexpr double FrameClock::kDefaultStep;
+constexpr double FrameClock::kMaxDelta;
+
+FrameClock::FrameClock(const double step)
+{
+	fixedStep = step;
+	lockedStep = 0.0;
+	frameDelta = 0.0;
+	accumulator = 0.0;
+	simTime = 0.0;
+	lastTick = Clock::now();
+}
+
+int FrameClock::Tick()
+{
+	const Clock::time_point now = Clock::now();
+	if (IsLocked())
+		frameDelta = lockedStep;
+	else
+		frameDelta = std::min(std::chrono::duration<double>(now - lastTick).count(), kMaxDelta);
+	lastTick = now;
+
+	// The tolerance keeps a locked step that is a multiple of the fixed step from losing a step
+	// to rounding.
+	accumulator += frameDelta;
+	int numSteps = 0;
+	while (accumulator >= fixedStep - 1e-9) {
+		accumulator = std::max(accumulator - fixedStep, 0.0);
+		simTime += fixedStep;
+		++numSteps;
+	}
+	return numSteps;
+}
+
+void FrameClock::LockStep(const double frameStep)
+{
+	lockedStep = frameStep;
+	// Start on a step boundary so that the poses do not depend on what ran before.
+	accumulator = 0.0;
+}
+
+void FrameClock::Unlock()
+{
+	lockedStep = 0.0;
+	// The locked frames took real time that must not be simulated again.
+	lastTick = Clock::now();
+}
@@ -0,0 +1,49 @@
+#ifndef FRAME_CLOCK_H
+#define FRAME_CLOCK_H
+
+#include <chrono>
+
+// FrameClock Declarations.
+// Keeps animation apart from rendering. Tick() measures the time since the previous frame and
+// turns it into whole fixed simulation steps; what is left over (GetAlpha()) blends the drawn
+// pose between the last two steps, so animation moves at the same speed at any frame rate.
+// With a locked step every Tick() advances exactly that much simulated time whatever the wall
+// clock says, so that frame n of a benchmark always shows the same pose.
+class FrameClock
+{
+public:
+	// FrameClock Public Methods.
+	FrameClock(const double fixedStep = kDefaultStep);
+
+	// Start of a frame: the number of fixed steps to simulate.
+	int Tick();
+	// Every Tick() from now on advances frameStep seconds; Unlock() goes back to real time.
+	void LockStep(const double frameStep);
+	void Unlock();
+	bool IsLocked() const { return lockedStep > 0.0; }
+
+	double GetFixedStep() const { return fixedStep; }
+	// Time since the previous Tick(), in seconds (simulated when locked).
+	double GetFrameDelta() const { return frameDelta; }
+	// Fraction of a step simulated time is past the last step, in [0, 1).
+	double GetAlpha() const { return accumulator / fixedStep; }
+	double GetSimTime() const { return simTime; }
+
+	static constexpr double kDefaultStep = 1.0 / 120.0;
+	// Longer frames (a stall, a window drag, an on-demand frame after a pause) count as this.
+	static constexpr double kMaxDelta = 0.25;
+
+private:
+	// FrameClock Private Types.
+	typedef std::chrono::steady_clock Clock;
+
+	// FrameClock Private Data.
+	double fixedStep;
+	double lockedStep;
+	double frameDelta;
+	double accumulator;
+	double simTime;
+	Clock::time_point lastTick;
+};
+
+#endif
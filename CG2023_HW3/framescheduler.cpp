@@ -0,0 +1,123 @@
+#include "framescheduler.h"
+
+#include <ctime>
+#include <thread>
+
+const int FrameScheduler::kPollMs;
+
+bool FrameScheduler::animating = false;
+bool FrameScheduler::pollPending = false;
+double FrameScheduler::targetFps = 60.0;
+FrameScheduler::Clock::time_point FrameScheduler::nextFrame;
+FrameScheduler::Usage FrameScheduler::usage[2] = { { 0.0, 0.0, 0 }, { 0.0, 0.0, 0 } };
+FrameScheduler::Clock::time_point FrameScheduler::markWall;
+double FrameScheduler::markCpuMs = 0.0;
+
+void FrameScheduler::Init(const double fps)
+{
+	SetTargetRate(fps);
+	markWall = Clock::now();
+	markCpuMs = GetProcessCpuMs();
+	nextFrame = markWall;
+	glutIdleFunc(animating ? IdleCB : nullptr);
+	RequestRedraw();
+}
+
+void FrameScheduler::RequestRedraw()
+{
+	glutPostRedisplay();
+}
+
+void FrameScheduler::SetAnimating(const bool enabled)
+{
+	if (enabled == animating)
+		return;
+	Account();
+	animating = enabled;
+	nextFrame = Clock::now();
+	// Without an idle callback GLUT waits for the next event.
+	glutIdleFunc(animating ? IdleCB : nullptr);
+}
+
+void FrameScheduler::SetTargetRate(const double fps)
+{
+	targetFps = glm::clamp(fps, 1.0, 1000.0);
+}
+
+void FrameScheduler::EndFrame(const bool workPending)
+{
+	usage[animating ? 1 : 0].numFrames++;
+	// Animated frames come anyway.
+	if (workPending && !animating && !pollPending) {
+		glutTimerFunc(kPollMs, PollCB, 0);
+		pollPending = true;
+	}
+}
+
+void FrameScheduler::IdleCB()
+{
+	const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+	const auto now = Clock::now();
+	if (now < nextFrame)
+		std::this_thread::sleep_until(nextFrame);
+	else if (now - nextFrame > period) {
+		// A slow frame (or a dragged window): start over rather than rush to catch up.
+		nextFrame = now;
+	}
+	nextFrame += period;
+	glutPostRedisplay();
+}
+
+void FrameScheduler::PollCB(int /*value*/)
+{
+	pollPending = false;
+	glutPostRedisplay();
+}
+
+void FrameScheduler::Account()
+{
+	const Clock::time_point wall = Clock::now();
+	const double cpuMs = GetProcessCpuMs();
+	Usage& current = usage[animating ? 1 : 0];
+	current.wallMs += std::chrono::duration<double, std::milli>(wall - markWall).count();
+	current.cpuMs += cpuMs - markCpuMs;
+	markWall = wall;
+	markCpuMs = cpuMs;
+}
+
+double FrameScheduler::GetProcessCpuMs()
+{
+#ifdef _WIN32
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+		return 0.0;
+	// In 100 ns units.
+	const ULONGLONG kernel = ((ULONGLONG)kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime;
+	const ULONGLONG user = ((ULONGLONG)userTime.dwHighDateTime << 32) | userTime.dwLowDateTime;
+	return (double)(kernel + user) / 10000.0;
+#else
+	return 1000.0 * (double)std::clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+void FrameScheduler::ShowInfo()
+{
+	Account();
+	const char* names[2] = { "Idle", "Animating" };
+	std::cout << "------------------------------" << std::endl;
+	std::cout << "Frame scheduling (target " << targetFps << " fps while animating)" << std::endl;
+	for (int state = 0; state < 2; ++state) {
+		const Usage& u = usage[state];
+		std::cout << names[state] << ": " << u.wallMs / 1000.0 << " s";
+		if (u.wallMs > 0.0) {
+			std::cout << ", CPU " << 100.0 * u.cpuMs / u.wallMs << " % of one core, " << u.numFrames << " frames ("
+					  << 1000.0 * u.numFrames / u.wallMs << " fps)";
+		}
+		std::cout << std::endl;
+	}
+	// There is no portable power counter; CPU time (all threads) is the proxy.
+	std::cout << "Power: not measured, see CPU usage." << std::endl;
+	std::cout << "------------------------------" << std::endl;
+	usage[0] = { 0.0, 0.0, 0 };
+	usage[1] = { 0.0, 0.0, 0 };
+}
@@ -0,0 +1,64 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include "headers.h"
+
+#include <chrono>
+
+// FrameScheduler Declarations.
+// Draws a frame only when something asks for one instead of redrawing from the idle callback.
+// Input, loads and resizes call RequestRedraw(), which posts a single redisplay; while nothing
+// does, GLUT blocks waiting for events and the process sleeps. While the scene animates the
+// idle callback paces frames at the target rate, sleeping until the next one is due.
+// Background work that only finishes on the GL thread (preloaded skyboxes waiting for their
+// upload, streamed tiles) is polled with a redraw every kPollMs until it is done.
+class FrameScheduler
+{
+public:
+	// FrameScheduler Public Methods.
+	// Call once the display callback is registered, instead of registering an idle callback.
+	static void Init(const double targetFps);
+	static void RequestRedraw();
+	static void SetAnimating(const bool enabled);
+	static bool IsAnimating() { return animating; }
+	static void SetTargetRate(const double fps);
+	static double GetTargetRate() { return targetFps; }
+	// Call at the end of every displayed frame; workPending keeps the polling going.
+	static void EndFrame(const bool workPending);
+
+	// CPU usage of the process while idle and while animating since the last call.
+	static void ShowInfo();
+
+	static const int kPollMs = 50;
+
+private:
+	// FrameScheduler Private Types.
+	typedef std::chrono::steady_clock Clock;
+	struct Usage
+	{
+		double wallMs;
+		double cpuMs;
+		int numFrames;
+	};
+
+	// FrameScheduler Private Methods.
+	static void IdleCB();
+	static void PollCB(int /*value*/);
+	// Add the time since the last call to the usage of the current state.
+	static void Account();
+	// User plus kernel time of all threads of the process.
+	static double GetProcessCpuMs();
+
+	// FrameScheduler Private Data.
+	static bool animating;
+	static bool pollPending;
+	static double targetFps;
+	static Clock::time_point nextFrame;
+
+	// Usage while idle [0] and while animating [1].
+	static Usage usage[2];
+	static Clock::time_point markWall;
+	static double markCpuMs;
+};
+
+#endif
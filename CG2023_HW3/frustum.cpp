@@ -0,0 +1,103 @@
+#include "frustum.h"
+
+#include <cmath>
+
+const int Frustum::kNumPlanes;
+const uint32_t Frustum::kAllPlanes;
+
+Frustum::Frustum()
+{
+	Extract(glm::mat4x4(1.0f));
+}
+
+void Frustum::Extract(const glm::mat4x4& viewProj)
+{
+	// Rows of the matrix (GLM is column major): clip space -w <= x, y, z <= w.
+	const glm::mat4x4 m = glm::transpose(viewProj);
+	planes[0] = m[3] + m[0];	// Left.
+	planes[1] = m[3] - m[0];	// Right.
+	planes[2] = m[3] + m[1];	// Bottom.
+	planes[3] = m[3] - m[1];	// Top.
+	planes[4] = m[3] + m[2];	// Near.
+	planes[5] = m[3] - m[2];	// Far.
+	for (glm::vec4& plane : planes) {
+		const float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f)
+			plane /= length;
+	}
+
+	// The two unused lanes hold 0 x + 0 y + 0 z + 1 >= 0, true everywhere.
+	alignas(16) float lanes[4][8];
+	for (int i = 0; i < 8; ++i) {
+		const glm::vec4 plane = (i < kNumPlanes) ? planes[i] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		for (int c = 0; c < 4; ++c)
+			lanes[c][i] = plane[c];
+	}
+	// Clearing the sign bit is the absolute value.
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	for (int g = 0; g < 2; ++g) {
+		planeX[g] = _mm_load_ps(&lanes[0][g * 4]);
+		planeY[g] = _mm_load_ps(&lanes[1][g * 4]);
+		planeZ[g] = _mm_load_ps(&lanes[2][g * 4]);
+		planeD[g] = _mm_load_ps(&lanes[3][g * 4]);
+		absPlaneX[g] = _mm_andnot_ps(signMask, planeX[g]);
+		absPlaneY[g] = _mm_andnot_ps(signMask, planeY[g]);
+		absPlaneZ[g] = _mm_andnot_ps(signMask, planeZ[g]);
+	}
+}
+
+void Frustum::TestPlanes(const Aabb& box, uint32_t& outsideBits, uint32_t& crossingBits) const
+{
+	const glm::vec3 c = box.GetCenter();
+	const glm::vec3 e = box.GetExtent();
+	const __m128 cx = _mm_set1_ps(c.x);
+	const __m128 cy = _mm_set1_ps(c.y);
+	const __m128 cz = _mm_set1_ps(c.z);
+	const __m128 ex = _mm_set1_ps(e.x);
+	const __m128 ey = _mm_set1_ps(e.y);
+	const __m128 ez = _mm_set1_ps(e.z);
+	const __m128 zero = _mm_setzero_ps();
+	outsideBits = 0;
+	crossingBits = 0;
+	for (int g = 0; g < 2; ++g) {
+		// Signed distance of the center, and how far the extents reach along the normal.
+		const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[g], cx), _mm_mul_ps(planeY[g], cy)),
+										   _mm_add_ps(_mm_mul_ps(planeZ[g], cz), planeD[g]));
+		const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absPlaneX[g], ex), _mm_mul_ps(absPlaneY[g], ey)),
+										 _mm_mul_ps(absPlaneZ[g], ez));
+		outsideBits |= (uint32_t)_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), zero)) << (g * 4);
+		crossingBits |= (uint32_t)_mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), zero)) << (g * 4);
+	}
+}
+
+bool Frustum::IsVisible(const Aabb& box) const
+{
+	uint32_t outsideBits;
+	uint32_t crossingBits;
+	TestPlanes(box, outsideBits, crossingBits);
+	return (outsideBits & kAllPlanes) == 0;
+}
+
+Frustum::Result Frustum::Classify(const Aabb& box, uint32_t& planeMask) const
+{
+	uint32_t outsideBits;
+	uint32_t crossingBits;
+	TestPlanes(box, outsideBits, crossingBits);
+	if (outsideBits & planeMask)
+		return Result::Outside;
+	planeMask &= crossingBits;
+	return (planeMask == 0) ? Result::Inside : Result::Intersects;
+}
+
+bool Frustum::IsVisibleScalar(const Aabb& box) const
+{
+	const glm::vec3 c = box.GetCenter();
+	const glm::vec3 e = box.GetExtent();
+	for (const glm::vec4& plane : planes) {
+		const float distance = plane.x * c.x + plane.y * c.y + plane.z * c.z + plane.w;
+		const float radius = std::fabs(plane.x) * e.x + std::fabs(plane.y) * e.y + std::fabs(plane.z) * e.z;
+		if (distance + radius < 0.0f)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,57 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "headers.h"
+#include "aabb.h"
+
+#include <cstdint>
+#include <xmmintrin.h>
+
+// Frustum Declarations.
+// The six planes of a view-projection matrix (Gribb and Hartmann), normals pointing inside.
+// Boxes are tested against four planes at a time with SSE: the planes are kept as separate
+// x, y, z and d lanes, padded to eight with planes that every box is inside of. A box is
+// outside a plane when its center is further behind it than its extents reach.
+class Frustum
+{
+public:
+	// Frustum Public Types.
+	enum class Result
+	{
+		Outside = 0,
+		Intersects = 1,
+		Inside = 2
+	};
+
+	// Frustum Public Methods.
+	Frustum();
+	void Extract(const glm::mat4x4& viewProj);
+
+	bool IsVisible(const Aabb& box) const;
+	// Test only the planes in planeMask (bit i for plane i); on Intersects, planeMask is left
+	// with the planes the box crosses, which are all its children need to test.
+	Result Classify(const Aabb& box, uint32_t& planeMask) const;
+	// One plane at a time, as the reference for the SSE test.
+	bool IsVisibleScalar(const Aabb& box) const;
+
+	static const int kNumPlanes = 6;
+	static const uint32_t kAllPlanes = (1u << kNumPlanes) - 1;
+
+private:
+	// Frustum Private Methods.
+	// Bits of the planes the box is entirely behind, and of the planes it reaches behind.
+	void TestPlanes(const Aabb& box, uint32_t& outsideBits, uint32_t& crossingBits) const;
+
+	// Frustum Private Data.
+	glm::vec4 planes[kNumPlanes];
+	// The planes by lane, two groups of four.
+	__m128 planeX[2];
+	__m128 planeY[2];
+	__m128 planeZ[2];
+	__m128 planeD[2];
+	__m128 absPlaneX[2];
+	__m128 absPlaneY[2];
+	__m128 absPlaneZ[2];
+};
+
+#endif
@@ -0,0 +1,3 @@
+#include "glcallcounter.h"
+
+size_t GLCallCounter::count = 0;
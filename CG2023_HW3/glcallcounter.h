@@ -0,0 +1,53 @@
+#ifndef GL_CALL_COUNTER_H
+#define GL_CALL_COUNTER_H
+
+#include <glew.h>
+#include <cstddef>
+
+// GLCallCounter Declarations.
+// Counts the GL calls the render loop can make per frame: state, bindings, uniforms, buffer
+// and texture updates, queries and draws. The entry points are wrapped by the macros below and
+// by the ones of glstate.h, which headers.h pulls into every file; one-off calls (object
+// creation, shader compilation, uniform lookups) are not wrapped. GL is only used from the
+// render thread.
+class GLCallCounter
+{
+public:
+	// GLCallCounter Public Methods.
+	static void Increment() { ++count; }
+	static size_t GetCount() { return count; }
+
+private:
+	// GLCallCounter Private Data.
+	static size_t count;
+};
+
+#define GL_COUNTED(call) (GLCallCounter::Increment(), call)
+
+// OpenGL 1.1 entry points (a macro does not expand inside itself, so these call the function).
+#define glClear(...) GL_COUNTED(glClear(__VA_ARGS__))
+#define glViewport(...) GL_COUNTED(glViewport(__VA_ARGS__))
+#define glTexParameteri(...) GL_COUNTED(glTexParameteri(__VA_ARGS__))
+#define glPixelStorei(...) GL_COUNTED(glPixelStorei(__VA_ARGS__))
+#define glTexSubImage2D(...) GL_COUNTED(glTexSubImage2D(__VA_ARGS__))
+#define glGetIntegerv(...) GL_COUNTED(glGetIntegerv(__VA_ARGS__))
+
+// Entry points loaded by GLEW.
+#undef glBufferSubData
+#define glBufferSubData(...) GL_COUNTED(GLEW_GET_FUN(__glewBufferSubData)(__VA_ARGS__))
+#undef glBeginQuery
+#define glBeginQuery(...) GL_COUNTED(GLEW_GET_FUN(__glewBeginQuery)(__VA_ARGS__))
+#undef glEndQuery
+#define glEndQuery(...) GL_COUNTED(GLEW_GET_FUN(__glewEndQuery)(__VA_ARGS__))
+#undef glQueryCounter
+#define glQueryCounter(...) GL_COUNTED(GLEW_GET_FUN(__glewQueryCounter)(__VA_ARGS__))
+#undef glGetQueryObjectiv
+#define glGetQueryObjectiv(...) GL_COUNTED(GLEW_GET_FUN(__glewGetQueryObjectiv)(__VA_ARGS__))
+#undef glGetQueryObjectui64v
+#define glGetQueryObjectui64v(...) GL_COUNTED(GLEW_GET_FUN(__glewGetQueryObjectui64v)(__VA_ARGS__))
+#undef glTexSubImage3D
+#define glTexSubImage3D(...) GL_COUNTED(GLEW_GET_FUN(__glewTexSubImage3D)(__VA_ARGS__))
+#undef glBindFramebuffer
+#define glBindFramebuffer(...) GL_COUNTED(GLEW_GET_FUN(__glewBindFramebuffer)(__VA_ARGS__))
+
+#endif
@@ -0,0 +1,482 @@
+#include "glstate.h"
+
+#include <cstring>
+
+namespace
+{
+	// Shadow value of a binding or setting that is not known.
+	const GLuint kUnknown = 0xFFFFFFFF;
+}
+
+const int GLState::kMaxTextureUnits;
+const int GLState::kMaxUniformBindings;
+const int GLState::kMaxCaps;
+const int GLState::kMaxUniformLocations;
+
+bool GLState::filtering = true;
+size_t GLState::numIssued = 0;
+size_t GLState::numFiltered = 0;
+GLuint GLState::program;
+GLuint GLState::wantedProgram;
+GLuint GLState::vao;
+GLuint GLState::wantedVao;
+GLenum GLState::activeUnit;
+GLuint GLState::textures[GLState::kMaxTextureUnits][3];
+GLuint GLState::buffers[3];
+GLState::BufferRange GLState::uniformBindings[GLState::kMaxUniformBindings];
+GLenum GLState::caps[GLState::kMaxCaps];
+GLuint GLState::capStates[GLState::kMaxCaps];
+int GLState::numCaps = 0;
+GLuint GLState::depthFunc;
+GLuint GLState::depthMask;
+GLuint GLState::polygonMode;
+GLfloat GLState::pointSize;
+std::unordered_map<GLuint, std::vector<GLState::UniformValue>> GLState::uniforms;
+std::vector<GLState::UniformValue>* GLState::programUniforms = nullptr;
+
+namespace
+{
+	// Nothing is known before the first call (defined after the data it resets).
+	struct GLStateInitializer
+	{
+		GLStateInitializer() { GLState::Invalidate(); }
+	} glStateInitializer;
+}
+
+bool GLState::Skip(const bool redundant)
+{
+	if (redundant && filtering) {
+		++numFiltered;
+		return true;
+	}
+	++numIssued;
+	return false;
+}
+
+int GLState::GetTextureTargetIndex(const GLenum target)
+{
+	switch (target) {
+	case GL_TEXTURE_2D:			return 0;
+	case GL_TEXTURE_2D_ARRAY:	return 1;
+	case GL_TEXTURE_CUBE_MAP:	return 2;
+	default:					return -1;
+	}
+}
+
+int GLState::GetBufferTargetIndex(const GLenum target)
+{
+	switch (target) {
+	case GL_ARRAY_BUFFER:			return 0;
+	case GL_ELEMENT_ARRAY_BUFFER:	return 1;
+	case GL_UNIFORM_BUFFER:			return 2;
+	default:						return -1;
+	}
+}
+
+// Program ----------------------------------------------------------------------------------------
+
+void GLState::UseProgram(const GLuint newProgram)
+{
+	wantedProgram = newProgram;
+	// Deferred: counted as filtered until something needs it.
+	if (newProgram == 0 && filtering) {
+		++numFiltered;
+		return;
+	}
+	if (Skip(newProgram == program))
+		return;
+	GLEW_GET_FUN(__glewUseProgram)(newProgram);
+	program = newProgram;
+	programUniforms = (program != 0) ? &uniforms[program] : nullptr;
+}
+
+void GLState::ApplyProgram()
+{
+	if (wantedProgram == program)
+		return;
+	// A deferred unbind was needed after all.
+	--numFiltered;
+	++numIssued;
+	GLEW_GET_FUN(__glewUseProgram)(wantedProgram);
+	program = wantedProgram;
+	programUniforms = nullptr;
+}
+
+// Textures ---------------------------------------------------------------------------------------
+
+void GLState::ActiveTexture(const GLenum unit)
+{
+	if (Skip(unit == activeUnit))
+		return;
+	GLEW_GET_FUN(__glewActiveTexture)(unit);
+	activeUnit = unit;
+}
+
+void GLState::BindTexture(const GLenum target, const GLuint texture)
+{
+	const int targetIndex = GetTextureTargetIndex(target);
+	const GLuint unitIndex = activeUnit - GL_TEXTURE0;
+	const bool tracked = targetIndex >= 0 && activeUnit != kUnknown && unitIndex < (GLuint)kMaxTextureUnits;
+	if (Skip(tracked && textures[unitIndex][targetIndex] == texture))
+		return;
+	(glBindTexture)(target, texture);
+	if (tracked)
+		textures[unitIndex][targetIndex] = texture;
+}
+
+// Buffers and vertex arrays ----------------------------------------------------------------------
+
+void GLState::BindBuffer(const GLenum target, const GLuint buffer)
+{
+	// The index buffer binding belongs to the vertex array object.
+	if (target == GL_ELEMENT_ARRAY_BUFFER)
+		ApplyVertexArray();
+	const int targetIndex = GetBufferTargetIndex(target);
+	if (Skip(targetIndex >= 0 && buffers[targetIndex] == buffer))
+		return;
+	GLEW_GET_FUN(__glewBindBuffer)(target, buffer);
+	if (targetIndex >= 0)
+		buffers[targetIndex] = buffer;
+}
+
+void GLState::BindBufferBase(const GLenum target, const GLuint index, const GLuint buffer)
+{
+	BindBufferRange(target, index, buffer, 0, -1);
+}
+
+void GLState::BindBufferRange(const GLenum target, const GLuint index, const GLuint buffer,
+							  const GLintptr offset, const GLsizeiptr size)
+{
+	const bool tracked = target == GL_UNIFORM_BUFFER && index < (GLuint)kMaxUniformBindings;
+	if (tracked) {
+		const BufferRange& bound = uniformBindings[index];
+		if (Skip(bound.buffer == buffer && bound.offset == offset && bound.size == size))
+			return;
+	}
+	else
+		++numIssued;
+	if (size < 0)
+		GLEW_GET_FUN(__glewBindBufferBase)(target, index, buffer);
+	else
+		GLEW_GET_FUN(__glewBindBufferRange)(target, index, buffer, offset, size);
+	if (tracked) {
+		uniformBindings[index].buffer = buffer;
+		uniformBindings[index].offset = offset;
+		uniformBindings[index].size = size;
+	}
+	// Indexed binds set the generic binding point too.
+	const int targetIndex = GetBufferTargetIndex(target);
+	if (targetIndex >= 0)
+		buffers[targetIndex] = buffer;
+}
+
+void GLState::BindVertexArray(const GLuint newVao)
+{
+	wantedVao = newVao;
+	if (newVao == 0 && filtering) {
+		++numFiltered;
+		return;
+	}
+	if (Skip(newVao == vao))
+		return;
+	GLEW_GET_FUN(__glewBindVertexArray)(newVao);
+	vao = newVao;
+	buffers[GetBufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = kUnknown;
+}
+
+void GLState::ApplyVertexArray()
+{
+	if (wantedVao == vao)
+		return;
+	--numFiltered;
+	++numIssued;
+	GLEW_GET_FUN(__glewBindVertexArray)(wantedVao);
+	vao = wantedVao;
+	buffers[GetBufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = kUnknown;
+}
+
+void GLState::EnableVertexAttribArray(const GLuint index)
+{
+	ApplyVertexArray();
+	++numIssued;
+	GLEW_GET_FUN(__glewEnableVertexAttribArray)(index);
+}
+
+void GLState::DisableVertexAttribArray(const GLuint index)
+{
+	ApplyVertexArray();
+	++numIssued;
+	GLEW_GET_FUN(__glewDisableVertexAttribArray)(index);
+}
+
+void GLState::VertexAttribPointer(const GLuint index, const GLint size, const GLenum type, const GLboolean normalized,
+								  const GLsizei stride, const void* pointer)
+{
+	ApplyVertexArray();
+	++numIssued;
+	GLEW_GET_FUN(__glewVertexAttribPointer)(index, size, type, normalized, stride, pointer);
+}
+
+// Fixed-function state ---------------------------------------------------------------------------
+
+void GLState::SetCap(const GLenum cap, const GLboolean enabled)
+{
+	int i = 0;
+	while (i < numCaps && caps[i] != cap)
+		++i;
+	if (i == numCaps && numCaps < kMaxCaps) {
+		caps[numCaps] = cap;
+		capStates[numCaps] = kUnknown;
+		++numCaps;
+	}
+	const bool tracked = i < numCaps;
+	if (Skip(tracked && capStates[i] == (GLuint)enabled))
+		return;
+	if (enabled)
+		(glEnable)(cap);
+	else
+		(glDisable)(cap);
+	if (tracked)
+		capStates[i] = enabled;
+}
+
+void GLState::Enable(const GLenum cap)
+{
+	SetCap(cap, GL_TRUE);
+}
+
+void GLState::Disable(const GLenum cap)
+{
+	SetCap(cap, GL_FALSE);
+}
+
+void GLState::DepthFunc(const GLenum func)
+{
+	if (Skip(func == depthFunc))
+		return;
+	(glDepthFunc)(func);
+	depthFunc = func;
+}
+
+void GLState::DepthMask(const GLboolean flag)
+{
+	if (Skip((GLuint)flag == depthMask))
+		return;
+	(glDepthMask)(flag);
+	depthMask = flag;
+}
+
+void GLState::PolygonMode(const GLenum face, const GLenum mode)
+{
+	// Only the mode of both faces is tracked.
+	if (Skip(face == GL_FRONT_AND_BACK && mode == polygonMode))
+		return;
+	(glPolygonMode)(face, mode);
+	polygonMode = (face == GL_FRONT_AND_BACK) ? mode : kUnknown;
+}
+
+void GLState::PointSize(const GLfloat size)
+{
+	if (Skip(size == pointSize))
+		return;
+	(glPointSize)(size);
+	pointSize = size;
+}
+
+// Uniforms ---------------------------------------------------------------------------------------
+
+bool GLState::SkipUniform(const GLint location, const void* value, const size_t numBytes)
+{
+	// GL ignores location -1.
+	if (location < 0)
+		return Skip(true);
+	if (programUniforms == nullptr || location >= kMaxUniformLocations)
+		return Skip(false);
+	if ((size_t)location >= programUniforms->size()) {
+		UniformValue unknown;
+		unknown.known = false;
+		programUniforms->resize(location + 1, unknown);
+	}
+	UniformValue& last = (*programUniforms)[location];
+	// Larger values are not kept.
+	if (numBytes > sizeof(last.bytes)) {
+		last.known = false;
+		return Skip(false);
+	}
+	const bool redundant = last.known && (size_t)last.numBytes == numBytes && std::memcmp(last.bytes, value, numBytes) == 0;
+	if (Skip(redundant))
+		return true;
+	last.known = true;
+	last.numBytes = (GLsizei)numBytes;
+	std::memcpy(last.bytes, value, numBytes);
+	return false;
+}
+
+void GLState::Uniform1i(const GLint location, const GLint v0)
+{
+	if (!SkipUniform(location, &v0, sizeof(v0)))
+		GLEW_GET_FUN(__glewUniform1i)(location, v0);
+}
+
+void GLState::Uniform1iv(const GLint location, const GLsizei count, const GLint* value)
+{
+	if (!SkipUniform(location, value, sizeof(GLint) * count))
+		GLEW_GET_FUN(__glewUniform1iv)(location, count, value);
+}
+
+void GLState::Uniform1f(const GLint location, const GLfloat v0)
+{
+	if (!SkipUniform(location, &v0, sizeof(v0)))
+		GLEW_GET_FUN(__glewUniform1f)(location, v0);
+}
+
+void GLState::Uniform2i(const GLint location, const GLint v0, const GLint v1)
+{
+	const GLint value[2] = { v0, v1 };
+	if (!SkipUniform(location, value, sizeof(value)))
+		GLEW_GET_FUN(__glewUniform2i)(location, v0, v1);
+}
+
+void GLState::Uniform3fv(const GLint location, const GLsizei count, const GLfloat* value)
+{
+	if (!SkipUniform(location, value, sizeof(GLfloat) * 3 * count))
+		GLEW_GET_FUN(__glewUniform3fv)(location, count, value);
+}
+
+void GLState::Uniform4fv(const GLint location, const GLsizei count, const GLfloat* value)
+{
+	if (!SkipUniform(location, value, sizeof(GLfloat) * 4 * count))
+		GLEW_GET_FUN(__glewUniform4fv)(location, count, value);
+}
+
+void GLState::UniformMatrix4fv(const GLint location, const GLsizei count, const GLboolean transpose, const GLfloat* value)
+{
+	// A transposed matrix has the same bytes as another value: it is never compared.
+	const size_t numBytes = transpose ? (size_t)-1 : sizeof(GLfloat) * 16 * count;
+	if (!SkipUniform(location, value, numBytes))
+		GLEW_GET_FUN(__glewUniformMatrix4fv)(location, count, transpose, value);
+}
+
+// Draws ------------------------------------------------------------------------------------------
+
+void GLState::DrawArrays(const GLenum mode, const GLint first, const GLsizei count)
+{
+	Flush();
+	++numIssued;
+	(glDrawArrays)(mode, first, count);
+}
+
+void GLState::DrawElements(const GLenum mode, const GLsizei count, const GLenum type, const void* indices)
+{
+	Flush();
+	++numIssued;
+	(glDrawElements)(mode, count, type, indices);
+}
+
+void GLState::DrawElementsInstanced(const GLenum mode, const GLsizei count, const GLenum type, const void* indices,
+									const GLsizei instanceCount)
+{
+	Flush();
+	++numIssued;
+	GLEW_GET_FUN(__glewDrawElementsInstanced)(mode, count, type, indices, instanceCount);
+}
+
+// Deletion ---------------------------------------------------------------------------------------
+
+void GLState::DeleteProgram(const GLuint deleted)
+{
+	// A program in use stays in use until another one is: its state is simply forgotten.
+	if (deleted == program || deleted == wantedProgram) {
+		program = kUnknown;
+		wantedProgram = kUnknown;
+		programUniforms = nullptr;
+	}
+	uniforms.erase(deleted);
+	GLEW_GET_FUN(__glewDeleteProgram)(deleted);
+}
+
+void GLState::DeleteTextures(const GLsizei n, const GLuint* deleted)
+{
+	for (GLsizei i = 0; i < n; ++i) {
+		if (deleted[i] == 0)
+			continue;
+		for (int unit = 0; unit < kMaxTextureUnits; ++unit) {
+			for (int target = 0; target < 3; ++target) {
+				if (textures[unit][target] == deleted[i])
+					textures[unit][target] = 0;
+			}
+		}
+	}
+	(glDeleteTextures)(n, deleted);
+}
+
+void GLState::DeleteBuffers(const GLsizei n, const GLuint* deleted)
+{
+	for (GLsizei i = 0; i < n; ++i) {
+		if (deleted[i] == 0)
+			continue;
+		for (int target = 0; target < 3; ++target) {
+			if (buffers[target] == deleted[i])
+				buffers[target] = 0;
+		}
+		for (int index = 0; index < kMaxUniformBindings; ++index) {
+			if (uniformBindings[index].buffer == deleted[i])
+				uniformBindings[index].buffer = kUnknown;
+		}
+	}
+	GLEW_GET_FUN(__glewDeleteBuffers)(n, deleted);
+}
+
+void GLState::DeleteVertexArrays(const GLsizei n, const GLuint* deleted)
+{
+	for (GLsizei i = 0; i < n; ++i) {
+		if (deleted[i] == 0)
+			continue;
+		// Deleting the bound vertex array binds 0.
+		if (vao == deleted[i]) {
+			vao = 0;
+			buffers[GetBufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = kUnknown;
+		}
+		if (wantedVao == deleted[i])
+			wantedVao = 0;
+	}
+	GLEW_GET_FUN(__glewDeleteVertexArrays)(n, deleted);
+}
+
+// Control ----------------------------------------------------------------------------------------
+
+void GLState::Flush()
+{
+	ApplyProgram();
+	ApplyVertexArray();
+}
+
+void GLState::Invalidate()
+{
+	program = kUnknown;
+	wantedProgram = kUnknown;
+	vao = kUnknown;
+	wantedVao = kUnknown;
+	activeUnit = kUnknown;
+	for (int unit = 0; unit < kMaxTextureUnits; ++unit) {
+		for (int target = 0; target < 3; ++target)
+			textures[unit][target] = kUnknown;
+	}
+	for (int target = 0; target < 3; ++target)
+		buffers[target] = kUnknown;
+	for (int index = 0; index < kMaxUniformBindings; ++index)
+		uniformBindings[index].buffer = kUnknown;
+	numCaps = 0;
+	depthFunc = kUnknown;
+	depthMask = kUnknown;
+	polygonMode = kUnknown;
+	pointSize = -1.0f;
+	uniforms.clear();
+	programUniforms = nullptr;
+}
+
+void GLState::SetFiltering(const bool enabled)
+{
+	Flush();
+	filtering = enabled;
+}
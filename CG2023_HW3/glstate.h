@@ -0,0 +1,186 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include "glcallcounter.h"
+
+#include <unordered_map>
+#include <vector>
+
+// GLState Declarations.
+// Shadow copies of the GL state the render loop changes: the program and its uniforms, the
+// active texture unit and the 2D, array and cube map textures of each unit, buffer and vertex
+// array bindings, capabilities, and the depth, polygon and point state. The macros below route
+// those calls here, and a call that would set what is already set is not issued.
+// Binding program 0 or vertex array 0 is deferred until something depends on it (a draw, a
+// vertex attribute, an index buffer), so that the Bind(); draw; UnBind() pairs of consecutive
+// draws with the same object collapse into one bind.
+// The shadow is only right if every change goes through here: objects are deleted through
+// the wrappers too, and code that changes the state some other way must call Invalidate().
+class GLState
+{
+public:
+	// GLState Public Methods.
+	static void UseProgram(const GLuint program);
+	static void ActiveTexture(const GLenum unit);
+	static void BindTexture(const GLenum target, const GLuint texture);
+	static void BindBuffer(const GLenum target, const GLuint buffer);
+	static void BindBufferBase(const GLenum target, const GLuint index, const GLuint buffer);
+	static void BindBufferRange(const GLenum target, const GLuint index, const GLuint buffer,
+								const GLintptr offset, const GLsizeiptr size);
+	static void BindVertexArray(const GLuint vao);
+	static void EnableVertexAttribArray(const GLuint index);
+	static void DisableVertexAttribArray(const GLuint index);
+	static void VertexAttribPointer(const GLuint index, const GLint size, const GLenum type, const GLboolean normalized,
+									const GLsizei stride, const void* pointer);
+	static void Enable(const GLenum cap);
+	static void Disable(const GLenum cap);
+	static void DepthFunc(const GLenum func);
+	static void DepthMask(const GLboolean flag);
+	static void PolygonMode(const GLenum face, const GLenum mode);
+	static void PointSize(const GLfloat size);
+
+	static void Uniform1i(const GLint location, const GLint v0);
+	static void Uniform1iv(const GLint location, const GLsizei count, const GLint* value);
+	static void Uniform1f(const GLint location, const GLfloat v0);
+	static void Uniform2i(const GLint location, const GLint v0, const GLint v1);
+	static void Uniform3fv(const GLint location, const GLsizei count, const GLfloat* value);
+	static void Uniform4fv(const GLint location, const GLsizei count, const GLfloat* value);
+	static void UniformMatrix4fv(const GLint location, const GLsizei count, const GLboolean transpose, const GLfloat* value);
+
+	static void DrawArrays(const GLenum mode, const GLint first, const GLsizei count);
+	static void DrawElements(const GLenum mode, const GLsizei count, const GLenum type, const void* indices);
+	static void DrawElementsInstanced(const GLenum mode, const GLsizei count, const GLenum type, const void* indices,
+									  const GLsizei instanceCount);
+
+	// Deleting an object unbinds it, so the shadow forgets it.
+	static void DeleteProgram(const GLuint program);
+	static void DeleteTextures(const GLsizei n, const GLuint* textures);
+	static void DeleteBuffers(const GLsizei n, const GLuint* buffers);
+	static void DeleteVertexArrays(const GLsizei n, const GLuint* arrays);
+
+	// Issue the deferred unbinds, before GL is used outside of these wrappers.
+	static void Flush();
+	// Forget the whole shadow: the next call of each kind is issued.
+	static void Invalidate();
+	// With filtering off every call is issued (and the shadow still kept), for comparison.
+	static void SetFiltering(const bool enabled);
+	static bool IsFiltering() { return filtering; }
+
+	// Calls made to GL and calls dropped as redundant, since the start.
+	static size_t GetNumIssued() { return numIssued; }
+	static size_t GetNumFiltered() { return numFiltered; }
+
+	static const int kMaxTextureUnits = 16;
+	static const int kMaxUniformBindings = 16;
+	static const int kMaxCaps = 8;
+	// Uniforms at higher locations are not compared.
+	static const int kMaxUniformLocations = 1024;
+
+private:
+	// GLState Private Types.
+	struct BufferRange
+	{
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;		// -1 for glBindBufferBase.
+	};
+	// Up to 64 bytes (a mat4) of a uniform's last value.
+	struct UniformValue
+	{
+		bool known;
+		GLsizei numBytes;
+		unsigned char bytes[64];
+	};
+
+	// GLState Private Methods.
+	// Count a call and tell whether to skip it.
+	static bool Skip(const bool redundant);
+	static bool SkipUniform(const GLint location, const void* value, const size_t numBytes);
+	static void SetCap(const GLenum cap, const GLboolean enabled);
+	static void ApplyProgram();
+	static void ApplyVertexArray();
+	static int GetTextureTargetIndex(const GLenum target);
+	static int GetBufferTargetIndex(const GLenum target);
+
+	// GLState Private Data.
+	static bool filtering;
+	static size_t numIssued;
+	static size_t numFiltered;
+
+	// Actual bindings (kUnknown if not known) and the deferred ones.
+	static GLuint program;
+	static GLuint wantedProgram;
+	static GLuint vao;
+	static GLuint wantedVao;
+	static GLenum activeUnit;
+	static GLuint textures[kMaxTextureUnits][3];
+	static GLuint buffers[3];
+	static BufferRange uniformBindings[kMaxUniformBindings];
+	static GLenum caps[kMaxCaps];
+	static GLuint capStates[kMaxCaps];
+	static int numCaps;
+	static GLuint depthFunc;
+	static GLuint depthMask;
+	static GLuint polygonMode;
+	static GLfloat pointSize;
+
+	// Last uniform values of each program, indexed by location.
+	static std::unordered_map<GLuint, std::vector<UniformValue>> uniforms;
+	static std::vector<UniformValue>* programUniforms;
+};
+
+// State changes through the shadow (still counted as calls made).
+#undef glUseProgram
+#define glUseProgram(...) GL_COUNTED(GLState::UseProgram(__VA_ARGS__))
+#undef glActiveTexture
+#define glActiveTexture(...) GL_COUNTED(GLState::ActiveTexture(__VA_ARGS__))
+#define glBindTexture(...) GL_COUNTED(GLState::BindTexture(__VA_ARGS__))
+#undef glBindBuffer
+#define glBindBuffer(...) GL_COUNTED(GLState::BindBuffer(__VA_ARGS__))
+#undef glBindBufferBase
+#define glBindBufferBase(...) GL_COUNTED(GLState::BindBufferBase(__VA_ARGS__))
+#undef glBindBufferRange
+#define glBindBufferRange(...) GL_COUNTED(GLState::BindBufferRange(__VA_ARGS__))
+#undef glBindVertexArray
+#define glBindVertexArray(...) GL_COUNTED(GLState::BindVertexArray(__VA_ARGS__))
+#undef glEnableVertexAttribArray
+#define glEnableVertexAttribArray(...) GL_COUNTED(GLState::EnableVertexAttribArray(__VA_ARGS__))
+#undef glDisableVertexAttribArray
+#define glDisableVertexAttribArray(...) GL_COUNTED(GLState::DisableVertexAttribArray(__VA_ARGS__))
+#undef glVertexAttribPointer
+#define glVertexAttribPointer(...) GL_COUNTED(GLState::VertexAttribPointer(__VA_ARGS__))
+#define glEnable(...) GL_COUNTED(GLState::Enable(__VA_ARGS__))
+#define glDisable(...) GL_COUNTED(GLState::Disable(__VA_ARGS__))
+#define glDepthFunc(...) GL_COUNTED(GLState::DepthFunc(__VA_ARGS__))
+#define glDepthMask(...) GL_COUNTED(GLState::DepthMask(__VA_ARGS__))
+#define glPolygonMode(...) GL_COUNTED(GLState::PolygonMode(__VA_ARGS__))
+#define glPointSize(...) GL_COUNTED(GLState::PointSize(__VA_ARGS__))
+#undef glUniform1i
+#define glUniform1i(...) GL_COUNTED(GLState::Uniform1i(__VA_ARGS__))
+#undef glUniform1iv
+#define glUniform1iv(...) GL_COUNTED(GLState::Uniform1iv(__VA_ARGS__))
+#undef glUniform1f
+#define glUniform1f(...) GL_COUNTED(GLState::Uniform1f(__VA_ARGS__))
+#undef glUniform2i
+#define glUniform2i(...) GL_COUNTED(GLState::Uniform2i(__VA_ARGS__))
+#undef glUniform3fv
+#define glUniform3fv(...) GL_COUNTED(GLState::Uniform3fv(__VA_ARGS__))
+#undef glUniform4fv
+#define glUniform4fv(...) GL_COUNTED(GLState::Uniform4fv(__VA_ARGS__))
+#undef glUniformMatrix4fv
+#define glUniformMatrix4fv(...) GL_COUNTED(GLState::UniformMatrix4fv(__VA_ARGS__))
+#define glDrawArrays(...) GL_COUNTED(GLState::DrawArrays(__VA_ARGS__))
+#define glDrawElements(...) GL_COUNTED(GLState::DrawElements(__VA_ARGS__))
+#undef glDrawElementsInstanced
+#define glDrawElementsInstanced(...) GL_COUNTED(GLState::DrawElementsInstanced(__VA_ARGS__))
+
+// Deletion keeps the shadow in step (not counted, like the other one-off calls).
+#undef glDeleteProgram
+#define glDeleteProgram(...) GLState::DeleteProgram(__VA_ARGS__)
+#define glDeleteTextures(...) GLState::DeleteTextures(__VA_ARGS__)
+#undef glDeleteBuffers
+#define glDeleteBuffers(...) GLState::DeleteBuffers(__VA_ARGS__)
+#undef glDeleteVertexArrays
+#define glDeleteVertexArrays(...) GLState::DeleteVertexArrays(__VA_ARGS__)
+
+#endif
@@ -0,0 +1,270 @@
+#include "gpuprofiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+const int GpuProfiler::kFramesInFlight;
+const int GpuProfiler::kMaxScopesPerFrame;
+const int GpuProfiler::kMaxDepth;
+const int GpuProfiler::kWindowSize;
+
+GpuProfiler::GpuProfiler()
+{
+	inFrame = false;
+	current = 0;
+	depth = 0;
+	numDropped = 0;
+	for (FrameQueries& frame : frames) {
+		frame.numScopes = 0;
+		frame.lastQuery = 0;
+		frame.pending = false;
+	}
+	GLint counterBits = 0;
+	glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &counterBits);
+	supported = (counterBits > 0);
+	if (!supported) {
+		std::cerr << "[WARNING] No GPU timestamp counter: the GPU profiler is off" << std::endl;
+		return;
+	}
+	for (FrameQueries& frame : frames)
+		glGenQueries(kMaxScopesPerFrame * 2, frame.queries);
+	scopes.reserve(kMaxScopesPerFrame);
+	sorted.reserve(kWindowSize);
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	if (!supported)
+		return;
+	for (FrameQueries& frame : frames)
+		glDeleteQueries(kMaxScopesPerFrame * 2, frame.queries);
+}
+
+void GpuProfiler::BeginFrame()
+{
+	if (!supported)
+		return;
+	Collect();
+	current = (current + 1) % kFramesInFlight;
+	FrameQueries& frame = frames[current];
+	if (frame.pending) {
+		// The GPU is more than kFramesInFlight frames behind: give up this set rather than wait.
+		++numDropped;
+		frame.pending = false;
+	}
+	frame.numScopes = 0;
+	frame.lastQuery = 0;
+	depth = 0;
+	inFrame = true;
+}
+
+void GpuProfiler::EndFrame()
+{
+	if (!supported || !inFrame)
+		return;
+	if (depth > 0) {
+		std::cerr << "[WARNING] GPU profiler scope left open at the end of the frame" << std::endl;
+		while (depth > 0)
+			EndScope();
+	}
+	FrameQueries& frame = frames[current];
+	frame.pending = (frame.numScopes > 0);
+	inFrame = false;
+}
+
+void GpuProfiler::BeginScope(const char* name)
+{
+	if (!supported || !inFrame)
+		return;
+	if (depth >= kMaxDepth) {
+		++depth;
+		return;
+	}
+	FrameQueries& frame = frames[current];
+	int slot = -1;
+	if (frame.numScopes < kMaxScopesPerFrame) {
+		slot = frame.numScopes++;
+		frame.scopeIds[slot] = FindScope(name);
+		glQueryCounter(frame.queries[slot * 2], GL_TIMESTAMP);
+	}
+	stack[depth++] = slot;
+}
+
+void GpuProfiler::EndScope()
+{
+	if (!supported || !inFrame || depth == 0)
+		return;
+	--depth;
+	if (depth >= kMaxDepth)
+		return;
+	const int slot = stack[depth];
+	if (slot < 0)
+		return;
+	FrameQueries& frame = frames[current];
+	frame.lastQuery = frame.queries[slot * 2 + 1];
+	glQueryCounter(frame.lastQuery, GL_TIMESTAMP);
+}
+
+int GpuProfiler::FindScope(const char* name)
+{
+	for (size_t i = 0; i < scopes.size(); ++i) {
+		if (scopes[i].name == name || std::strcmp(scopes[i].name, name) == 0)
+			return (int)i;
+	}
+	Scope scope;
+	scope.name = name;
+	scope.window.assign(kWindowSize, 0.0f);
+	scope.numSamples = 0;
+	scope.next = 0;
+	scope.frameMs = 0.0f;
+	scope.seen = false;
+	scopes.push_back(scope);
+	return (int)scopes.size() - 1;
+}
+
+void GpuProfiler::Collect()
+{
+	// Oldest first; queries complete in order, so a frame that is not done ends the pass.
+	for (int i = 1; i <= kFramesInFlight; ++i) {
+		FrameQueries& frame = frames[(current + i) % kFramesInFlight];
+		if (frame.pending && !CollectFrame(frame))
+			break;
+	}
+}
+
+bool GpuProfiler::CollectFrame(FrameQueries& frame)
+{
+	GLint available = 0;
+	glGetQueryObjectiv(frame.lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return false;
+	for (int slot = 0; slot < frame.numScopes; ++slot) {
+		GLuint64 beginNs = 0;
+		GLuint64 endNs = 0;
+		glGetQueryObjectui64v(frame.queries[slot * 2], GL_QUERY_RESULT, &beginNs);
+		glGetQueryObjectui64v(frame.queries[slot * 2 + 1], GL_QUERY_RESULT, &endNs);
+		Scope& scope = scopes[frame.scopeIds[slot]];
+		scope.frameMs += (endNs > beginNs) ? (float)((double)(endNs - beginNs) / 1.0e6) : 0.0f;
+		scope.seen = true;
+	}
+	for (Scope& scope : scopes) {
+		if (!scope.seen)
+			continue;
+		scope.window[scope.next] = scope.frameMs;
+		scope.next = (scope.next + 1) % kWindowSize;
+		scope.numSamples = std::min(scope.numSamples + 1, kWindowSize);
+		scope.frameMs = 0.0f;
+		scope.seen = false;
+	}
+	frame.pending = false;
+	return true;
+}
+
+GpuProfiler::Summary GpuProfiler::GetSummary(const int scopeId)
+{
+	Summary summary = { 0, 0.0, 0.0, 0.0, 0.0 };
+	const Scope& scope = scopes[scopeId];
+	if (scope.numSamples == 0)
+		return summary;
+	sorted.clear();
+	double sumMs = 0.0;
+	for (int i = 0; i < scope.numSamples; ++i) {
+		sorted.push_back(scope.window[i]);
+		sumMs += scope.window[i];
+	}
+	std::sort(sorted.begin(), sorted.end());
+	const int n = scope.numSamples;
+	summary.numSamples = n;
+	summary.minMs = sorted[0];
+	summary.meanMs = sumMs / n;
+	summary.p99Ms = sorted[std::max(0, (int)std::ceil(0.99 * n) - 1)];
+	summary.lastMs = scope.window[(scope.next + kWindowSize - 1) % kWindowSize];
+	return summary;
+}
+
+bool GpuProfiler::WriteCsv(const std::string& filePath)
+{
+	std::ofstream file(filePath, std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "[WARNING] Failed to write GPU profile: " << filePath << std::endl;
+		return false;
+	}
+	file << "scope,samples,min_ms,mean_ms,p99_ms,last_ms\n";
+	for (int i = 0; i < GetNumScopes(); ++i) {
+		const Summary s = GetSummary(i);
+		file << scopes[i].name << "," << s.numSamples << "," << s.minMs << "," << s.meanMs << "," << s.p99Ms << ","
+			 << s.lastMs << "\n";
+	}
+	return file.good();
+}
+
+bool GpuProfiler::WriteJson(const std::string& filePath)
+{
+	std::ofstream file(filePath, std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "[WARNING] Failed to write GPU profile: " << filePath << std::endl;
+		return false;
+	}
+	file << "{\n  \"framesDropped\": " << numDropped << ",\n  \"scopes\": [";
+	for (int i = 0; i < GetNumScopes(); ++i) {
+		const Summary s = GetSummary(i);
+		const Scope& scope = scopes[i];
+		file << ((i > 0) ? ",\n" : "\n") << "    { \"name\": \"" << scope.name << "\", \"samples\": " << s.numSamples
+			 << ", \"minMs\": " << s.minMs << ", \"meanMs\": " << s.meanMs << ", \"p99Ms\": " << s.p99Ms
+			 << ", \"frameMs\": [";
+		// Oldest first.
+		const int first = (scope.numSamples < kWindowSize) ? 0 : scope.next;
+		for (int j = 0; j < scope.numSamples; ++j)
+			file << ((j > 0) ? ", " : "") << scope.window[(first + j) % kWindowSize];
+		file << "] }";
+	}
+	file << "\n  ]\n}\n";
+	return file.good();
+}
+
+void GpuProfiler::DrawOverlay(const int screenHeight)
+{
+	if (!supported)
+		return;
+	// Bitmap text is fixed function: no program, and the unbinds deferred by GLState issued.
+	glUseProgram(0);
+	GLState::Flush();
+	glDisable(GL_DEPTH_TEST);
+	glColor3f(1.0f, 1.0f, 0.6f);
+
+	const int lineHeight = 15;
+	int y = screenHeight - lineHeight;
+	char line[128];
+	std::snprintf(line, sizeof(line), "GPU ms, last %d frames      min    mean     p99", kWindowSize);
+	glWindowPos2i(8, y);
+	glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)line);
+	for (int i = 0; i < GetNumScopes() && y > lineHeight; ++i) {
+		y -= lineHeight;
+		const Summary s = GetSummary(i);
+		std::snprintf(line, sizeof(line), "%-24.24s %7.3f %7.3f %7.3f", scopes[i].name, s.minMs, s.meanMs, s.p99Ms);
+		glWindowPos2i(8, y);
+		glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)line);
+	}
+	glEnable(GL_DEPTH_TEST);
+}
+
+void GpuProfiler::ShowInfo()
+{
+	std::cout << "------------------------------" << std::endl;
+	if (!supported) {
+		std::cout << "GPU profiler: no timestamp counter" << std::endl;
+		std::cout << "------------------------------" << std::endl;
+		return;
+	}
+	std::cout << "GPU time per scope (last " << kWindowSize << " frames, " << numDropped << " frames dropped)" << std::endl;
+	std::cout << std::fixed << std::setprecision(3);
+	for (int i = 0; i < GetNumScopes(); ++i) {
+		const Summary s = GetSummary(i);
+		std::cout << std::left << std::setw(16) << scopes[i].name << std::right << " min " << s.minMs << " ms, mean "
+				  << s.meanMs << " ms, p99 " << s.p99Ms << " ms (" << s.numSamples << " frames)" << std::endl;
+	}
+	std::cout.unsetf(std::ios_base::floatfield);
+	std::cout << "------------------------------" << std::endl;
+}
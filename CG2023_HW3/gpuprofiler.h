@@ -0,0 +1,111 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "headers.h"
+
+// GpuProfiler Declarations.
+// GPU time of named scopes, from a GL_TIMESTAMP query at each end of a scope. Timestamps,
+// unlike GL_TIME_ELAPSED, nest and can run while a GpuTimer is measuring the same pass.
+// The queries of a frame come from a ring of kFramesInFlight sets; a frame's results are read
+// once its last query is available, a few frames later, and never waited for: a set that is
+// still pending when its turn comes around again is dropped. Scopes opened more than once in a
+// frame under the same name add up. Each scope keeps its last kWindowSize frames for the
+// rolling min, mean and p99 of the report, the overlay and the CSV and JSON exports.
+// Drivers without a timestamp counter (GL_QUERY_COUNTER_BITS of 0) leave the profiler off.
+class GpuProfiler
+{
+public:
+	// GpuProfiler Public Types.
+	struct Summary
+	{
+		int numSamples;
+		double minMs;
+		double meanMs;
+		double p99Ms;
+		double lastMs;
+	};
+
+	// GpuProfiler Public Methods.
+	GpuProfiler();
+	~GpuProfiler();
+
+	bool IsSupported() const { return supported; }
+	// Scopes must be opened and closed between BeginFrame() and EndFrame().
+	void BeginFrame();
+	void EndFrame();
+	// The name must outlive the profiler (a string literal).
+	void BeginScope(const char* name);
+	void EndScope();
+
+	int GetNumScopes() const { return (int)scopes.size(); }
+	const char* GetScopeName(const int scope) const { return scopes[scope].name; }
+	Summary GetSummary(const int scope);
+	int GetNumDropped() const { return numDropped; }
+
+	bool WriteCsv(const std::string& filePath);
+	bool WriteJson(const std::string& filePath);
+	// Draw the summaries in the top left corner with GLUT bitmap text (fixed function).
+	void DrawOverlay(const int screenHeight);
+	void ShowInfo();
+
+	static const int kFramesInFlight = 4;
+	static const int kMaxScopesPerFrame = 32;
+	static const int kMaxDepth = 8;
+	static const int kWindowSize = 256;
+
+private:
+	// GpuProfiler Private Types.
+	struct Scope
+	{
+		const char* name;
+		std::vector<float> window;		// Last kWindowSize frame times, in ms.
+		int numSamples;					// Valid entries of window.
+		int next;
+		float frameMs;					// Sum of this frame's results while collecting.
+		bool seen;
+	};
+	struct FrameQueries
+	{
+		GLuint queries[kMaxScopesPerFrame * 2];
+		int scopeIds[kMaxScopesPerFrame];
+		int numScopes;
+		GLuint lastQuery;				// Done means the whole frame is done.
+		bool pending;
+	};
+
+	// GpuProfiler Private Methods.
+	int FindScope(const char* name);
+	// Read back the frames whose queries are done.
+	void Collect();
+	bool CollectFrame(FrameQueries& frame);
+
+	// GpuProfiler Private Data.
+	bool supported;
+	bool inFrame;
+	FrameQueries frames[kFramesInFlight];
+	int current;
+	int stack[kMaxDepth];			// Open scopes (slot in the frame, -1 if not recorded).
+	int depth;
+	std::vector<Scope> scopes;
+	std::vector<float> sorted;		// Scratch of GetSummary().
+	int numDropped;
+};
+
+// Opens a GPU scope for the lifetime of the object; does nothing with a null profiler.
+class GpuProfileScope
+{
+public:
+	GpuProfileScope(GpuProfiler* profiler, const char* name) : profiler(profiler) {
+		if (profiler != nullptr)
+			profiler->BeginScope(name);
+	}
+	~GpuProfileScope() {
+		if (profiler != nullptr)
+			profiler->EndScope();
+	}
+
+private:
+	GpuProfiler* profiler;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#include "gputimer.h"
+
+GpuTimer::GpuTimer()
+{
+	pending = false;
+	active = false;
+	sumMs = 0.0;
+	numSamples = 0;
+	glGenQueries(1, &queryObj);
+}
+
+GpuTimer::~GpuTimer()
+{
+	glDeleteQueries(1, &queryObj);
+}
+
+void GpuTimer::Begin()
+{
+	Collect();
+	if (pending)
+		return;
+	glBeginQuery(GL_TIME_ELAPSED, queryObj);
+	active = true;
+}
+
+void GpuTimer::End()
+{
+	if (!active)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	active = false;
+	pending = true;
+}
+
+void GpuTimer::Collect()
+{
+	if (!pending)
+		return;
+	GLint available = 0;
+	glGetQueryObjectiv(queryObj, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return;
+	GLuint64 elapsedNs = 0;
+	glGetQueryObjectui64v(queryObj, GL_QUERY_RESULT, &elapsedNs);
+	sumMs += (double)elapsedNs / 1.0e6;
+	++numSamples;
+	pending = false;
+}
@@ -0,0 +1,36 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include "headers.h"
+
+// GpuTimer Declarations.
+// Averages the GPU time of a pass with a GL_TIME_ELAPSED query. A result is collected
+// when it is available, never by waiting; frames that would have to reuse a query still
+// in flight are skipped. Timers must not be nested.
+class GpuTimer
+{
+public:
+	// GpuTimer Public Methods.
+	GpuTimer();
+	~GpuTimer();
+
+	void Begin();
+	void End();
+	void Reset() { sumMs = 0.0; numSamples = 0; }
+
+	double GetAverageMs() const { return (numSamples > 0) ? sumMs / numSamples : 0.0; }
+	int GetNumSamples() const { return numSamples; }
+
+private:
+	// GpuTimer Private Methods.
+	void Collect();
+
+	// GpuTimer Private Data.
+	GLuint queryObj;
+	bool pending;
+	bool active;
+	double sumMs;
+	int numSamples;
+};
+
+#endif
@@ -1,23 +1,30 @@
-#ifndef HEADERS_H
-#define HEADERS_H
-
-// OpenGL and FreeGlut headers.
-#include <glew.h>
-#include <freeglut.h>
-
-// GLM.
-#include <glm.hpp>
-#include <gtc/type_ptr.hpp>
-
-// OpenCV.
-#include <opencv2/opencv.hpp>
-
-// C++ STL headers.
-#include <iostream>
-#include <vector>
-#include <string>
-#include <iomanip>
-#include <fstream>
-#include <sstream>
-
-#endif
+#ifndef HEADERS_H
+#define HEADERS_H
+
+// OpenGL and FreeGlut headers.
+#include <glew.h>
+#include <freeglut.h>
+
+// GLM.
+#include <glm.hpp>
+#include <gtc/type_ptr.hpp>
+
+// OpenCV.
+#include <opencv2/opencv.hpp>
+
+// C++ STL headers.
+#include <iostream>
+#include <vector>
+#include <string>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+
+// Counting and state shadowing wrappers of the per-frame GL calls (after every header that
+// declares them).
+#include "glstate.h"
+
+// CPU zone tracing (TRACE_ZONE), compiled out with CPU_TRACE=0.
+#include "cputracer.h"
+
+#endif
@@ -1,76 +1,262 @@
-#include "imagetexture.h"
-
-ImageTexture::ImageTexture(const std::string filePath)
-	: texFilePath(filePath)
-{
-	imageWidth = 0;
-	imageHeight = 0;
-	numChannels = 0;
-	textureObj = 0;
-
-	// Try to load texture image.
-	texImage = cv::imread(texFilePath);
-	if (texImage.rows == 0 || texImage.cols == 0) {
-		std::cerr << "[ERROR] Failed to load image texture: " << filePath << std::endl;
-		return;
-	}
-	imageWidth = texImage.cols;
-	imageHeight = texImage.rows;
-	numChannels = texImage.channels();
-
-	// Flip texture in vertical direction.
-	// OpenCV has smaller y coordinate on top; while OpenGL has larger.
-	cv::flip(texImage, texImage, 0);
-
-	glGenTextures(1, &textureObj);
-    glBindTexture(GL_TEXTURE_2D, textureObj);
-    switch (numChannels) {
-	case 1:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, imageWidth, imageHeight, 
-						0, GL_RED, GL_UNSIGNED_BYTE, texImage.ptr());
-		break;
-	case 3:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imageWidth, imageHeight, 
-						0, GL_BGR, GL_UNSIGNED_BYTE, texImage.ptr());
-		break;
-	case 4:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 
-						0, GL_BGRA, GL_UNSIGNED_BYTE, texImage.ptr());
-		break;
-	default:
-		std::cerr << "[ERROR] Unsupport texture format" << std::endl;
-		break;
-	}
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	// glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	glBindTexture(GL_TEXTURE_2D, 0);
-}
-
-ImageTexture::~ImageTexture()
-{
-	glDeleteTextures(1, &textureObj);
-	texImage.release();
-}
-
-void ImageTexture::Bind(GLenum textureUnit)
-{
-	glActiveTexture(textureUnit);
-    glBindTexture(GL_TEXTURE_2D, textureObj);
-}
-
-void ImageTexture::Preview()
-{
-	std::string windowText = "[DEBUG] TexturePreview: " + texFilePath;
-	cv::Mat previewImg = cv::Mat(texImage.rows, texImage.cols, texImage.type());
-	cv::cvtColor(texImage, previewImg, cv::COLOR_BGR2RGB);
-	cv::imshow(windowText, previewImg);
-	cv::waitKey(0);
-}
-
+#include "imagetexture.h"
+#include "texturecache.h"
+#include "textureresidency.h"
+
+ImageTexture::IngestStats ImageTexture::ingestStats = { 0, 0, 0, 0 };
+
+// Buffers reused by every load on a thread: the encoded file and the mip chain, whose
+// level 0 is the decode target. They only grow when a larger image arrives.
+struct ImageDecodeScratch
+{
+	std::vector<unsigned char> fileBytes;
+	MipChain chain;
+};
+static thread_local ImageDecodeScratch decodeScratch;
+
+ImageTexture::ImageTexture(const std::string filePath, const MipFilter filter)
+	: texFilePath(filePath), mipFilter(filter)
+{
+	imageWidth = 0;
+	imageHeight = 0;
+	numChannels = 0;
+	numMipLevels = 0;
+	residentBaseLevel = 0;
+	textureObj = 0;
+
+	if (Load())
+		TextureResidency::Register(this);
+}
+
+ImageTexture::~ImageTexture()
+{
+	TextureResidency::Unregister(this);
+	glDeleteTextures(1, &textureObj);
+}
+
+void ImageTexture::Bind(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	TextureResidency::Touch(this);
+    glBindTexture(GL_TEXTURE_2D, textureObj);
+}
+
+void ImageTexture::Preview()
+{
+	// The texture holds BGR rows top first, which is what imshow expects.
+	std::string windowText = "[DEBUG] TexturePreview: " + texFilePath;
+	cv::Mat previewImg;
+	if (!ReadImage(previewImg))
+		return;
+	cv::imshow(windowText, previewImg);
+	cv::waitKey(0);
+}
+
+bool ImageTexture::ReadImage(cv::Mat& image, const int level)
+{
+	if (level < 0 || level >= numMipLevels)
+		return false;
+	TextureResidency::Touch(this);
+	if (!IsFullyResident())
+		return false;
+
+	GLenum format = GL_BGR;
+	if (numChannels == 1)
+		format = GL_RED;
+	else if (numChannels == 4)
+		format = GL_BGRA;
+
+	image.create(std::max(1, imageHeight >> level), std::max(1, imageWidth >> level), CV_MAKETYPE(CV_8U, numChannels));
+	glBindTexture(GL_TEXTURE_2D, textureObj);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D, level, format, GL_UNSIGNED_BYTE, image.ptr());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	AddCopiedBytes(image.total() * image.elemSize());
+	return true;
+}
+
+void ImageTexture::ShowIngestInfo()
+{
+	std::cout << "------------------------------" << std::endl;
+	std::cout << "Texture ingest (all loads so far)" << std::endl;
+	std::cout << "Read: " << ingestStats.fileBytes / 1024 << " KB" << std::endl;
+	std::cout << "Decoded: " << ingestStats.decodedBytes / 1024 << " KB" << std::endl;
+	std::cout << "Copied after decoding: " << ingestStats.copiedBytes / 1024 << " KB" << std::endl;
+	std::cout << "Decode target allocations: " << ingestStats.decodeAllocations << std::endl;
+	std::cout << "------------------------------" << std::endl;
+}
+
+size_t ImageTexture::GetResidentBytes() const
+{
+	if (textureObj == 0)
+		return 0;
+	size_t bytes = 0;
+	for (int level = residentBaseLevel; level < numMipLevels; ++level) {
+		const size_t w = (size_t)std::max(1, imageWidth >> level);
+		const size_t h = (size_t)std::max(1, imageHeight >> level);
+		bytes += w * h * (size_t)numChannels;
+	}
+	return bytes;
+}
+
+bool ImageTexture::CanDropTopLevel() const
+{
+	if (textureObj == 0 || residentBaseLevel + 1 >= numMipLevels)
+		return false;
+	const int nextLevel = residentBaseLevel + 1;
+	return std::max(imageWidth >> nextLevel, imageHeight >> nextLevel) >= minResidentSize;
+}
+
+void ImageTexture::DropTopLevel()
+{
+	if (!CanDropTopLevel())
+		return;
+	// Sampling starts one level lower; the old top level is reallocated empty.
+	glBindTexture(GL_TEXTURE_2D, textureObj);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, residentBaseLevel + 1);
+	GLint internalFormat = GL_RGB;
+	GLenum format = GL_BGR;
+	if (numChannels == 1) {
+		internalFormat = GL_RED;
+		format = GL_RED;
+	}
+	else if (numChannels == 4) {
+		internalFormat = GL_RGBA;
+		format = GL_BGRA;
+	}
+	glTexImage2D(GL_TEXTURE_2D, residentBaseLevel, internalFormat, 0, 0, 0, format, GL_UNSIGNED_BYTE, nullptr);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	++residentBaseLevel;
+}
+
+void ImageTexture::Evict()
+{
+	// Metadata stays so the texture can still be packed, queried and restored.
+	glDeleteTextures(1, &textureObj);
+	textureObj = 0;
+	residentBaseLevel = 0;
+}
+
+bool ImageTexture::Restore()
+{
+	if (IsFullyResident())
+		return true;
+	return Load();
+}
+
+bool ImageTexture::Load()
+{
+	TRACE_ZONE("Load texture");
+	// Load prebuilt mip levels from the cache, or decode the image and build them.
+	MipChain& chain = decodeScratch.chain;
+	if (!LoadMipChain(chain))
+		return false;
+	imageWidth = chain.levels[0].cols;
+	imageHeight = chain.levels[0].rows;
+	numChannels = chain.levels[0].channels();
+	numMipLevels = chain.GetNumLevels();
+	residentBaseLevel = 0;
+
+	if (textureObj == 0)
+		glGenTextures(1, &textureObj);
+	glBindTexture(GL_TEXTURE_2D, textureObj);
+	Upload(chain);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numMipLevels - 1);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return true;
+}
+
+bool ImageTexture::LoadMipChain(MipChain& chain)
+{
+	TRACE_ZONE("Decode texture");
+	const size_t copiedBefore = ingestStats.copiedBytes;
+	if (TextureCache::Load(texFilePath, mipFilter, chain)) {
+		ingestStats.decodedBytes += chain.GetSizeInBytes();
+		std::cout << "[MIP] " << texFilePath << ": " << chain.GetNumLevels() << " levels loaded from cache" << std::endl;
+		return true;
+	}
+
+	// Read the encoded file into the reused byte buffer.
+	std::ifstream imageFile(texFilePath, std::ios::binary | std::ios::ate);
+	if (!imageFile.is_open()) {
+		std::cerr << "[ERROR] Failed to load image texture: " << texFilePath << std::endl;
+		return false;
+	}
+	const std::streamsize fileSize = imageFile.tellg();
+	imageFile.seekg(0, std::ios::beg);
+	std::vector<unsigned char>& fileBytes = decodeScratch.fileBytes;
+	fileBytes.resize((size_t)fileSize);
+	if (fileSize <= 0 || !imageFile.read((char*)fileBytes.data(), fileSize)) {
+		std::cerr << "[ERROR] Failed to load image texture: " << texFilePath << std::endl;
+		return false;
+	}
+
+	// Try to decode texture image straight into level 0 of the chain. cv::imdecode only
+	// reallocates the target when the size or type changes.
+	if (chain.levels.empty())
+		chain.levels.resize(1);
+	cv::Mat& image = chain.levels[0];
+	const unsigned char* previousData = image.data;
+	cv::imdecode(fileBytes, cv::IMREAD_COLOR, &image);
+	if (image.rows == 0 || image.cols == 0) {
+		std::cerr << "[ERROR] Failed to load image texture: " << texFilePath << std::endl;
+		return false;
+	}
+	if (image.data != previousData)
+		++ingestStats.decodeAllocations;
+	const size_t imageBytes = image.total() * image.elemSize();
+	ingestStats.fileBytes += (size_t)fileSize;
+	ingestStats.decodedBytes += imageBytes;
+
+	// No vertical flip: the shaders use v' = 1 - v instead, which saves a full pass
+	// over the image (and the temporary a flip into a new Mat would need). The flip
+	// figure is an estimate of that pass, not a measurement.
+	std::cout << "[INGEST] " << texFilePath << ": " << fileSize / 1024 << " KB read, "
+			  << imageBytes / 1024 << " KB decoded, " << (ingestStats.copiedBytes - copiedBefore) / 1024
+			  << " KB copied (cv::flip would copy an estimated " << imageBytes / 1024 << " KB)" << std::endl;
+
+	// Build every level on the CPU and persist them for the next load.
+	const double elapsedMs = MipGenerator::Generate(image, mipFilter, chain);
+	const double megaPixels = (double)chain.levels[0].cols * (double)chain.levels[0].rows / 1.0e6;
+	std::cout << "[MIP] " << texFilePath << ": " << chain.GetNumLevels() << " levels ("
+			  << MipGenerator::GetFilterName(mipFilter) << ") in " << elapsedMs << " ms, "
+			  << megaPixels / std::max(elapsedMs / 1000.0, 1e-9) << " MP/s" << std::endl;
+	TextureCache::Save(texFilePath, mipFilter, chain);
+	return true;
+}
+
+void ImageTexture::Upload(const MipChain& chain)
+{
+	TRACE_ZONE("Upload texture");
+	// Odd-sized levels of RGB images are not 4-byte aligned.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int level = 0; level < chain.GetNumLevels(); ++level) {
+		const cv::Mat& image = chain.levels[level];
+		switch (numChannels) {
+		case 1:
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RED, image.cols, image.rows,
+							0, GL_RED, GL_UNSIGNED_BYTE, image.ptr());
+			break;
+		case 3:
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, image.cols, image.rows,
+							0, GL_BGR, GL_UNSIGNED_BYTE, image.ptr());
+			break;
+		case 4:
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, image.cols, image.rows,
+							0, GL_BGRA, GL_UNSIGNED_BYTE, image.ptr());
+			break;
+		default:
+			std::cerr << "[ERROR] Unsupport texture format" << std::endl;
+			break;
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
@@ -1,29 +1,71 @@
-#ifndef IMAGE_TEXTURE_H
-#define IMAGE_TEXTURE_H
-
-#include "headers.h"
-
-// Texture Declarations.
-class ImageTexture
-{
-public:
-	// Texture Public Methods.
-	ImageTexture(const std::string filePath);
-	~ImageTexture();
-
-	void Bind(GLenum textureUnit);
-	void Preview();
-	std::string GetPath() const { return texFilePath; }
-
-private:
-	// Texture Private Data.
-	std::string texFilePath;
-	GLuint textureObj;
-	int imageWidth;
-	int imageHeight;
-	int numChannels;
-	cv::Mat texImage;
-};
-
-#endif
-
+#ifndef IMAGE_TEXTURE_H
+#define IMAGE_TEXTURE_H
+
+#include "headers.h"
+#include "mipgenerator.h"
+
+// Texture Declarations.
+// Images are uploaded in OpenCV row order (top row first), so texel row 0 is the top
+// of the image. Shaders flip v instead of the CPU flipping every image.
+class ImageTexture
+{
+public:
+	// Texture Public Methods.
+	ImageTexture(const std::string filePath, const MipFilter filter = MipFilter::Kaiser);
+	~ImageTexture();
+
+	void Bind(GLenum textureUnit);
+	void Preview();
+	std::string GetPath() const { return texFilePath; }
+	bool IsValid() const { return numMipLevels > 0; }
+	int GetWidth() const { return imageWidth; }
+	int GetHeight() const { return imageHeight; }
+	int GetNumChannels() const { return numChannels; }
+	int GetNumMipLevels() const { return numMipLevels; }
+
+	// No CPU copy is kept after upload; read a level back from the GPU when pixels are needed.
+	// Restores the texture first if it was evicted.
+	bool ReadImage(cv::Mat& image, const int level = 0);
+
+	// Residency, driven by TextureResidency. Levels below residentBaseLevel have no storage.
+	size_t GetResidentBytes() const;
+	bool IsFullyResident() const { return textureObj != 0 && residentBaseLevel == 0; }
+	bool CanDropTopLevel() const;
+	void DropTopLevel();
+	void Evict();
+	bool Restore();
+
+	// Bytes touched on the CPU while loading images (all textures so far).
+	struct IngestStats
+	{
+		size_t fileBytes;		// Encoded bytes read from disk.
+		size_t decodedBytes;	// Pixels written by the decoder or read from the mip cache.
+		size_t copiedBytes;		// Passes over decoded pixels: read-backs, atlas and array builds.
+		int decodeAllocations;	// Times the shared decode target had to grow.
+	};
+	// Count a CPU copy, conversion or resample of pixels that were already decoded.
+	static void AddCopiedBytes(const size_t bytes) { ingestStats.copiedBytes += bytes; }
+	static void ShowIngestInfo();
+
+private:
+	// Texture Private Methods.
+	bool Load();
+	bool LoadMipChain(MipChain& chain);
+	void Upload(const MipChain& chain);
+
+	// Texture Private Data.
+	std::string texFilePath;
+	MipFilter mipFilter;
+	GLuint textureObj;
+	int imageWidth;
+	int imageHeight;
+	int numChannels;
+	int numMipLevels;
+	int residentBaseLevel;
+
+	// Levels are never dropped below this size, so a reduced texture still draws sensibly.
+	static const int minResidentSize = 64;
+	static IngestStats ingestStats;
+};
+
+#endif
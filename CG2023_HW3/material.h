@@ -1,80 +1,95 @@
-#ifndef MATERIAL_H
-#define MATERIAL_H
-
-#include "headers.h"
-#include "shaderprog.h"
-#include "imagetexture.h"
-
-// Material Declarations.
-class Material
-{
-public:
-	// Material Public Methods.
-	Material() { name = "Default"; };
-	~Material() {};
-
-	void SetName(const std::string mtlName) { name = mtlName; }
-	std::string GetName() const { return name; }
-
-protected:	
-	// Material Protected Data.
-	std::string name;
-};
-
-// ------------------------------------------------------------------------------------------------
-
-// PhongMaterial Declarations.
-class PhongMaterial : public Material
-{
-public:
-	// PhongMaterial Public Methods.
-	PhongMaterial() {
-		Ka = glm::vec3(0.0f, 0.0f, 0.0f);
-		Kd = glm::vec3(0.0f, 0.0f, 0.0f);
-		Ks = glm::vec3(0.0f, 0.0f, 0.0f);
-		Ns = 0.0f;
-		mapKd = nullptr;
-	};
-	~PhongMaterial() {};
-
-	void SetKa(const glm::vec3 ka) { Ka = ka; }
-	void SetKd(const glm::vec3 kd) { Kd = kd; }
-	void SetKs(const glm::vec3 ks) { Ks = ks; }
-	void SetNs(const float n) { Ns = n; }
-	void SetMapKd(ImageTexture* tex) { mapKd = tex; }
-
-	const glm::vec3 GetKa() const { return Ka; }
-	const glm::vec3 GetKd() const { return Kd; }
-	const glm::vec3 GetKs() const { return Ks; }
-	const float GetNs() const { return Ns; }
-	ImageTexture* GetMapKd() const { return mapKd; }
-
-private:
-	// PhongMaterial Private Data.
-	glm::vec3 Ka;
-	glm::vec3 Kd;
-	glm::vec3 Ks;
-	float Ns;
-	ImageTexture* mapKd;
-};
-
-// ------------------------------------------------------------------------------------------------
-
-// SkyboxMaterial Declarations.
-class SkyboxMaterial : public Material
-{
-public:
-	// SkyboxMaterial Public Methods.
-	SkyboxMaterial() {
-		mapKd = nullptr;
-	};
-	~SkyboxMaterial() {};
-	void SetMapKd(ImageTexture* tex) { mapKd = tex; }
-	ImageTexture* GetMapKd() const { return mapKd; }
-
-private:
-	// SkyboxMaterial Private Data.
-	ImageTexture* mapKd;
-};
-
-#endif
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include "headers.h"
+#include "shaderprog.h"
+#include "imagetexture.h"
+#include "texturearray.h"
+#include "cubemaptexture.h"
+
+// Material Declarations.
+class Material
+{
+public:
+	// Material Public Methods.
+	Material() { name = "Default"; };
+	~Material() {};
+
+	void SetName(const std::string mtlName) { name = mtlName; }
+	std::string GetName() const { return name; }
+
+protected:	
+	// Material Protected Data.
+	std::string name;
+};
+
+// ------------------------------------------------------------------------------------------------
+
+// PhongMaterial Declarations.
+class PhongMaterial : public Material
+{
+public:
+	// PhongMaterial Public Methods.
+	PhongMaterial() {
+		Ka = glm::vec3(0.0f, 0.0f, 0.0f);
+		Kd = glm::vec3(0.0f, 0.0f, 0.0f);
+		Ks = glm::vec3(0.0f, 0.0f, 0.0f);
+		Ns = 0.0f;
+		mapKd = nullptr;
+		uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+		mapKdArray = nullptr;
+		mapKdLayer = 0;
+	};
+	~PhongMaterial() {};
+
+	void SetKa(const glm::vec3 ka) { Ka = ka; }
+	void SetKd(const glm::vec3 kd) { Kd = kd; }
+	void SetKs(const glm::vec3 ks) { Ks = ks; }
+	void SetNs(const float n) { Ns = n; }
+	void SetMapKd(ImageTexture* tex) { mapKd = tex; }
+	void SetUVTransform(const glm::vec4 t) { uvTransform = t; }
+	void SetMapKdLayer(TextureArray* array, const int layer) { mapKdArray = array; mapKdLayer = layer; }
+
+	const glm::vec3 GetKa() const { return Ka; }
+	const glm::vec3 GetKd() const { return Kd; }
+	const glm::vec3 GetKs() const { return Ks; }
+	const float GetNs() const { return Ns; }
+	ImageTexture* GetMapKd() const { return mapKd; }
+	// Maps mapKd's [0, 1] range into its texture atlas region (xy: scale, zw: offset).
+	const glm::vec4 GetUVTransform() const { return uvTransform; }
+	// The texture array (and its layer) holding a copy of mapKd, if any.
+	TextureArray* GetMapKdArray() const { return mapKdArray; }
+	int GetMapKdLayer() const { return mapKdLayer; }
+
+private:
+	// PhongMaterial Private Data.
+	glm::vec3 Ka;
+	glm::vec3 Kd;
+	glm::vec3 Ks;
+	float Ns;
+	ImageTexture* mapKd;
+	glm::vec4 uvTransform;
+	TextureArray* mapKdArray;
+	int mapKdLayer;
+};
+
+// ------------------------------------------------------------------------------------------------
+
+// SkyboxMaterial Declarations.
+class SkyboxMaterial : public Material
+{
+public:
+	// SkyboxMaterial Public Methods.
+	SkyboxMaterial() {
+		mapKd = nullptr;
+	};
+	~SkyboxMaterial() {};
+	void SetMapKd(CubeMapTexture* tex) { mapKd = tex; }
+	CubeMapTexture* GetMapKd() const { return mapKd; }
+
+private:
+	// SkyboxMaterial Private Data.
+	CubeMapTexture* mapKd;
+};
+
+#endif
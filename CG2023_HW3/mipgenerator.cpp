@@ -0,0 +1,264 @@
+#include "mipgenerator.h"
+#include "parallel.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <emmintrin.h>
+
+// Destination rows handled by one worker task.
+static const int kRowsPerTile = 32;
+
+// Kaiser filter: 8 taps in source texels, centered between texel 2x and 2x+1.
+static const int kKaiserTaps = 8;
+static const int kKaiserHalfTaps = kKaiserTaps / 2;
+static const float kKaiserAlpha = 4.0f;
+
+// Zeroth order modified Bessel function of the first kind (series expansion).
+static double BesselI0(const double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	const double halfX = 0.5 * x;
+	for (int k = 1; k < 32; ++k) {
+		term *= (halfX / k) * (halfX / k);
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+// Normalized weights for the 8 source texels around the center of a destination texel.
+struct KaiserWeights
+{
+	KaiserWeights() {
+		const double pi = glm::pi<double>();
+		const double radius = (double)kKaiserHalfTaps;
+		double sum = 0.0;
+		double w[kKaiserTaps];
+		for (int k = 0; k < kKaiserTaps; ++k) {
+			// Distance from the destination texel center, in source texels.
+			const double d = (double)(k - kKaiserHalfTaps) + 0.5;
+			// Windowed sinc with cutoff at half the source sampling rate.
+			const double t = 0.5 * d;
+			const double sinc = std::sin(pi * t) / (pi * t);
+			const double u = d / radius;
+			const double window = BesselI0(kKaiserAlpha * std::sqrt(std::max(0.0, 1.0 - u * u))) / BesselI0(kKaiserAlpha);
+			w[k] = sinc * window;
+			sum += w[k];
+		}
+		for (int k = 0; k < kKaiserTaps; ++k)
+			values[k] = (float)(w[k] / sum);
+	}
+	float values[kKaiserTaps];
+};
+
+static const float* GetKaiserWeights()
+{
+	// Function-local static: initialized once, safe to reach from several loader threads.
+	static const KaiserWeights weights;
+	return weights.values;
+}
+
+// Convert 16 floats to bytes with rounding and saturation.
+static inline void StoreFloatsAsBytes(const __m128 v0, const __m128 v1, const __m128 v2, const __m128 v3, uint8_t* out)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128i i0 = _mm_cvttps_epi32(_mm_add_ps(v0, half));
+	const __m128i i1 = _mm_cvttps_epi32(_mm_add_ps(v1, half));
+	const __m128i i2 = _mm_cvttps_epi32(_mm_add_ps(v2, half));
+	const __m128i i3 = _mm_cvttps_epi32(_mm_add_ps(v3, half));
+	const __m128i s01 = _mm_packs_epi32(i0, i1);
+	const __m128i s23 = _mm_packs_epi32(i2, i3);
+	_mm_storeu_si128((__m128i*)out, _mm_packus_epi16(s01, s23));
+}
+
+static inline uint8_t FloatToByte(const float v)
+{
+	const float r = v + 0.5f;
+	if (r <= 0.0f)
+		return 0;
+	if (r >= 255.0f)
+		return 255;
+	return (uint8_t)r;
+}
+
+double MipGenerator::Generate(const cv::Mat& image, const MipFilter filter, MipChain& chain, const int maxLevels)
+{
+	TRACE_ZONE("Generate mips");
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (image.empty()) {
+		chain.levels.clear();
+		return 0.0;
+	}
+
+	// The image may be level 0 of the chain itself: keep a header to it before resizing.
+	// Existing levels are reused by create() when their size matches.
+	const cv::Mat source = image.isContinuous() ? image : image.clone();
+	int numLevels = GetNumLevels(source.cols, source.rows);
+	if (maxLevels > 0)
+		numLevels = std::min(numLevels, maxLevels);
+	chain.levels.resize(numLevels);
+	chain.levels[0] = source;
+	for (int level = 1; level < numLevels; ++level) {
+		// Each level depends on the previous one; the work inside a level is split into row tiles.
+		if (filter == MipFilter::Kaiser)
+			DownsampleKaiser(chain.levels[level - 1], chain.levels[level]);
+		else
+			DownsampleBox(chain.levels[level - 1], chain.levels[level]);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void MipGenerator::Benchmark(const cv::Mat& image, const int numRuns)
+{
+	if (image.empty())
+		return;
+	const double megaPixels = (double)image.cols * (double)image.rows / 1.0e6;
+	std::cout << "------------------------------" << std::endl;
+	std::cout << "Mip generation benchmark: " << image.cols << " x " << image.rows
+			  << " x " << image.channels() << ", " << GetNumWorkerThreads() << " threads" << std::endl;
+	const MipFilter filters[] = { MipFilter::Box, MipFilter::Kaiser };
+	for (const MipFilter filter : filters) {
+		MipChain chain;
+		double bestMs = std::numeric_limits<double>::max();
+		for (int run = 0; run < numRuns; ++run)
+			bestMs = std::min(bestMs, Generate(image, filter, chain));
+		std::cout << std::setw(8) << GetFilterName(filter) << ": " << chain.GetNumLevels() << " levels in "
+				  << std::fixed << std::setprecision(2) << bestMs << " ms ("
+				  << megaPixels / (bestMs / 1000.0) << " MP/s)" << std::endl;
+		std::cout.unsetf(std::ios_base::floatfield);
+	}
+	std::cout << "------------------------------" << std::endl;
+}
+
+const char* MipGenerator::GetFilterName(const MipFilter filter)
+{
+	switch (filter) {
+	case MipFilter::Box:
+		return "Box";
+	case MipFilter::Kaiser:
+		return "Kaiser";
+	}
+	return "Unknown";
+}
+
+int MipGenerator::GetNumLevels(const int width, const int height)
+{
+	int numLevels = 1;
+	int size = std::max(width, height);
+	while (size > 1) {
+		size /= 2;
+		++numLevels;
+	}
+	return numLevels;
+}
+
+void MipGenerator::DownsampleBox(const cv::Mat& src, cv::Mat& dst)
+{
+	const int ch = src.channels();
+	const int sw = src.cols;
+	const int sh = src.rows;
+	const int dw = std::max(1, sw / 2);
+	const int dh = std::max(1, sh / 2);
+	dst.create(dh, dw, src.type());
+
+	const int rowBytes = sw * ch;
+	ParallelFor(0, dh, kRowsPerTile, [&](const int y0, const int y1) {
+		std::vector<uint16_t> sum(rowBytes);
+		const __m128i zero = _mm_setzero_si128();
+		for (int y = y0; y < y1; ++y) {
+			const uint8_t* r0 = src.ptr<uint8_t>(std::min(2 * y, sh - 1));
+			const uint8_t* r1 = src.ptr<uint8_t>(std::min(2 * y + 1, sh - 1));
+			// Vertical pair sums, 16 bytes at a time.
+			int i = 0;
+			for (; i + 16 <= rowBytes; i += 16) {
+				const __m128i a = _mm_loadu_si128((const __m128i*)(r0 + i));
+				const __m128i b = _mm_loadu_si128((const __m128i*)(r1 + i));
+				const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+				_mm_storeu_si128((__m128i*)(&sum[i]), lo);
+				_mm_storeu_si128((__m128i*)(&sum[i + 8]), hi);
+			}
+			for (; i < rowBytes; ++i)
+				sum[i] = (uint16_t)(r0[i] + r1[i]);
+			// Horizontal pair sums.
+			uint8_t* out = dst.ptr<uint8_t>(y);
+			for (int x = 0; x < dw; ++x) {
+				const int x0 = std::min(2 * x, sw - 1) * ch;
+				const int x1 = std::min(2 * x + 1, sw - 1) * ch;
+				for (int c = 0; c < ch; ++c)
+					out[x * ch + c] = (uint8_t)((sum[x0 + c] + sum[x1 + c] + 2) >> 2);
+			}
+		}
+	});
+}
+
+void MipGenerator::DownsampleKaiser(const cv::Mat& src, cv::Mat& dst)
+{
+	const int ch = src.channels();
+	const int sw = src.cols;
+	const int sh = src.rows;
+	const int dw = std::max(1, sw / 2);
+	const int dh = std::max(1, sh / 2);
+	dst.create(dh, dw, src.type());
+
+	const float* weights = GetKaiserWeights();
+	const int rowFloats = dw * ch;
+	ParallelFor(0, dh, kRowsPerTile, [&](const int y0, const int y1) {
+		// Horizontally filtered source rows needed by this tile.
+		const int firstRow = 2 * y0 - (kKaiserHalfTaps - 1);
+		const int numRows = 2 * (y1 - y0) + kKaiserTaps - 2;
+		std::vector<float> rows((size_t)numRows * rowFloats);
+		for (int r = 0; r < numRows; ++r) {
+			const int sy = std::min(std::max(firstRow + r, 0), sh - 1);
+			const uint8_t* in = src.ptr<uint8_t>(sy);
+			float* out = &rows[(size_t)r * rowFloats];
+			for (int x = 0; x < dw; ++x) {
+				float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				const int sx0 = 2 * x - (kKaiserHalfTaps - 1);
+				for (int k = 0; k < kKaiserTaps; ++k) {
+					const int sx = std::min(std::max(sx0 + k, 0), sw - 1);
+					for (int c = 0; c < ch; ++c)
+						acc[c] += weights[k] * (float)in[sx * ch + c];
+				}
+				for (int c = 0; c < ch; ++c)
+					out[x * ch + c] = acc[c];
+			}
+		}
+
+		// Vertical pass over the filtered rows, 16 floats at a time.
+		__m128 w[kKaiserTaps];
+		for (int k = 0; k < kKaiserTaps; ++k)
+			w[k] = _mm_set1_ps(weights[k]);
+		for (int y = y0; y < y1; ++y) {
+			const float* base = &rows[(size_t)(2 * (y - y0)) * rowFloats];
+			uint8_t* out = dst.ptr<uint8_t>(y);
+			int i = 0;
+			for (; i + 16 <= rowFloats; i += 16) {
+				__m128 acc0 = _mm_setzero_ps();
+				__m128 acc1 = _mm_setzero_ps();
+				__m128 acc2 = _mm_setzero_ps();
+				__m128 acc3 = _mm_setzero_ps();
+				for (int k = 0; k < kKaiserTaps; ++k) {
+					const float* row = base + (size_t)k * rowFloats + i;
+					acc0 = _mm_add_ps(acc0, _mm_mul_ps(w[k], _mm_loadu_ps(row)));
+					acc1 = _mm_add_ps(acc1, _mm_mul_ps(w[k], _mm_loadu_ps(row + 4)));
+					acc2 = _mm_add_ps(acc2, _mm_mul_ps(w[k], _mm_loadu_ps(row + 8)));
+					acc3 = _mm_add_ps(acc3, _mm_mul_ps(w[k], _mm_loadu_ps(row + 12)));
+				}
+				StoreFloatsAsBytes(acc0, acc1, acc2, acc3, out + i);
+			}
+			for (; i < rowFloats; ++i) {
+				float acc = 0.0f;
+				for (int k = 0; k < kKaiserTaps; ++k)
+					acc += weights[k] * base[(size_t)k * rowFloats + i];
+				out[i] = FloatToByte(acc);
+			}
+		}
+	});
+}
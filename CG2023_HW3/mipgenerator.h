@@ -0,0 +1,50 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include "headers.h"
+
+// Downsampling filter used to build each mip level from the previous one.
+enum class MipFilter
+{
+	Box = 0,	// 2x2 average.
+	Kaiser = 1	// 8-tap Kaiser-windowed sinc, separable.
+};
+
+// MipChain Declarations.
+// Level 0 is the full resolution image; every level is 8-bit with the same channel count.
+struct MipChain
+{
+	std::vector<cv::Mat> levels;
+
+	int GetNumLevels() const { return (int)levels.size(); }
+	size_t GetSizeInBytes() const {
+		size_t bytes = 0;
+		for (const auto& level : levels)
+			bytes += level.total() * level.elemSize();
+		return bytes;
+	}
+};
+
+// MipGenerator Declarations.
+class MipGenerator
+{
+public:
+	// MipGenerator Public Methods.
+	// Build the chain (down to 1x1, or maxLevels levels if non-zero) from an 8-bit image
+	// with 1, 3 or 4 channels. The image may be chain.levels[0]; the other levels' buffers
+	// are reused when their sizes match. Returns the elapsed time in milliseconds.
+	static double Generate(const cv::Mat& image, const MipFilter filter, MipChain& chain, const int maxLevels = 0);
+
+	// Run both filters on the image and print the throughput in megapixels per second.
+	static void Benchmark(const cv::Mat& image, const int numRuns = 5);
+
+	static const char* GetFilterName(const MipFilter filter);
+	static int GetNumLevels(const int width, const int height);
+
+private:
+	// MipGenerator Private Methods.
+	static void DownsampleBox(const cv::Mat& src, cv::Mat& dst);
+	static void DownsampleKaiser(const cv::Mat& src, cv::Mat& dst);
+};
+
+#endif
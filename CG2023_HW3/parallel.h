@@ -0,0 +1,55 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "cputracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Number of worker threads used by the CPU-side texture tools.
+inline int GetNumWorkerThreads()
+{
+	const unsigned int n = std::thread::hardware_concurrency();
+	return (n == 0) ? 4 : (int)n;
+}
+
+// Split [begin, end) into chunks of "grain" items and run func(chunkBegin, chunkEnd)
+// on a pool of threads. The calling thread takes part in the work.
+// Small ranges (a single chunk) run inline without spawning any thread.
+template <typename Func>
+void ParallelFor(const int begin, const int end, const int grain, Func func)
+{
+	const int count = end - begin;
+	if (count <= 0)
+		return;
+	const int chunkSize = std::max(1, grain);
+	const int numChunks = (count + chunkSize - 1) / chunkSize;
+	const int numThreads = std::min(numChunks, GetNumWorkerThreads());
+	if (numThreads <= 1) {
+		func(begin, end);
+		return;
+	}
+
+	std::atomic<int> nextChunk(0);
+	auto worker = [&]() {
+		for (int c = nextChunk++; c < numChunks; c = nextChunk++) {
+			TRACE_ZONE("Parallel chunk");
+			const int b = begin + c * chunkSize;
+			func(b, std::min(end, b + chunkSize));
+		}
+	};
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads - 1);
+	for (int t = 0; t < numThreads - 1; ++t)
+		threads.emplace_back([&]() {
+			TRACE_THREAD_NAME("Parallel worker");
+			worker();
+		});
+	worker();
+	for (auto& t : threads)
+		t.join();
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include "renderqueue.h"
+
+#include <chrono>
+
+const int RenderQueue::kMaxTextureUnits;
+
+RenderQueue::RenderQueue()
+{
+	numDraws = 0;
+	numStateChanges = 0;
+	numTextureBinds = 0;
+	numSkipped = 0;
+	sortMs = 0.0;
+	profiler = nullptr;
+	Begin();
+}
+
+void RenderQueue::Begin()
+{
+	packets.clear();
+	boundProgram = nullptr;
+	for (int unit = 0; unit < kMaxTextureUnits; ++unit)
+		boundTextures[unit] = nullptr;
+	boundVao = 0;
+	boundIbo = 0;
+	iboKnown = false;
+	boundPointSize = 1.0f;
+	numStateChanges = 0;
+	numTextureBinds = 0;
+	numSkipped = 0;
+}
+
+void RenderQueue::SetProgram(ShaderProg* program)
+{
+	if (program == boundProgram) {
+		++numSkipped;
+		return;
+	}
+	program->Bind();
+	boundProgram = program;
+	++numStateChanges;
+}
+
+uint64_t RenderQueue::MakeKey(const ShaderProg* program, const uint16_t textureKey, const int material, const float depth)
+{
+	const uint64_t programKey = (program != nullptr) ? (program->GetProgramId() & 0xFF) : 0;
+	const uint64_t depthKey = (uint64_t)(glm::clamp(depth, 0.0f, 1.0f) * (float)0xFFFFFF);
+	return (programKey << 56) | ((uint64_t)textureKey << 40) | ((uint64_t)(material & 0xFFFF) << 24) | depthKey;
+}
+
+void RenderQueue::Sort()
+{
+	const size_t n = packets.size();
+	entries.resize(n);
+	scratch.resize(n);
+	for (size_t i = 0; i < n; ++i) {
+		entries[i].key = packets[i].key;
+		entries[i].packet = (uint32_t)i;
+	}
+
+	// Least significant digit first, 8 bits at a time. All histograms are counted in one
+	// pass; a digit that is the same in every key (e.g. the program in a one-program
+	// frame) is skipped.
+	size_t counts[8][256] = {};
+	for (size_t i = 0; i < n; ++i) {
+		for (int digit = 0; digit < 8; ++digit)
+			++counts[digit][(entries[i].key >> (digit * 8)) & 0xFF];
+	}
+	for (int digit = 0; digit < 8; ++digit) {
+		size_t* count = counts[digit];
+		if (count[(entries[0].key >> (digit * 8)) & 0xFF] == n)
+			continue;
+		size_t offset = 0;
+		for (int bucket = 0; bucket < 256; ++bucket) {
+			const size_t c = count[bucket];
+			count[bucket] = offset;
+			offset += c;
+		}
+		for (size_t i = 0; i < n; ++i)
+			scratch[count[(entries[i].key >> (digit * 8)) & 0xFF]++] = entries[i];
+		entries.swap(scratch);
+	}
+}
+
+void RenderQueue::Execute()
+{
+	TRACE_ZONE("Execute render queue");
+	numDraws = 0;
+	if (packets.empty()) {
+		sortMs = 0.0;
+		return;
+	}
+	const auto sortStart = std::chrono::high_resolution_clock::now();
+	Sort();
+	const auto sortEnd = std::chrono::high_resolution_clock::now();
+	sortMs = std::chrono::duration<double, std::milli>(sortEnd - sortStart).count();
+
+	const char* passName = nullptr;
+	for (const SortEntry& entry : entries) {
+		const RenderPacket& packet = packets[entry.packet];
+		if (profiler != nullptr && packet.passName != passName) {
+			if (passName != nullptr)
+				profiler->EndScope();
+			if (packet.passName != nullptr)
+				profiler->BeginScope(packet.passName);
+			passName = packet.passName;
+		}
+		if (packet.program != boundProgram) {
+			packet.program->Bind();
+			boundProgram = packet.program;
+			++numStateChanges;
+		}
+		else
+			++numSkipped;
+		if (packet.texture != nullptr) {
+			void*& bound = boundTextures[packet.textureUnit - GL_TEXTURE0];
+			if (packet.texture != bound) {
+				packet.bindTexture(packet.texture, packet.textureUnit);
+				bound = packet.texture;
+				++numStateChanges;
+				++numTextureBinds;
+			}
+			else
+				++numSkipped;
+		}
+		// The index buffer binding belongs to the vertex array object.
+		if (packet.vaoId != boundVao) {
+			glBindVertexArray(packet.vaoId);
+			boundVao = packet.vaoId;
+			iboKnown = false;
+			++numStateChanges;
+		}
+		else
+			++numSkipped;
+		if (packet.iboId != 0) {
+			if (!iboKnown || packet.iboId != boundIbo) {
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, packet.iboId);
+				boundIbo = packet.iboId;
+				iboKnown = true;
+				++numStateChanges;
+			}
+			else
+				++numSkipped;
+		}
+		if (packet.pointSize != boundPointSize) {
+			glPointSize(packet.pointSize);
+			boundPointSize = packet.pointSize;
+			++numStateChanges;
+		}
+		if (packet.setUniforms != nullptr)
+			packet.setUniforms(packet);
+
+		if (packet.iboId != 0 && packet.numInstances > 1)
+			glDrawElementsInstanced(packet.primitive, packet.numElements, GL_UNSIGNED_INT,
+									(const void*)(sizeof(GLuint) * packet.firstIndex), packet.numInstances);
+		else if (packet.iboId != 0)
+			glDrawElements(packet.primitive, packet.numElements, GL_UNSIGNED_INT,
+						   (const void*)(sizeof(GLuint) * packet.firstIndex));
+		else
+			glDrawArrays(packet.primitive, 0, packet.numElements);
+		++numDraws;
+	}
+	if (profiler != nullptr && passName != nullptr)
+		profiler->EndScope();
+
+	glBindVertexArray(0);
+	if (boundProgram != nullptr)
+		boundProgram->UnBind();
+	if (boundPointSize != 1.0f)
+		glPointSize(1.0f);
+	boundVao = 0;
+	boundProgram = nullptr;
+	boundPointSize = 1.0f;
+}
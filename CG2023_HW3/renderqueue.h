@@ -0,0 +1,132 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "headers.h"
+#include "shaderprog.h"
+#include "gpuprofiler.h"
+
+#include <cstdint>
+
+// RenderPacket Declarations.
+// One draw: the state it needs, the uniforms it sets and the key that orders it.
+struct RenderPacket
+{
+	RenderPacket() {
+		key = 0;
+		program = nullptr;
+		texture = nullptr;
+		bindTexture = nullptr;
+		textureUnit = GL_TEXTURE0;
+		vaoId = 0;
+		iboId = 0;
+		firstIndex = 0;
+		primitive = GL_TRIANGLES;
+		numElements = 0;
+		numInstances = 1;
+		pointSize = 1.0f;
+		setUniforms = nullptr;
+		userData = nullptr;
+		userIndex = 0;
+		objectIndex = 0;
+		passName = nullptr;
+	}
+	// Textures are bound through their own Bind() so that residency keeps track of them.
+	template<typename Texture>
+	void SetTexture(Texture* tex, const GLenum unit) {
+		texture = tex;
+		bindTexture = [](void* t, GLenum u) { static_cast<Texture*>(t)->Bind(u); };
+		textureUnit = unit;
+	}
+
+	uint64_t key;
+	ShaderProg* program;
+	void* texture;						// Nothing is bound if null.
+	void (*bindTexture)(void* texture, GLenum textureUnit);
+	GLenum textureUnit;
+	GLuint vaoId;
+	GLuint iboId;						// 0 draws arrays.
+	GLuint firstIndex;					// Start of the range of the index buffer to draw.
+	GLenum primitive;
+	GLsizei numElements;
+	GLsizei numInstances;				// More than 1 draws the elements instanced.
+	GLfloat pointSize;
+	// Per-draw uniforms, set once the packet's program is bound.
+	void (*setUniforms)(const RenderPacket& packet);
+	const void* userData;
+	int userIndex;
+	int objectIndex;					// Scene object the draw belongs to.
+	// GPU profiler scope of the draw (see RenderQueue::SetProfiler()); a string literal.
+	const char* passName;
+};
+
+// RenderQueue Declarations.
+// Collects the draws of a frame, sorts them by a 64-bit key (program, texture, material, then
+// front to back depth) with a radix sort and issues them, skipping every program, texture,
+// vertex array, index buffer and point size change that would not change the bound state.
+// The bound state is shadowed between Begin() and the end of Execute() only: code that binds
+// things in between (other than through SetProgram) must not rely on it.
+class RenderQueue
+{
+public:
+	// RenderQueue Public Methods.
+	RenderQueue();
+
+	// Start a frame: forget the packets and the shadowed state.
+	void Begin();
+	// Bind a program outside of a packet, e.g. to set per-pass uniforms.
+	void SetProgram(ShaderProg* program);
+	// Key bits: program (8) | texture (16) | material (16) | depth (24), depth in [0, 1].
+	// The texture key is a small ordinal (0 for none), e.g. TriangleMesh::GetTextureKey().
+	static uint64_t MakeKey(const ShaderProg* program, const uint16_t textureKey, const int material, const float depth);
+	void Submit(const RenderPacket& packet) { packets.push_back(packet); }
+	// Sort and draw the packets, then unbind the vertex array and the program.
+	void Execute();
+	// Time the draws of each pass name as a GPU profiler scope. Draws are sorted by program
+	// first, so a pass with its own program is one scope per frame.
+	void SetProfiler(GpuProfiler* gpuProfiler) { profiler = gpuProfiler; }
+
+	// Statistics of the last Execute().
+	int GetNumDraws() const { return numDraws; }
+	int GetNumStateChanges() const { return numStateChanges; }
+	int GetNumTextureBinds() const { return numTextureBinds; }
+	int GetNumSkipped() const { return numSkipped; }
+	double GetSortTime() const { return sortMs; }
+
+	static const int kMaxTextureUnits = 8;
+
+private:
+	// RenderQueue Private Types.
+	struct SortEntry
+	{
+		uint64_t key;
+		uint32_t packet;
+	};
+
+	// RenderQueue Private Methods.
+	void Sort();
+
+	// RenderQueue Private Data.
+	// Kept between frames so that a steady frame does not allocate.
+	std::vector<RenderPacket> packets;
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> scratch;
+
+	// Shadowed state.
+	ShaderProg* boundProgram;
+	void* boundTextures[kMaxTextureUnits];
+	GLuint boundVao;
+	GLuint boundIbo;
+	bool iboKnown;
+	GLfloat boundPointSize;
+
+	GpuProfiler* profiler;
+
+	// Statistics.
+	int numDraws;
+	int numStateChanges;
+	int numTextureBinds;
+	int numSkipped;
+	double sortMs;
+};
+
+#endif
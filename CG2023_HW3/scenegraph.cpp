@@ -0,0 +1,230 @@
+#include "scenegraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <random>
+
+const int SceneGraph::kNoParent;
+
+SceneGraph::SceneGraph()
+{
+	needsSort = false;
+	numUpdated = 0;
+}
+
+void SceneGraph::Reserve(const int numNodes)
+{
+	localMatrices.reserve(numNodes);
+	worldMatrices.reserve(numNodes);
+	normalMatrices.reserve(numNodes);
+	parents.reserve(numNodes);
+	subtreeSizes.reserve(numNodes);
+	nodes.reserve(numNodes);
+	dirty.reserve(numNodes);
+	positions.reserve(numNodes);
+}
+
+void SceneGraph::Clear()
+{
+	localMatrices.clear();
+	worldMatrices.clear();
+	normalMatrices.clear();
+	parents.clear();
+	subtreeSizes.clear();
+	nodes.clear();
+	dirty.clear();
+	positions.clear();
+	dirtyPositions.clear();
+	needsSort = false;
+	numUpdated = 0;
+}
+
+int SceneGraph::AddNode(const int parent, const glm::mat4x4& localMatrix)
+{
+	const int node = GetNumNodes();
+	if (parent >= node) {
+		std::cerr << "[ERROR] Scene graph node " << node << " added below a missing node " << parent << std::endl;
+		return kNoParent;
+	}
+	// Appended for now; the next Update() moves it into its parent's range.
+	localMatrices.push_back(localMatrix);
+	worldMatrices.push_back(localMatrix);
+	normalMatrices.push_back(glm::mat4x4(1.0f));
+	parents.push_back((parent != kNoParent) ? positions[parent] : kNoParent);
+	subtreeSizes.push_back(1);
+	nodes.push_back(node);
+	dirty.push_back(0);
+	positions.push_back(node);
+	needsSort = true;
+	return node;
+}
+
+void SceneGraph::SetLocalMatrix(const int node, const glm::mat4x4& localMatrix)
+{
+	const int position = positions[node];
+	if (localMatrices[position] == localMatrix)
+		return;
+	localMatrices[position] = localMatrix;
+	if (!dirty[position]) {
+		dirty[position] = 1;
+		dirtyPositions.push_back(position);
+	}
+}
+
+void SceneGraph::Update()
+{
+	TRACE_ZONE("Update scene graph");
+	numUpdated = 0;
+	for (const int position : dirtyPositions)
+		dirty[position] = 0;
+	if (needsSort) {
+		SortDepthFirst();
+		// Every root's subtree, one after the other.
+		for (int position = 0; position < GetNumNodes(); position += subtreeSizes[position])
+			UpdateSubtree(position);
+	}
+	else {
+		// An ancestor comes first and its range covers the dirty nodes below it.
+		std::sort(dirtyPositions.begin(), dirtyPositions.end());
+		int updatedEnd = 0;
+		for (const int position : dirtyPositions) {
+			if (position < updatedEnd)
+				continue;
+			UpdateSubtree(position);
+			updatedEnd = position + subtreeSizes[position];
+		}
+	}
+	dirtyPositions.clear();
+}
+
+void SceneGraph::UpdateSubtree(const int position)
+{
+	// The parent of the first node lies before the range and is up to date.
+	const int end = position + subtreeSizes[position];
+	for (int i = position; i < end; ++i) {
+		const int parent = parents[i];
+		worldMatrices[i] = (parent != kNoParent) ? worldMatrices[parent] * localMatrices[i] : localMatrices[i];
+		normalMatrices[i] = glm::transpose(glm::inverse(worldMatrices[i]));
+	}
+	numUpdated += end - position;
+}
+
+void SceneGraph::SortDepthFirst()
+{
+	const int numNodes = GetNumNodes();
+	// Parent node of every node, and the children of every node in the order they were added.
+	std::vector<int> nodeParents(numNodes);
+	for (int position = 0; position < numNodes; ++position)
+		nodeParents[nodes[position]] = (parents[position] != kNoParent) ? nodes[parents[position]] : kNoParent;
+	std::vector<int> firstChild(numNodes + 1, 0);
+	for (int node = 0; node < numNodes; ++node) {
+		if (nodeParents[node] != kNoParent)
+			++firstChild[nodeParents[node] + 1];
+	}
+	for (int node = 0; node < numNodes; ++node)
+		firstChild[node + 1] += firstChild[node];
+	std::vector<int> children(firstChild[numNodes]);
+	std::vector<int> nextChild(firstChild.begin(), firstChild.end() - 1);
+	for (int node = 0; node < numNodes; ++node) {
+		if (nodeParents[node] != kNoParent)
+			children[nextChild[nodeParents[node]]++] = node;
+	}
+
+	// Preorder, roots and children in the order they were added.
+	std::vector<int> order;
+	order.reserve(numNodes);
+	std::vector<int> stack;
+	for (int node = numNodes - 1; node >= 0; --node) {
+		if (nodeParents[node] == kNoParent)
+			stack.push_back(node);
+	}
+	while (!stack.empty()) {
+		const int node = stack.back();
+		stack.pop_back();
+		order.push_back(node);
+		for (int child = firstChild[node + 1] - 1; child >= firstChild[node]; --child)
+			stack.push_back(children[child]);
+	}
+
+	std::vector<glm::mat4x4> sortedLocal(numNodes);
+	for (int position = 0; position < numNodes; ++position)
+		sortedLocal[position] = localMatrices[positions[order[position]]];
+	localMatrices.swap(sortedLocal);
+	for (int position = 0; position < numNodes; ++position)
+		positions[order[position]] = position;
+	for (int position = 0; position < numNodes; ++position) {
+		const int parent = nodeParents[order[position]];
+		parents[position] = (parent != kNoParent) ? positions[parent] : kNoParent;
+	}
+	nodes.swap(order);
+	// A child comes after its parent, so sizes add up in one backward pass.
+	std::fill(subtreeSizes.begin(), subtreeSizes.end(), 1);
+	for (int position = numNodes - 1; position > 0; --position) {
+		if (parents[position] != kNoParent)
+			subtreeSizes[parents[position]] += subtreeSizes[position];
+	}
+	needsSort = false;
+}
+
+void SceneGraph::Benchmark(const int numNodes)
+{
+	if (numNodes <= 0)
+		return;
+	// Each node below one of the nodes before it, eight children per node on average.
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+	SceneGraph graph;
+	graph.Reserve(numNodes);
+	graph.AddNode(kNoParent);
+	for (int i = 1; i < numNodes; ++i) {
+		const glm::vec3 t(offset(rng), offset(rng), offset(rng));
+		graph.AddNode((i - 1) / 8, glm::translate(glm::mat4x4(1.0f), t));
+	}
+	const auto sortStart = std::chrono::high_resolution_clock::now();
+	graph.Update();
+	const auto sortEnd = std::chrono::high_resolution_clock::now();
+	const double sortMs = std::chrono::duration<double, std::milli>(sortEnd - sortStart).count();
+
+	std::uniform_int_distribution<int> pickNode(1, numNodes - 1);
+	const int numRuns = 10;
+	float angle = 0.0f;
+	// Best time of numRuns updates, each after change() marked what moves.
+	auto time = [&](auto change) {
+		double bestMs = std::numeric_limits<double>::max();
+		for (int run = 0; run < numRuns; ++run) {
+			change();
+			const auto start = std::chrono::high_resolution_clock::now();
+			graph.Update();
+			const auto end = std::chrono::high_resolution_clock::now();
+			bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(end - start).count());
+		}
+		return bestMs;
+	};
+	auto rotate = [&](const int node) {
+		angle += 1.0f;
+		graph.SetLocalMatrix(node, glm::rotate(graph.GetLocalMatrix(node), glm::radians(angle), glm::vec3(0, 1, 0)));
+	};
+
+	const double allMs = time([&]() { rotate(0); });
+	const int allUpdated = graph.GetNumUpdated();
+	const double noneMs = time([]() {});
+	const double subtreeMs = time([&]() { rotate(1); });
+	const int subtreeUpdated = graph.GetNumUpdated();
+	const double scatteredMs = time([&]() {
+		for (int i = 0; i < numNodes / 100; ++i)
+			rotate(pickNode(rng));
+	});
+	const int scatteredUpdated = graph.GetNumUpdated();
+
+	std::cout << "------------------------------" << std::endl;
+	std::cout << "Scene graph update benchmark: " << numNodes << " nodes" << std::endl;
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "First update:        " << sortMs << " ms (depth-first sort, every node)" << std::endl;
+	std::cout << "Root changed:        " << allMs << " ms (" << allUpdated << " nodes updated)" << std::endl;
+	std::cout << "Nothing changed:     " << noneMs << " ms" << std::endl;
+	std::cout << "One subtree changed: " << subtreeMs << " ms (" << subtreeUpdated << " nodes updated)" << std::endl;
+	std::cout << "1% nodes changed:    " << scatteredMs << " ms (" << scatteredUpdated << " nodes updated)" << std::endl;
+	std::cout.unsetf(std::ios_base::floatfield);
+	std::cout << "------------------------------" << std::endl;
+}
@@ -0,0 +1,72 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include "headers.h"
+
+#include <cstdint>
+
+// SceneGraph Declarations.
+// Transform hierarchy of the scene. Nodes live in flat arrays (one per field) in depth-first
+// order, so the subtree of a node is the contiguous range of subtreeSizes positions starting
+// at its own, and a parent always comes before its children. Node indices returned by
+// AddNode() stay valid; positions maps them into the arrays. Adding nodes only appends, and
+// the next Update() sorts the arrays depth first again and recomputes every node.
+// Setting a node's local matrix marks it dirty; Update() recomputes the world and normal
+// matrices of the range of each dirty subtree, and never visits the clean ranges between.
+class SceneGraph
+{
+public:
+	// SceneGraph Public Methods.
+	SceneGraph();
+
+	void Reserve(const int numNodes);
+	void Clear();
+	// Returns the new node's index; parent is kNoParent for a root.
+	int AddNode(const int parent, const glm::mat4x4& localMatrix = glm::mat4x4(1.0f));
+	// Does not mark the node dirty when the matrix is unchanged.
+	void SetLocalMatrix(const int node, const glm::mat4x4& localMatrix);
+	void Update();
+
+	int GetNumNodes() const { return (int)parents.size(); }
+	int GetParent(const int node) const {
+		const int parent = parents[positions[node]];
+		return (parent != kNoParent) ? nodes[parent] : kNoParent;
+	}
+	const glm::mat4x4& GetLocalMatrix(const int node) const { return localMatrices[positions[node]]; }
+	// As of the last Update().
+	const glm::mat4x4& GetWorldMatrix(const int node) const { return worldMatrices[positions[node]]; }
+	// Inverse transpose of the world matrix, for normals.
+	const glm::mat4x4& GetNormalMatrix(const int node) const { return normalMatrices[positions[node]]; }
+	// Nodes recomputed by the last Update().
+	int GetNumUpdated() const { return numUpdated; }
+
+	// Update times of a generated graph of numNodes nodes: the first update (depth-first sort
+	// and every node), then with the root (every node), nothing, one subtree and 1% of the
+	// nodes changed.
+	static void Benchmark(const int numNodes = 100000);
+
+	static const int kNoParent = -1;
+
+private:
+	// SceneGraph Private Methods.
+	void SortDepthFirst();
+	void UpdateSubtree(const int position);
+
+	// SceneGraph Private Data.
+	// Indexed by position.
+	std::vector<glm::mat4x4> localMatrices;
+	std::vector<glm::mat4x4> worldMatrices;
+	std::vector<glm::mat4x4> normalMatrices;
+	std::vector<int> parents;		// Position of the parent, kNoParent for a root.
+	std::vector<int> subtreeSizes;	// Including the node itself.
+	std::vector<int> nodes;			// Node index at each position.
+	std::vector<uint8_t> dirty;		// Set while the position is in dirtyPositions.
+	// Indexed by node.
+	std::vector<int> positions;
+
+	std::vector<int> dirtyPositions;
+	bool needsSort;					// Nodes were added since the last depth-first sort.
+	int numUpdated;
+};
+
+#endif
@@ -1,140 +1,205 @@
-#ifndef SHADER_PROGRAM_H
-#define SHADER_PROGRAM_H
-
-#include "headers.h"
-
-// ShaderProg Declarations.
-class ShaderProg
-{
-public:
-	// ShaderProg Public Methods.
-	ShaderProg();
-	~ShaderProg();
-
-	bool LoadFromFiles(const std::string vsFilePath, const std::string fsFilePath);
-	void Bind() { glUseProgram(shaderProgId); };
-	void UnBind() { glUseProgram(0); };
-
-	GLint GetLocMVP() const { return locMVP; }
-
-protected:
-	// ShaderProg Protected Methods.
-	virtual void GetUniformVariableLocation();
-
-	// ShaderProg Protected Data.
-	GLuint shaderProgId;
-
-private:
-	// ShaderProg Private Methods.
-	GLuint AddShader(const std::string& sourceText, GLenum shaderType);
-	static bool LoadShaderTextFromFile(const std::string filePath, std::string& sourceText);
-
-	// ShaderProg Private Data.
-	GLint locMVP;
-};
-
-// ------------------------------------------------------------------------------------------------
-
-// FillColorShaderProg Declarations.
-class FillColorShaderProg : public ShaderProg
-{
-public:
-	// FillColorShaderProg Public Methods.
-	FillColorShaderProg();
-	~FillColorShaderProg();
-
-	GLint GetLocFillColor() const { return locFillColor; }
-
-protected:
-	// FillColorShaderProg Protected Methods.
-	void GetUniformVariableLocation();
-
-private:
-	// FillColorShaderProg Private Data.
-	GLint locFillColor;
-};
-
-// ------------------------------------------------------------------------------------------------
-
-// PhongShadingDemoShaderProg Declarations.
-class PhongShadingDemoShaderProg : public ShaderProg
-{
-public:
-	// PhongShadingDemoShaderProg Public Methods.
-	PhongShadingDemoShaderProg();
-	~PhongShadingDemoShaderProg();
-
-	GLint GetLocM() const { return locM; }
-	GLint GetLocNM() const { return locNM; }
-	GLint GetLocCameraPos() const { return locCameraPos; }
-	GLint GetLocKa() const { return locKa; }
-	GLint GetLocKd() const { return locKd; }
-	GLint GetLocKs() const { return locKs; }
-	GLint GetLocNs() const { return locNs; }
-	GLint GetLocAmbientLight() const { return locAmbientLight; }
-	GLint GetLocDirLightDir() const { return locDirLightDir; }
-	GLint GetLocDirLightRadiance() const { return locDirLightRadiance; }
-	GLint GetLocPointLightPos() const { return locPointLightPos; }
-	GLint GetLocPointLightIntensity() const { return locPointLightIntensity; }
-	GLint GetLocSpotLightPos() const { return locSpotLightPos; }
-	GLint GetLocSpotLightDir() const { return locSpotLightDir; }
-	GLint GetLocSpotLightIntensity() const { return locSpotLightIntensity; }
-	GLint GetLocSpotLightTotalWidth() const { return locSpotLightTotalWidth; }
-	GLint GetLocSpotLightCutoffStart() const { return locSpotLightCutoffStart; }
-	GLint GetLocMapKd() const { return locMapKd; }
-	GLint GetLocExist() const { return locExist; }
-
-protected:
-	// PhongShadingDemoShaderProg Protected Methods.
-	void GetUniformVariableLocation();
-
-private:
-	// PhongShadingDemoShaderProg Public Data.
-	// Transformation matrix.
-	GLint locM;
-	GLint locNM;
-	GLint locCameraPos;
-	// Material properties.
-	GLint locKa;
-	GLint locKd;
-	GLint locKs;
-	GLint locNs;
-	// Light data.
-	GLint locAmbientLight;
-	GLint locDirLightDir;
-	GLint locDirLightRadiance;
-	GLint locPointLightPos;
-	GLint locPointLightIntensity;
-	// SpotLight
-	GLint locSpotLightPos;
-	GLint locSpotLightDir;
-	GLint locSpotLightIntensity;
-	GLint locSpotLightTotalWidth;
-	GLint locSpotLightCutoffStart;
-	// Texture data.
-	GLint locMapKd;
-	GLint locExist;
-};
-
-// ------------------------------------------------------------------------------------------------
-
-// SkyboxShaderProg Declarations.
-class SkyboxShaderProg : public ShaderProg
-{
-public:
-	// SkyboxShaderProg Public Methods.
-	SkyboxShaderProg();
-	~SkyboxShaderProg();
-
-	GLint GetLocMapKd() const { return locMapKd; }
-
-protected:
-	// PhongShadingDemoShaderProg Protected Methods.
-	void GetUniformVariableLocation();
-
-private:
-	// SkyboxShaderProg Public Data.
-	GLint locMapKd;
-};
-
-#endif
+#ifndef SHADER_PROGRAM_H
+#define SHADER_PROGRAM_H
+
+#include "headers.h"
+
+// FrameData Declarations.
+// CPU copy of the std140 FrameData uniform block: what stays constant over a frame, written
+// once per frame and read by the model and skybox shaders. Only vec4 and mat4 members, so the
+// C++ layout is the std140 one.
+struct FrameData
+{
+	glm::mat4x4 viewMatrix;
+	glm::mat4x4 projMatrix;
+	glm::mat4x4 skyboxRotation;
+	glm::vec4 cameraPos;
+	glm::vec4 ambientLight;
+	glm::vec4 dirLightDir;
+	glm::vec4 dirLightRadiance;
+	glm::vec4 pointLightPos;
+	glm::vec4 pointLightIntensity;
+	glm::vec4 spotLightPos;			// w: total width.
+	glm::vec4 spotLightDir;			// w: cutoff start.
+	glm::vec4 spotLightIntensity;
+};
+static_assert(sizeof(FrameData) == 3 * 64 + 9 * 16, "FrameData must match the std140 block");
+
+// MaterialData Declarations.
+// One entry of the std140 Materials uniform block: the parameters of a PhongMaterial, packed
+// once at load time so that a draw only passes the index of its material.
+struct MaterialData
+{
+	glm::vec4 Ka;				// w: Ns.
+	glm::vec4 Kd;				// w: 1 if the material has a diffuse map.
+	glm::vec4 Ks;				// w: roughness, picks the level of the prefiltered skybox.
+	glm::vec4 uvTransform;		// Atlas region of the diffuse map.
+	glm::vec4 mapKdLayer;		// x: layer in the material's texture array, -1 if none.
+};
+static_assert(sizeof(MaterialData) == 5 * 16, "MaterialData must match the std140 struct");
+
+// ShaderProg Declarations.
+class ShaderProg
+{
+public:
+	// ShaderProg Public Methods.
+	ShaderProg();
+	~ShaderProg();
+
+	bool LoadFromFiles(const std::string vsFilePath, const std::string fsFilePath);
+	void Bind() { glUseProgram(shaderProgId); };
+	void UnBind() { glUseProgram(0); };
+
+	GLint GetLocMVP() const { return locMVP; }
+	GLuint GetProgramId() const { return shaderProgId; }
+
+	// Uniform buffer binding point of the FrameData block, the same in every program.
+	static const GLuint frameDataBinding = 1;
+
+protected:
+	// ShaderProg Protected Methods.
+	virtual void GetUniformVariableLocation();
+
+	// ShaderProg Protected Data.
+	GLuint shaderProgId;
+
+private:
+	// ShaderProg Private Methods.
+	GLuint AddShader(const std::string& sourceText, GLenum shaderType);
+	static bool LoadShaderTextFromFile(const std::string filePath, std::string& sourceText);
+
+	// ShaderProg Private Data.
+	GLint locMVP;
+};
+
+// ------------------------------------------------------------------------------------------------
+
+// FillColorShaderProg Declarations.
+class FillColorShaderProg : public ShaderProg
+{
+public:
+	// FillColorShaderProg Public Methods.
+	FillColorShaderProg();
+	~FillColorShaderProg();
+
+	GLint GetLocFillColor() const { return locFillColor; }
+
+protected:
+	// FillColorShaderProg Protected Methods.
+	void GetUniformVariableLocation();
+
+private:
+	// FillColorShaderProg Private Data.
+	GLint locFillColor;
+};
+
+// ------------------------------------------------------------------------------------------------
+
+// PhongShadingDemoShaderProg Declarations.
+class PhongShadingDemoShaderProg : public ShaderProg
+{
+public:
+	// PhongShadingDemoShaderProg Public Methods.
+	PhongShadingDemoShaderProg();
+	~PhongShadingDemoShaderProg();
+
+	GLint GetLocM() const { return locM; }
+	GLint GetLocNM() const { return locNM; }
+	GLint GetLocKa() const { return locKa; }
+	GLint GetLocKd() const { return locKd; }
+	GLint GetLocKs() const { return locKs; }
+	GLint GetLocNs() const { return locNs; }
+	GLint GetLocMapKd() const { return locMapKd; }
+	GLint GetLocExist() const { return locExist; }
+	GLint GetLocUseAtlas() const { return locUseAtlas; }
+	GLint GetLocUVTransform() const { return locUVTransform; }
+	GLint GetLocMapKdArray() const { return locMapKdArray; }
+	GLint GetLocMapKdLayer() const { return locMapKdLayer; }
+	GLint GetLocUseTexArray() const { return locUseTexArray; }
+	GLint GetLocUseSHAmbient() const { return locUseSHAmbient; }
+	GLint GetLocEnvMap() const { return locEnvMap; }
+	GLint GetLocEnvLod() const { return locEnvLod; }
+	GLint GetLocUseEnvSpecular() const { return locUseEnvSpecular; }
+	GLint GetLocEnvMaxLod() const { return locEnvMaxLod; }
+	GLint GetLocMaterialIndex() const { return locMaterialIndex; }
+	GLint GetLocUseMaterialBuffer() const { return locUseMaterialBuffer; }
+	GLint GetLocUseInstancing() const { return locUseInstancing; }
+
+	// Uniform buffer binding point of the SHLighting block.
+	static const GLuint shLightingBinding = 0;
+	// Binding point of the Materials block and the number of materials it holds (the array
+	// size in the shader; 15 KB, under the 16 KB every GL 3.3 implementation allows).
+	static const GLuint materialsBinding = 2;
+	static const int maxMaterialsPerBlock = 192;
+
+protected:
+	// PhongShadingDemoShaderProg Protected Methods.
+	void GetUniformVariableLocation();
+
+private:
+	// PhongShadingDemoShaderProg Public Data.
+	// Transformation matrix.
+	GLint locM;
+	GLint locNM;
+	// Material properties.
+	GLint locKa;
+	GLint locKd;
+	GLint locKs;
+	GLint locNs;
+	// Camera and light data are in the FrameData block.
+	// Texture data.
+	GLint locMapKd;
+	GLint locExist;
+	GLint locUseAtlas;
+	GLint locUVTransform;
+	GLint locMapKdArray;
+	GLint locMapKdLayer;
+	GLint locUseTexArray;
+	// Ambient lighting.
+	GLint locUseSHAmbient;
+	GLuint shLightingBlockIndex;
+	// Environment reflections.
+	GLint locEnvMap;
+	GLint locEnvLod;
+	GLint locUseEnvSpecular;
+	GLint locEnvMaxLod;
+	// Material buffer.
+	GLint locMaterialIndex;
+	GLint locUseMaterialBuffer;
+	GLuint materialsBlockIndex;
+	// Instancing.
+	GLint locUseInstancing;
+};
+
+// ------------------------------------------------------------------------------------------------
+
+// SkyboxShaderProg Declarations.
+class SkyboxShaderProg : public ShaderProg
+{
+public:
+	// SkyboxShaderProg Public Methods.
+	SkyboxShaderProg();
+	~SkyboxShaderProg();
+
+	GLint GetLocMapKd() const { return locMapKd; }
+	GLint GetLocPageAtlas() const { return locPageAtlas; }
+	GLint GetLocPageTable() const { return locPageTable; }
+	GLint GetLocVirtualSize() const { return locVirtualSize; }
+	GLint GetLocNumLevels() const { return locNumLevels; }
+	GLint GetLocPageTableRows() const { return locPageTableRows; }
+
+protected:
+	// PhongShadingDemoShaderProg Protected Methods.
+	void GetUniformVariableLocation();
+
+private:
+	// SkyboxShaderProg Public Data.
+	GLint locMapKd;
+	// Streamed panorama.
+	GLint locPageAtlas;
+	GLint locPageTable;
+	GLint locVirtualSize;
+	GLint locNumLevels;
+	GLint locPageTableRows;
+};
+
+#endif
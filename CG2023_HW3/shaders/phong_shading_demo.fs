@@ -8,7 +8,22 @@ in vec2 iTexCoord;
 // --------------------------------------------------------
 
 // --------------------------------------------------------
-uniform vec3 cameraPos;
+// Frame-constant data, written once per frame (std140, shared with the other programs).
+layout (std140) uniform FrameData
+{
+    mat4 viewMatrix;
+    mat4 projMatrix;
+    mat4 skyboxRotation;
+    vec4 cameraPos;
+    vec4 ambientLight;
+    vec4 dirLightDir;
+    vec4 dirLightRadiance;
+    vec4 pointLightPos;
+    vec4 pointLightIntensity;
+    vec4 spotLightPos;          // w: total width.
+    vec4 spotLightDir;          // w: cutoff start.
+    vec4 spotLightIntensity;
+};
 
 // Material properties.
 uniform vec3 Ka;
@@ -17,18 +32,44 @@ uniform vec3 Ks;
 uniform float Ns;
 uniform sampler2D mapKd;
 uniform int isExist;
+uniform int useAtlas;
+uniform vec4 uvTransform;
+uniform sampler2DArray mapKdArray;
+uniform float mapKdLayer;
+uniform int useTexArray;
+
+// The same parameters packed per material at load time; a draw then only sets materialIndex.
+// Used instead of the uniforms above when useMaterialBuffer is 1.
+struct MaterialData
+{
+    vec4 Ka;                    // w: Ns.
+    vec4 Kd;                    // w: 1 if the material has a diffuse map.
+    vec4 Ks;                    // w: roughness, times envMaxLod gives the reflection level.
+    vec4 uvTransform;
+    vec4 mapKdLayer;            // x: layer in the texture array, -1 if none.
+};
+layout (std140) uniform Materials
+{
+    MaterialData materials[192];
+};
+uniform int materialIndex;
+uniform int useMaterialBuffer;
+
+// Ambient light from the skybox: SH9 irradiance with the basis constants folded in.
+layout (std140) uniform SHLighting
+{
+    vec4 shCoeffs[9];
+    mat4 normalToSkybox;     // From the space of iNormalWorld to skybox space.
+    mat4 worldToSkybox;      // From world space to skybox space.
+    vec4 envScale;           // Scale of the irradiance, applied to the reflections as well.
+};
+uniform int useSHAmbient;
 
-// Light data.
-uniform vec3 ambientLight;
-uniform vec3 dirLightDir;
-uniform vec3 dirLightRadiance;
-uniform vec3 pointLightPos;
-uniform vec3 pointLightIntensity;
-uniform vec3 spotLightPos;
-uniform vec3 spotLightDir;
-uniform vec3 spotLightIntensity;
-uniform float spotLightTotalWidth;
-uniform float spotLightCutoffStart;
+// Glossy reflections: the prefiltered skybox, level chosen by Ns.
+uniform samplerCube envMap;
+uniform float envLod;
+uniform float envMaxLod;
+uniform int useEnvSpecular;
 // --------------------------------------------------------
 
 out vec4 FragColor;
@@ -49,52 +90,106 @@ vec3 Specular(vec3 Ks, float Ns, vec3 I, vec3 N, vec3 viewDir, vec3 lightDir)
     return Ks * I * pow(max(0, dot(N, vH)), Ns);
 }
 
+vec3 SHIrradiance(vec3 N)
+{
+    vec3 n = mat3(normalToSkybox) * N;
+    return shCoeffs[0].rgb
+         + shCoeffs[1].rgb * n.y
+         + shCoeffs[2].rgb * n.z
+         + shCoeffs[3].rgb * n.x
+         + shCoeffs[4].rgb * (n.x * n.y)
+         + shCoeffs[5].rgb * (n.y * n.z)
+         + shCoeffs[6].rgb * (3.0 * n.z * n.z - 1.0)
+         + shCoeffs[7].rgb * (n.x * n.z)
+         + shCoeffs[8].rgb * (n.x * n.x - n.y * n.y);
+}
+
 
 void main()
 {
+    // -------------------------------------------------------------
+    // Material.
+    vec3 matKa = Ka;
+    vec3 matKd = Kd;
+    vec3 matKs = Ks;
+    float matNs = Ns;
+    bool hasMapKd = (isExist == 1);
+    vec4 matUVTransform = uvTransform;
+    float matLayer = mapKdLayer;
+    float matEnvLod = envLod;
+    if (useMaterialBuffer == 1) {
+        MaterialData m = materials[materialIndex];
+        matKa = m.Ka.rgb;
+        matNs = m.Ka.w;
+        matKd = m.Kd.rgb;
+        hasMapKd = (m.Kd.w > 0.5);
+        matKs = m.Ks.rgb;
+        matEnvLod = m.Ks.w * envMaxLod;
+        matUVTransform = m.uvTransform;
+        matLayer = m.mapKdLayer.x;
+    }
     // -------------------------------------------------------------
     vec3 nNormal = normalize(iNormalWorld);
-    vec3 viewDir = normalize(cameraPos - iPosWorld);
+    vec3 viewDir = normalize(cameraPos.xyz - iPosWorld);
     vec3 texColor;
-    if(isExist == 0)
-        texColor = Kd;
-    else 
+    if(!hasMapKd)
+        texColor = matKd;
+    else if(useTexArray == 1 && matLayer >= 0.0)
+        texColor = texture(mapKdArray, vec3(iTexCoord, matLayer)).rgb;
+    else if(useAtlas == 0)
         texColor = texture2D(mapKd, iTexCoord).rgb;
+    else {
+        // Repeat inside the atlas region. Gradients come from the unwrapped coordinates,
+        // otherwise the wrap seam would select the coarsest mip level.
+        vec2 atlasCoord = matUVTransform.zw + fract(iTexCoord) * matUVTransform.xy;
+        texColor = textureGrad(mapKd, atlasCoord, dFdx(iTexCoord) * matUVTransform.xy, dFdy(iTexCoord) * matUVTransform.xy).rgb;
+    }
     // -------------------------------------------------------------
     // Ambient light.
-    vec3 ambient = Ka * ambientLight;
+    vec3 ambient;
+    if (useSHAmbient == 1)
+        ambient = matKa * max(SHIrradiance(nNormal), vec3(0.0));
+    else
+        ambient = matKa * ambientLight.rgb;
+    // Reflection of the skybox.
+    if (useEnvSpecular == 1) {
+        vec3 R = reflect(-mat3(worldToSkybox) * viewDir, mat3(normalToSkybox) * nNormal);
+        ambient += matKs * envScale.rgb * textureLod(envMap, R, matEnvLod).rgb;
+    }
     // -------------------------------------------------------------
     // Directional light.
-    vec3 wsLightDir = normalize(-dirLightDir);
+    vec3 wsLightDir = normalize(-dirLightDir.xyz);
     // Diffuse.
-    vec3 diffuse = Diffuse(texColor, dirLightRadiance, nNormal, wsLightDir);
+    vec3 diffuse = Diffuse(texColor, dirLightRadiance.rgb, nNormal, wsLightDir);
     // Specular.
-    vec3 specular = Specular(Ks, Ns, dirLightRadiance, nNormal, viewDir, wsLightDir);
+    vec3 specular = Specular(matKs, matNs, dirLightRadiance.rgb, nNormal, viewDir, wsLightDir);
     vec3 dirLight = diffuse + specular;
     // -------------------------------------------------------------
     // Point light.
-    vec3 wPointLightDir = normalize(pointLightPos - iPosWorld);
-    float distSurfaceToLight = distance(pointLightPos, iPosWorld);
+    vec3 wPointLightDir = normalize(pointLightPos.xyz - iPosWorld);
+    float distSurfaceToLight = distance(pointLightPos.xyz, iPosWorld);
     float attenuation = 1.0f / (distSurfaceToLight * distSurfaceToLight);
-    vec3 radiance = pointLightIntensity * attenuation;
+    vec3 radiance = pointLightIntensity.rgb * attenuation;
     // Diffuse.
     diffuse = Diffuse(texColor, radiance, nNormal, wPointLightDir);
     // Specular.
-    specular = Specular(Ks, Ns, radiance, nNormal, viewDir, wPointLightDir);
+    specular = Specular(matKs, matNs, radiance, nNormal, viewDir, wPointLightDir);
     vec3 pointLight = diffuse + specular;
     // -------------------------------------------------------------
     // Spot Light
-    vec3 wSpotLightPos = normalize(spotLightPos - iPosWorld);
-    vec3 wSpotLightDir = normalize(spotLightDir);
-    distSurfaceToLight = distance(spotLightPos, iPosWorld);
+    vec3 wSpotLightPos = normalize(spotLightPos.xyz - iPosWorld);
+    vec3 wSpotLightDir = normalize(spotLightDir.xyz);
+    distSurfaceToLight = distance(spotLightPos.xyz, iPosWorld);
+    float spotLightTotalWidth = spotLightPos.w;
+    float spotLightCutoffStart = spotLightDir.w;
     float A = degrees(acos(dot(wSpotLightPos, -wSpotLightDir)));
     float spotLightAttenuation = clamp((A - spotLightTotalWidth) / (spotLightCutoffStart - spotLightTotalWidth), 0, 1);
     attenuation = spotLightAttenuation / (distSurfaceToLight * distSurfaceToLight);
-    radiance = spotLightIntensity * attenuation;
+    radiance = spotLightIntensity.rgb * attenuation;
     // Diffuse.
     diffuse = Diffuse(texColor, radiance, nNormal, wSpotLightPos);
     // Specular.
-    specular = Specular(Ks, Ns, radiance, nNormal, viewDir, wSpotLightPos);
+    specular = Specular(matKs, matNs, radiance, nNormal, viewDir, wSpotLightPos);
     vec3 spotLight = diffuse + specular;
     // -------------------------------------------------------------
     vec3 LightingColor = ambient + dirLight + pointLight + spotLight;
@@ -3,6 +3,9 @@
 layout (location = 0) in vec3 Position;
 layout (location = 1) in vec3 Normal;
 layout (location = 2) in vec2 TexCoord;
+// Per-instance world and normal (inverse transpose of world) matrices of an instanced draw.
+layout (location = 3) in mat4 instanceWorld;
+layout (location = 7) in mat4 instanceNormal;
 
 
 // Transformation matrix.
@@ -10,6 +13,27 @@ layout (location = 2) in vec2 TexCoord;
 uniform mat4 worldMatrix;
 uniform mat4 normalMatrix;
 uniform mat4 MVP;
+// 1: the transform comes from the instance attributes instead.
+uniform int useInstancing;
+// --------------------------------------------------------
+
+// Frame-constant data (the same block as in the fragment shader).
+// --------------------------------------------------------
+layout (std140) uniform FrameData
+{
+    mat4 viewMatrix;
+    mat4 projMatrix;
+    mat4 skyboxRotation;
+    vec4 cameraPos;
+    vec4 ambientLight;
+    vec4 dirLightDir;
+    vec4 dirLightRadiance;
+    vec4 pointLightPos;
+    vec4 pointLightIntensity;
+    vec4 spotLightPos;          // w: total width.
+    vec4 spotLightDir;          // w: cutoff start.
+    vec4 spotLightIntensity;
+};
 // --------------------------------------------------------
 
 // Data pass to fragment shader.
@@ -22,12 +46,22 @@ out vec2 iTexCoord;
 void main()
 {
     // --------------------------------------------------------
-    gl_Position = MVP * vec4(Position, 1.0);
+    vec4 positionTmp;
+    if (useInstancing == 1) {
+        positionTmp = instanceWorld * vec4(Position, 1.0);
+        gl_Position = projMatrix * viewMatrix * positionTmp;
+        // normalMatrix includes the view; the view is rigid, so its rotation does the same here.
+        iNormalWorld = mat3(viewMatrix) * (mat3(instanceNormal) * Normal);
+    }
+    else {
+        positionTmp = worldMatrix * vec4(Position, 1.0);
+        gl_Position = MVP * vec4(Position, 1.0);
+        iNormalWorld = (normalMatrix * vec4(Normal, 0.0)).xyz;
+    }
 
     // Pass vertex attributes.
-    vec4 positionTmp = worldMatrix * vec4(Position, 1.0);
     iPosWorld = positionTmp.xyz / positionTmp.w;
-    iNormalWorld = (normalMatrix * vec4(Normal, 0.0)).xyz;
-    iTexCoord = TexCoord;
+    // Images are uploaded top row first, so flip v here instead of flipping every image.
+    iTexCoord = vec2(TexCoord.x, 1.0 - TexCoord.y);
     // --------------------------------------------------------
 }
\ No newline at end of file
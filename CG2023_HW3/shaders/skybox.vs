@@ -3,15 +3,30 @@
 layout (location = 0) in vec3 Position;
 layout (location = 1) in vec2 TexCoord;
 
-out vec2 iTexCoord;
+out vec3 iDirection;
 
-uniform mat4 MVP;
+// Frame-constant data, written once per frame (std140, shared with the other programs).
+layout (std140) uniform FrameData
+{
+    mat4 viewMatrix;
+    mat4 projMatrix;
+    mat4 skyboxRotation;
+    vec4 cameraPos;
+    vec4 ambientLight;
+    vec4 dirLightDir;
+    vec4 dirLightRadiance;
+    vec4 pointLightPos;
+    vec4 pointLightIntensity;
+    vec4 spotLightPos;          // w: total width.
+    vec4 spotLightDir;          // w: cutoff start.
+    vec4 spotLightIntensity;
+};
 
 
 void main()
 {
-    gl_Position = MVP * vec4(Position, 1.0);
+    gl_Position = projMatrix * viewMatrix * skyboxRotation * vec4(Position, 1.0);
     
-    // Pass 
-    iTexCoord = TexCoord;
+    // The sphere is centered at the origin, so its object space position is the view direction.
+    iDirection = Position;
 }
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 330 core
+
+in vec4 iRay;
+
+// Material properties.
+uniform samplerCube mapKd;
+
+out vec4 FragColor;
+
+
+void main()
+{
+    // The camera sits at the origin of the rotation-only view, so the far plane point is the view ray.
+    FragColor = texture(mapKd, iRay.xyz / iRay.w);
+}
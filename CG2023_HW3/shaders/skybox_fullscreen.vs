@@ -0,0 +1,38 @@
+#version 330 core
+
+// No vertex buffer: gl_VertexID 0, 1, 2 give (-1, -1), (3, -1), (-1, 3),
+// one triangle covering the whole screen.
+out vec4 iRay;
+
+// Frame-constant data, written once per frame (std140, shared with the other programs).
+layout (std140) uniform FrameData
+{
+    mat4 viewMatrix;
+    mat4 projMatrix;
+    mat4 skyboxRotation;
+    vec4 cameraPos;
+    vec4 ambientLight;
+    vec4 dirLightDir;
+    vec4 dirLightRadiance;
+    vec4 pointLightPos;
+    vec4 pointLightIntensity;
+    vec4 spotLightPos;          // w: total width.
+    vec4 spotLightDir;          // w: cutoff start.
+    vec4 spotLightIntensity;
+};
+
+
+void main()
+{
+    vec2 pos = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2)) * 2.0 - 1.0;
+    // z = w puts the triangle on the far plane (depth 1.0).
+    gl_Position = vec4(pos, 1.0, 1.0);
+    
+    // Rays come from the inverse of the rotation-only view-projection, so the skybox is at
+    // infinity and rotates like the sphere. Three vertices: the inverse is cheap here.
+    mat4 invViewProj = inverse(projMatrix * mat4(mat3(viewMatrix)) * skyboxRotation);
+    
+    // Homogeneous point on the far plane in skybox space. It is linear in screen space,
+    // so it can be interpolated and divided per fragment.
+    iRay = invViewProj * vec4(pos, 1.0, 1.0);
+}
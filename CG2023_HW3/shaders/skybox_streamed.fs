@@ -0,0 +1,46 @@
+#version 330 core
+
+in vec4 iRay;
+
+// Tiles of the panorama resident on the GPU: slots of TILE_SIZE texels plus a 1 texel border.
+uniform sampler2D pageAtlas;
+// One texel per tile of every level: slot x, slot y and the level actually resident
+// (the tile's own, or its nearest resident ancestor's).
+uniform sampler2D pageTable;
+uniform ivec2 virtualSize;
+uniform int numLevels;
+uniform int pageTableRows[16];
+
+out vec4 FragColor;
+
+const float PI = 3.14159265358979;
+const int TILE_SIZE = 128;
+const int SLOT_SIZE = TILE_SIZE + 2;
+
+
+void main()
+{
+    // Same mapping as the cube map conversion: u = phi / 2PI, v = theta / PI from +Y.
+    vec3 dir = normalize(iRay.xyz / iRay.w);
+    vec2 uv = vec2(fract(atan(dir.z, dir.x) / (2.0 * PI)), acos(clamp(dir.y, -1.0, 1.0)) / PI);
+
+    // Level from the texel footprint of a pixel; u is differentiated without its wrap seam.
+    // VirtualTexture::Update() requests tiles with the same rule.
+    vec2 size = vec2(virtualSize);
+    vec2 dx = vec2(min(abs(dFdx(uv.x)), abs(dFdx(fract(uv.x + 0.5)))), dFdx(uv.y)) * size;
+    vec2 dy = vec2(min(abs(dFdy(uv.x)), abs(dFdy(fract(uv.x + 0.5)))), dFdy(uv.y)) * size;
+    float lod = log2(max(max(length(dx), length(dy)), 1.0));
+    int level = min(int(lod), numLevels - 1);
+
+    // Page of the wanted tile, or of the ancestor standing in for it.
+    ivec2 levelSize = max(virtualSize >> level, ivec2(1));
+    ivec2 tile = min(ivec2(uv * vec2(levelSize)) / TILE_SIZE, max(levelSize / TILE_SIZE, ivec2(1)) - 1);
+    vec4 entry = texelFetch(pageTable, ivec2(tile.x, pageTableRows[level] + tile.y), 0) * 255.0;
+    int resident = int(entry.b + 0.5);
+
+    // Position inside that tile at the resident level, then inside its slot.
+    vec2 texel = uv * vec2(max(virtualSize >> resident, ivec2(1)));
+    vec2 inTile = texel - vec2(ivec2(texel) / TILE_SIZE * TILE_SIZE);
+    vec2 atlasPos = floor(entry.rg + 0.5) * float(SLOT_SIZE) + 1.0 + inTile;
+    FragColor = textureLod(pageAtlas, atlasPos / vec2(textureSize(pageAtlas, 0)), 0.0);
+}
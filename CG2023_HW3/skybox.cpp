@@ -1,126 +1,282 @@
-#include "skybox.h"
-
-Skybox::Skybox(const std::string& texImagePath, const int nSlices, const int nStacks, const float radius)
-{
-	rotationY = 0.0f;
-
-	// Load panorama.
-	panorama = new ImageTexture(texImagePath);
-	// panorama->Preview();
-
-	// Create material.
-	material = new SkyboxMaterial();
-	material->SetMapKd(panorama);
-
-	// Create sphere geometry.
-	CreateSphere3D(nSlices, nStacks, radius, vertices, indices);
-
-	// Create vertex buffer.
-	glGenBuffers(1, &vboId);
-    glBindBuffer(GL_ARRAY_BUFFER, vboId);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(VertexPT) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
-	// Create index buffer.
-	glGenBuffers(1, &iboId);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), &(indices[0]), GL_STATIC_DRAW);
-}
-
-Skybox::~Skybox()
-{
-	vertices.clear();
-	glDeleteBuffers(1, &vboId);
-	indices.clear();
-	glDeleteBuffers(1, &iboId);
-
-	if (panorama) {
-		delete panorama;
-		panorama = nullptr;
-	}
-	if (material) {
-		delete material;
-		material = nullptr;
-	}
-}
-
-void Skybox::Render(Camera* camera, SkyboxShaderProg* shader)
-{
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-
-	glBindBuffer(GL_ARRAY_BUFFER, vboId);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPT), 0);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), (const GLvoid*)12);
-
-	shader->Bind();
-	
-	// Set transform.
-	// -------------------------------------------------------
-	glm::mat4x4 Rx = glm::rotate(glm::mat4x4(1.0f), glm::radians(rotationX), glm::vec3(1, 0, 0));
-	glm::mat4x4 Ry = glm::rotate(glm::mat4x4(1.0f), glm::radians(rotationY), glm::vec3(0, 1, 0));
-	glm::mat4x4 MVP = camera->GetProjMatrix() * camera->GetViewMatrix() * Rx * Ry;
-	// -------------------------------------------------------
-	glUniformMatrix4fv(shader->GetLocMVP(), 1, GL_FALSE, glm::value_ptr(MVP));
-	// Set material properties.
-	if (material->GetMapKd() != nullptr) {
-		material->GetMapKd()->Bind(GL_TEXTURE0);
-        glUniform1i(shader->GetLocMapKd(), 0);
-	}
-
-	// Draw.
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
-	glDrawElements(GL_TRIANGLES, (GLsizei)(indices.size()), GL_UNSIGNED_INT, 0);
-
-	shader->UnBind();
-
-	glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-}
-
-void Skybox::CreateSphere3D(const int nSlices, const int nStacks, const float radius, 
-					std::vector<VertexPT>& vertices, std::vector<unsigned int>& indices)
-{
-	const int numPhi = nSlices;
-	const int numTheta = nStacks;
-	// Phi range: from 0 to 2PI.
-	// Theta range: from PI/2 to -PI/2.
-	const float phiStart = 0.0f;
-	const float thetaStart = 0.5f * glm::pi<float>();
-	const float phiOffset = 2.0f * glm::pi<float>() / (float)numPhi;
-	const float thetaOffset = -glm::pi<float>() / (float)numTheta;
-	for (int t = 0; t <= numTheta; ++t) {
-		for (int p = 0; p <= numPhi; ++p) {
-			float phi = phiStart + p * phiOffset;
-			float theta = thetaStart + t * thetaOffset;
-			// std::cout << glm::degrees<float>(phi) << " " << glm::degrees<float>(theta) << std::endl;
-			glm::vec2 uv = glm::vec2((float)p / (float)numPhi, (float)t / (float)numTheta);
-			// std::cout << uv.x << " " << uv.y << std::endl;
-			float x = radius * std::cosf(theta) * std::cosf(phi);
-			float y = radius * std::sinf(theta);
-			float z = radius * std::cosf(theta) * std::sinf(phi);
-			
-			VertexPT vt = VertexPT(glm::vec3(x, y, z), uv);
-			vertices.push_back(vt);
-		}
-	}
-
-	// Vertex order (4 x 2 division for example): 
-	//  0   1   2   3   4.
-	//  5   6   7   8   9.
-	// 10  11  12  13  14.
-	const int pVertices = nSlices + 1;
-	const int tVertices = nStacks + 1;
-	for (int t = 0; t < nStacks; ++t) {
-		for (int p = 0; p < nSlices; ++p) {
-			// Each grid will generate 2 triangles.
-			// The upper-half one.
-			indices.push_back(t * pVertices + p);
-			indices.push_back(t * pVertices + p + 1);
-			indices.push_back((t+1) * pVertices + p);
-			// The bottom-half one.
-			indices.push_back(t * pVertices + p + 1);
-			indices.push_back((t+1) * pVertices + p + 1);
-			indices.push_back((t+1) * pVertices + p);
-		}
-	}
-}
-
+#include "skybox.h"
+
+unsigned int Skybox::numEnvironments = 0;
+
+Skybox::Skybox(CubeMapTexture* cubeMap, const std::string& texImagePath, const int nSlices, const int nStacks,
+				const float radius, const SkyboxMode skyboxMode)
+{
+	mode = skyboxMode;
+	numSlices = nSlices;
+	numStacks = nStacks;
+	sphereRadius = radius;
+	vaoId = 0;
+	vboId = 0;
+	iboId = 0;
+	rotationX = 0.0f;
+	rotationY = 0.0f;
+	rotationMatrix = glm::mat4x4(1.0f);
+	gpuTimer = new GpuTimer();
+	virtualTexture = nullptr;
+
+	// Create material.
+	material = new SkyboxMaterial();
+	SetEnvironment(cubeMap, texImagePath);
+
+	// Only the sphere mode needs geometry, only the streamed mode a virtual texture.
+	SetMode(mode);
+}
+
+Skybox::~Skybox()
+{
+	ReleaseSphereBuffers();
+	delete gpuTimer;
+	delete virtualTexture;
+
+	if (material) {
+		delete material;
+		material = nullptr;
+	}
+}
+
+void Skybox::SetEnvironment(CubeMapTexture* cubeMap, const std::string& texImagePath)
+{
+	if (texImagePath != panoramaPath || (mode == SkyboxMode::Streamed && virtualTexture == nullptr)) {
+		delete virtualTexture;
+		virtualTexture = (mode == SkyboxMode::Streamed && !texImagePath.empty()) ? new VirtualTexture(texImagePath) : nullptr;
+	}
+	environment = cubeMap;
+	environmentId = ++numEnvironments;
+	panoramaPath = texImagePath;
+	material->SetMapKd(environment);
+}
+
+void Skybox::SetMode(const SkyboxMode newMode)
+{
+	mode = newMode;
+	if (mode == SkyboxMode::Sphere)
+		CreateSphereBuffers();
+	else
+		ReleaseSphereBuffers();
+	if (mode == SkyboxMode::Streamed && virtualTexture == nullptr && !panoramaPath.empty())
+		virtualTexture = new VirtualTexture(panoramaPath);
+	else if (mode != SkyboxMode::Streamed && virtualTexture != nullptr) {
+		delete virtualTexture;
+		virtualTexture = nullptr;
+	}
+}
+
+void Skybox::Render(Camera* camera, SkyboxShaderProg* shader)
+{
+	TRACE_ZONE("Skybox pass");
+	gpuTimer->Begin();
+	if (mode == SkyboxMode::Sphere)
+		RenderSphere(shader);
+	else if (mode == SkyboxMode::Streamed)
+		RenderStreamed(camera, shader);
+	else
+		RenderFullScreen(shader);
+	gpuTimer->End();
+}
+
+void Skybox::SetRotationX(const float newRotation)
+{
+	if (newRotation == rotationX)
+		return;
+	rotationX = newRotation;
+	UpdateRotationMatrix();
+}
+
+void Skybox::SetRotationY(const float newRotation)
+{
+	if (newRotation == rotationY)
+		return;
+	rotationY = newRotation;
+	UpdateRotationMatrix();
+}
+
+void Skybox::UpdateRotationMatrix()
+{
+	glm::mat4x4 Rx = glm::rotate(glm::mat4x4(1.0f), glm::radians(rotationX), glm::vec3(1, 0, 0));
+	glm::mat4x4 Ry = glm::rotate(glm::mat4x4(1.0f), glm::radians(rotationY), glm::vec3(0, 1, 0));
+	rotationMatrix = Rx * Ry;
+}
+
+void Skybox::RenderSphere(SkyboxShaderProg* shader)
+{
+	glBindVertexArray(vaoId);
+	shader->Bind();
+	
+	// The transform comes from the FrameData block (view, projection and skybox rotation).
+	// Set material properties.
+	if (material->GetMapKd() != nullptr) {
+		material->GetMapKd()->Bind(GL_TEXTURE0);
+        glUniform1i(shader->GetLocMapKd(), 0);
+	}
+
+	// Draw.
+	glDrawElements(GL_TRIANGLES, (GLsizei)(indices.size()), GL_UNSIGNED_INT, 0);
+
+	shader->UnBind();
+	glBindVertexArray(0);
+}
+
+glm::mat4x4 Skybox::GetInvViewProj(Camera* camera) const
+{
+	// The CPU side of the ray reconstruction in skybox_fullscreen.vs: the inverse of the
+	// rotation-only view-projection, with the sky rotations applied as for the sphere.
+	glm::mat4x4 viewRotation = glm::mat4x4(glm::mat3x3(camera->GetViewMatrix()));
+	return glm::inverse(camera->GetProjMatrix() * viewRotation * GetRotationMatrix());
+}
+
+void Skybox::RenderFullScreen(SkyboxShaderProg* shader)
+{
+	// The view rays are reconstructed from the FrameData block.
+	shader->Bind();
+	if (material->GetMapKd() != nullptr) {
+		material->GetMapKd()->Bind(GL_TEXTURE0);
+		glUniform1i(shader->GetLocMapKd(), 0);
+	}
+
+	// The triangle lies on the far plane: LEQUAL passes only where nothing was drawn, so
+	// pixels covered by the model are rejected before shading. Depth stays untouched.
+	glDepthFunc(GL_LEQUAL);
+	glDepthMask(GL_FALSE);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+
+	shader->UnBind();
+}
+
+void Skybox::RenderStreamed(Camera* camera, SkyboxShaderProg* shader)
+{
+	if (virtualTexture == nullptr || !virtualTexture->IsValid())
+		return;
+	// Request the tiles of this view and upload the ones that arrived.
+	glm::mat4x4 invViewProj = GetInvViewProj(camera);
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	virtualTexture->Update(invViewProj, viewport[2], viewport[3]);
+
+	shader->Bind();
+	virtualTexture->Bind(GL_TEXTURE0, GL_TEXTURE1);
+	glUniform1i(shader->GetLocPageAtlas(), 0);
+	glUniform1i(shader->GetLocPageTable(), 1);
+	glUniform2i(shader->GetLocVirtualSize(), virtualTexture->GetWidth(), virtualTexture->GetHeight());
+	glUniform1i(shader->GetLocNumLevels(), virtualTexture->GetNumLevels());
+	const std::vector<int>& rows = virtualTexture->GetPageTableRows();
+	glUniform1iv(shader->GetLocPageTableRows(), (GLsizei)rows.size(), rows.data());
+
+	// Same depth setup as the full-screen triangle.
+	glDepthFunc(GL_LEQUAL);
+	glDepthMask(GL_FALSE);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+
+	shader->UnBind();
+}
+
+void Skybox::ShowInfo() const
+{
+	if (environment == nullptr)
+		return;
+	// A 2D panorama with a full mip chain costs 4/3 of its level 0.
+	std::cout << "Cube map: " << environment->GetFaceSize() << " x " << environment->GetFaceSize() << " x 6, "
+			  << environment->GetNumMipLevels() << " levels, converted in " << environment->GetConvertTime() << " ms" << std::endl;
+	std::cout << "Texture memory: " << environment->GetSizeInBytes() / 1024 << " KB (equirectangular with mips: "
+			  << environment->GetSourceBytes() * 4 / 3 / 1024 << " KB)" << std::endl;
+	std::cout << "SH9 projection: " << environment->GetProjectSHTime() << " ms" << std::endl;
+	if (virtualTexture != nullptr)
+		virtualTexture->ShowInfo();
+	std::cout << "Specular prefilter: " << environment->GetNumSpecularLevels() << " levels, "
+			  << environment->GetPrefilterTime() << " ms (" << (environment->IsPrefilterCached() ? "disk cache" : "computed")
+			  << ")" << std::endl;
+}
+
+void Skybox::CreateSphereBuffers()
+{
+	if (vboId != 0)
+		return;
+
+	// Create sphere geometry.
+	CreateSphere3D(numSlices, numStacks, sphereRadius, vertices, indices);
+
+	// The vertex array object records the layout and the index buffer.
+	glGenVertexArrays(1, &vaoId);
+	glBindVertexArray(vaoId);
+	// Create vertex buffer.
+	glGenBuffers(1, &vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(VertexPT) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+	VertexPT::SetLayout(vboId);
+	// Create index buffer.
+	glGenBuffers(1, &iboId);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboId);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), &(indices[0]), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+}
+
+void Skybox::ReleaseSphereBuffers()
+{
+	vertices.clear();
+	indices.clear();
+	if (vaoId != 0)
+		glDeleteVertexArrays(1, &vaoId);
+	if (vboId != 0)
+		glDeleteBuffers(1, &vboId);
+	if (iboId != 0)
+		glDeleteBuffers(1, &iboId);
+	vaoId = 0;
+	vboId = 0;
+	iboId = 0;
+}
+
+void Skybox::CreateSphere3D(const int nSlices, const int nStacks, const float radius, 
+					std::vector<VertexPT>& vertices, std::vector<unsigned int>& indices)
+{
+	const int numPhi = nSlices;
+	const int numTheta = nStacks;
+	// Phi range: from 0 to 2PI.
+	// Theta range: from PI/2 to -PI/2.
+	const float phiStart = 0.0f;
+	const float thetaStart = 0.5f * glm::pi<float>();
+	const float phiOffset = 2.0f * glm::pi<float>() / (float)numPhi;
+	const float thetaOffset = -glm::pi<float>() / (float)numTheta;
+	for (int t = 0; t <= numTheta; ++t) {
+		for (int p = 0; p <= numPhi; ++p) {
+			float phi = phiStart + p * phiOffset;
+			float theta = thetaStart + t * thetaOffset;
+			// std::cout << glm::degrees<float>(phi) << " " << glm::degrees<float>(theta) << std::endl;
+			glm::vec2 uv = glm::vec2((float)p / (float)numPhi, (float)t / (float)numTheta);
+			// std::cout << uv.x << " " << uv.y << std::endl;
+			float x = radius * std::cosf(theta) * std::cosf(phi);
+			float y = radius * std::sinf(theta);
+			float z = radius * std::cosf(theta) * std::sinf(phi);
+			
+			VertexPT vt = VertexPT(glm::vec3(x, y, z), uv);
+			vertices.push_back(vt);
+		}
+	}
+
+	// Vertex order (4 x 2 division for example): 
+	//  0   1   2   3   4.
+	//  5   6   7   8   9.
+	// 10  11  12  13  14.
+	const int pVertices = nSlices + 1;
+	const int tVertices = nStacks + 1;
+	for (int t = 0; t < nStacks; ++t) {
+		for (int p = 0; p < nSlices; ++p) {
+			// Each grid will generate 2 triangles.
+			// The upper-half one.
+			indices.push_back(t * pVertices + p);
+			indices.push_back(t * pVertices + p + 1);
+			indices.push_back((t+1) * pVertices + p);
+			// The bottom-half one.
+			indices.push_back(t * pVertices + p + 1);
+			indices.push_back((t+1) * pVertices + p + 1);
+			indices.push_back((t+1) * pVertices + p);
+		}
+	}
+}
+
@@ -1,63 +1,126 @@
-#ifndef SKYBOX_H
-#define SKYBOX_H
-
-#include "headers.h"
-#include "imagetexture.h"
-#include "shaderprog.h"
-#include "material.h"
-#include "camera.h"
-
-
-// VertexPT Declarations.
-struct VertexPT
-{
-	VertexPT() {
-		position = glm::vec3(0.0f, 0.0f, 0.0f);
-		texcoord = glm::vec2(0.0f, 0.0f);
-	}
-	VertexPT(glm::vec3 p, glm::vec2 uv) {
-		position = p;
-		texcoord = uv;
-	}
-	glm::vec3 position;
-	glm::vec2 texcoord;
-};
-
-
-// Skybox Declarations.
-class Skybox
-{
-public:
-	// Skybox Public Methods.
-	Skybox(const std::string& texImagePath, const int nSlices, 
-			const int nStacks, const float radius);
-	~Skybox();
-	void Render(Camera* camera, SkyboxShaderProg* shader);
-	
-	void SetRotationX(const float newRotation) { rotationX = newRotation; }
-	void SetRotationY(const float newRotation) { rotationY = newRotation; }
-	
-	ImageTexture* GetTexture() { return panorama; };
-	float GetRotationX() const { return rotationX; }
-	float GetRotationY() const  { return rotationY; }
-
-private:
-	// Skybox Private Methods.
-	static void CreateSphere3D(const int nSlices, const int nStacks, const float radius, 
-					std::vector<VertexPT>& vertices, std::vector<unsigned int>& indices);
-
-	// Skybox Private Data.
-	GLuint vboId;
-	GLuint iboId;
-	std::vector<VertexPT> vertices;
-	std::vector<unsigned int> indices;
-	
-	SkyboxMaterial* material;
-	ImageTexture* panorama;
-
-	float rotationX;
-	float rotationY;
-};
-
-#endif
-
+#ifndef SKYBOX_H
+#define SKYBOX_H
+
+#include "headers.h"
+#include "imagetexture.h"
+#include "cubemaptexture.h"
+#include "shaderprog.h"
+#include "material.h"
+#include "camera.h"
+#include "gputimer.h"
+#include "virtualtexture.h"
+#include "vertexlayout.h"
+
+
+// VertexPT Declarations.
+struct VertexPT
+{
+	VertexPT() {
+		position = glm::vec3(0.0f, 0.0f, 0.0f);
+		texcoord = glm::vec2(0.0f, 0.0f);
+	}
+	VertexPT(glm::vec3 p, glm::vec2 uv) {
+		position = p;
+		texcoord = uv;
+	}
+	// Attribute layout: position (0), texcoord (1).
+	static void SetLayout(const GLuint vboId) {
+		const VertexAttribute attributes[] = {
+			VERTEX_ATTRIBUTE(0, VertexPT, position),
+			VERTEX_ATTRIBUTE(1, VertexPT, texcoord)
+		};
+		SetVertexLayout<VertexPT>(vboId, attributes);
+	}
+	glm::vec3 position;
+	glm::vec2 texcoord;
+};
+
+
+// How the skybox is drawn: a textured sphere around the origin, or one triangle covering
+// the screen at the far plane that looks up the cube map by view ray. Streamed draws the
+// same triangle but reads the panorama tile by tile through a VirtualTexture.
+enum class SkyboxMode
+{
+	Sphere = 0,
+	FullScreenTriangle = 1,
+	Streamed = 2
+};
+
+// Skybox Declarations.
+class Skybox
+{
+public:
+	// Skybox Public Methods.
+	// The cube map (resampled from the panorama at texImagePath) is not owned by the skybox.
+	Skybox(CubeMapTexture* cubeMap, const std::string& texImagePath, const int nSlices, 
+			const int nStacks, const float radius,
+			const SkyboxMode skyboxMode = SkyboxMode::FullScreenTriangle);
+	~Skybox();
+	// Draw after all opaque geometry, with the shader matching the current mode. The shaders
+	// read the camera and GetRotationMatrix() of this frame from the FrameData block.
+	void Render(Camera* camera, SkyboxShaderProg* shader);
+	void ShowInfo() const;
+	
+	// The rotation matrix is rebuilt only when a rotation changes.
+	void SetRotationX(const float newRotation);
+	void SetRotationY(const float newRotation);
+	// Switching panoramas only swaps the cube map.
+	void SetEnvironment(CubeMapTexture* cubeMap, const std::string& texImagePath);
+	// Changes on every SetEnvironment() of any skybox. Key what is derived from the cube map
+	// on it rather than on GetTexture(): a new cube map may reuse the address of a freed one.
+	unsigned int GetEnvironmentId() const { return environmentId; }
+	// The sphere buffers only exist in sphere mode, the virtual texture in streamed mode.
+	void SetMode(const SkyboxMode newMode);
+	SkyboxMode GetMode() const { return mode; }
+	
+	CubeMapTexture* GetTexture() { return environment; };
+	VirtualTexture* GetVirtualTexture() { return virtualTexture; }
+	std::string GetPanoramaPath() const { return panoramaPath; }
+	// Average GPU time of the skybox pass since the last reset, in milliseconds.
+	double GetGpuTime() const { return gpuTimer->GetAverageMs(); }
+	void ResetGpuTime() { gpuTimer->Reset(); }
+	float GetRotationX() const { return rotationX; }
+	float GetRotationY() const  { return rotationY; }
+	// Skybox space to world space (Rx * Ry).
+	const glm::mat4x4& GetRotationMatrix() const { return rotationMatrix; }
+
+private:
+	// Skybox Private Methods.
+	void RenderSphere(SkyboxShaderProg* shader);
+	void RenderFullScreen(SkyboxShaderProg* shader);
+	void RenderStreamed(Camera* camera, SkyboxShaderProg* shader);
+	glm::mat4x4 GetInvViewProj(Camera* camera) const;
+	void UpdateRotationMatrix();
+	void CreateSphereBuffers();
+	void ReleaseSphereBuffers();
+	static void CreateSphere3D(const int nSlices, const int nStacks, const float radius, 
+					std::vector<VertexPT>& vertices, std::vector<unsigned int>& indices);
+
+	// Skybox Private Data.
+	SkyboxMode mode;
+	int numSlices;
+	int numStacks;
+	float sphereRadius;
+	GLuint vaoId;
+	GLuint vboId;
+	GLuint iboId;
+	std::vector<VertexPT> vertices;
+	std::vector<unsigned int> indices;
+	
+	SkyboxMaterial* material;
+	CubeMapTexture* environment;
+	unsigned int environmentId;
+	std::string panoramaPath;
+	VirtualTexture* virtualTexture;
+
+	GpuTimer* gpuTimer;
+
+	float rotationX;
+	float rotationY;
+	glm::mat4x4 rotationMatrix;
+
+	static unsigned int numEnvironments;
+};
+
+#endif
+
@@ -0,0 +1,272 @@
+#include "skyboxcache.h"
+
+#include <chrono>
+
+// Panoramas decoded at the same time; each conversion is already spread over all cores.
+static const int kMaxPreloadWorkers = 2;
+
+SkyboxCache::SkyboxCache(const size_t cap, const int size)
+{
+	capBytes = cap;
+	faceSize = size;
+	current = nullptr;
+	useCounter = 0;
+	stopWorkers = false;
+	numWarm = 0;
+	numCold = 0;
+	warmMs = 0.0;
+	coldMs = 0.0;
+
+	// Workers cannot query GL limits, so clamp the face size here.
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_CUBE_MAP_TEXTURE_SIZE, &maxSize);
+	if (faceSize > 0 && maxSize > 0)
+		faceSize = std::min(faceSize, (int)maxSize);
+}
+
+SkyboxCache::~SkyboxCache()
+{
+	Clear();
+}
+
+void SkyboxCache::Preload(const std::vector<std::string>& paths)
+{
+	// Earlier workers exit once their queue is empty.
+	for (auto& worker : workers)
+		worker.join();
+	workers.clear();
+
+	int numQueued = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const std::string& path : paths) {
+			if (FindEntry(path) != nullptr)
+				continue;
+			Entry* entry = new Entry();
+			entry->path = path;
+			entry->state = EntryState::Queued;
+			entry->texture = nullptr;
+			entry->lastUsed = 0;
+			entries.push_back(entry);
+			++numQueued;
+		}
+	}
+	const int numWorkers = std::min(numQueued, kMaxPreloadWorkers);
+	for (int i = 0; i < numWorkers; ++i)
+		workers.emplace_back(&SkyboxCache::WorkerLoop, this);
+}
+
+void SkyboxCache::Update()
+{
+	std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+	if (!lock.owns_lock())
+		return;
+	for (Entry* entry : entries) {
+		if (entry->state == EntryState::Ready) {
+			MakeResident(*entry);
+			EnforceCap();
+			break;
+		}
+	}
+}
+
+bool SkyboxCache::HasPendingUploads()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (const Entry* entry : entries) {
+		if (entry->state == EntryState::Loading || entry->state == EntryState::Ready)
+			return true;
+	}
+	return false;
+}
+
+CubeMapTexture* SkyboxCache::Acquire(const std::string& path, bool* wasResident)
+{
+	TRACE_ZONE("Acquire skybox");
+	const auto start = std::chrono::high_resolution_clock::now();
+	std::unique_lock<std::mutex> lock(mutex);
+	Entry* entry = FindEntry(path);
+	if (entry == nullptr) {
+		entry = new Entry();
+		entry->path = path;
+		entry->state = EntryState::Queued;
+		entry->texture = nullptr;
+		entry->lastUsed = 0;
+		entries.push_back(entry);
+	}
+	const bool resident = entry->state == EntryState::Resident;
+
+	// A worker is on it: waiting is cheaper than building it twice.
+	if (entry->state == EntryState::Loading)
+		entryReady.wait(lock, [entry]() { return entry->state != EntryState::Loading; });
+	if (entry->state == EntryState::Queued || entry->state == EntryState::Failed) {
+		entry->state = EntryState::Loading;
+		lock.unlock();
+		CubeMapFaces faces;
+		const bool built = BuildEntryFaces(path, faces);
+		lock.lock();
+		entry->faces = std::move(faces);
+		entry->state = built ? EntryState::Ready : EntryState::Failed;
+		entryReady.notify_all();
+	}
+	if (entry->state == EntryState::Ready)
+		MakeResident(*entry);
+
+	entry->lastUsed = ++useCounter;
+	current = entry;
+	EnforceCap();
+	CubeMapTexture* texture = entry->texture;
+	lock.unlock();
+
+	const auto end = std::chrono::high_resolution_clock::now();
+	const double elapsedMs = std::chrono::duration<double, std::milli>(end - start).count();
+	if (resident) {
+		++numWarm;
+		warmMs += elapsedMs;
+	}
+	else {
+		++numCold;
+		coldMs += elapsedMs;
+	}
+	if (wasResident != nullptr)
+		*wasResident = resident;
+	return texture;
+}
+
+void SkyboxCache::Clear()
+{
+	stopWorkers = true;
+	for (auto& worker : workers)
+		worker.join();
+	workers.clear();
+	stopWorkers = false;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (Entry* entry : entries) {
+		if (entry->texture != nullptr)
+			delete entry->texture;
+		delete entry;
+	}
+	entries.clear();
+	current = nullptr;
+}
+
+size_t SkyboxCache::GetSizeInBytes()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return GetSizeInBytesLocked();
+}
+
+void SkyboxCache::ShowInfo()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::cout << "Skybox cache: " << GetSizeInBytesLocked() / (1024 * 1024) << " / "
+			  << capBytes / (1024 * 1024) << " MB" << std::endl;
+	for (const Entry* entry : entries) {
+		std::cout << "  " << entry->path << ": ";
+		switch (entry->state) {
+		case EntryState::Queued:	std::cout << "queued"; break;
+		case EntryState::Loading:	std::cout << "loading"; break;
+		case EntryState::Ready:		std::cout << "ready (CPU)"; break;
+		case EntryState::Resident:	std::cout << "resident"; break;
+		case EntryState::Failed:	std::cout << "failed"; break;
+		}
+		std::cout << std::endl;
+	}
+	std::cout << "Switch latency: warm " << ((numWarm > 0) ? warmMs / numWarm : 0.0) << " ms (" << numWarm
+			  << "), cold " << ((numCold > 0) ? coldMs / numCold : 0.0) << " ms (" << numCold << ")" << std::endl;
+}
+
+SkyboxCache::Entry* SkyboxCache::FindEntry(const std::string& path)
+{
+	for (Entry* entry : entries) {
+		if (entry->path == path)
+			return entry;
+	}
+	return nullptr;
+}
+
+size_t SkyboxCache::GetSizeInBytesLocked() const
+{
+	size_t bytes = 0;
+	for (const Entry* entry : entries) {
+		if (entry->state == EntryState::Resident)
+			bytes += entry->texture->GetSizeInBytes();
+		else if (entry->state == EntryState::Ready)
+			bytes += entry->faces.GetSizeInBytes();
+	}
+	return bytes;
+}
+
+void SkyboxCache::WorkerLoop()
+{
+	TRACE_THREAD_NAME("Skybox loader");
+	while (!stopWorkers) {
+		Entry* entry = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (GetSizeInBytesLocked() >= capBytes)
+				return;
+			for (Entry* e : entries) {
+				if (e->state == EntryState::Queued) {
+					entry = e;
+					break;
+				}
+			}
+			if (entry == nullptr)
+				return;
+			entry->state = EntryState::Loading;
+		}
+
+		CubeMapFaces faces;
+		const bool built = BuildEntryFaces(entry->path, faces);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			entry->faces = std::move(faces);
+			entry->state = built ? EntryState::Ready : EntryState::Failed;
+		}
+		entryReady.notify_all();
+	}
+}
+
+bool SkyboxCache::BuildEntryFaces(const std::string& path, CubeMapFaces& faces) const
+{
+	TRACE_ZONE("Decode panorama");
+	cv::Mat panorama = cv::imread(path, cv::IMREAD_COLOR);
+	if (panorama.empty()) {
+		std::cerr << "[ERROR] Failed to load skybox panorama: " << path << std::endl;
+		return false;
+	}
+	return CubeMapTexture::BuildFaces(panorama, faceSize, faces, path);
+}
+
+void SkyboxCache::MakeResident(Entry& entry)
+{
+	TRACE_ZONE("Upload cube map");
+	entry.texture = new CubeMapTexture(entry.faces);
+	entry.faces = CubeMapFaces();
+	entry.state = EntryState::Resident;
+}
+
+void SkyboxCache::EnforceCap()
+{
+	// Release the least recently used entries other than the current one; they become cold.
+	while (GetSizeInBytesLocked() > capBytes) {
+		auto victim = entries.end();
+		for (auto it = entries.begin(); it != entries.end(); ++it) {
+			const Entry* entry = *it;
+			if (entry == current)
+				continue;
+			if (entry->state != EntryState::Resident && entry->state != EntryState::Ready)
+				continue;
+			if (victim == entries.end() || entry->lastUsed < (*victim)->lastUsed)
+				victim = it;
+		}
+		if (victim == entries.end())
+			break;
+		if ((*victim)->texture != nullptr)
+			delete (*victim)->texture;
+		delete *victim;
+		entries.erase(victim);
+	}
+}
@@ -0,0 +1,85 @@
+#ifndef SKYBOX_CACHE_H
+#define SKYBOX_CACHE_H
+
+#include "headers.h"
+#include "cubemaptexture.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// SkyboxCache Declarations.
+// Holds the cube maps of the skybox panoramas. Preload() decodes and resamples panoramas on
+// background threads; Update() uploads finished ones from the GL thread. Acquire() returns
+// a cube map right away when it is resident (warm), waits for a panorama that is being
+// loaded, and builds it synchronously otherwise (cold).
+// Resident cube maps plus finished CPU faces stay under a memory cap: workers stop
+// preloading when it is reached and the least recently used cube maps are released.
+class SkyboxCache
+{
+public:
+	// SkyboxCache Public Methods.
+	SkyboxCache(const size_t capBytes, const int faceSize = 0);
+	~SkyboxCache();
+
+	// Queue the panoramas and start the workers.
+	void Preload(const std::vector<std::string>& paths);
+	// Upload at most one finished panorama. Call from the GL thread, e.g. once per frame.
+	void Update();
+	// True while a panorama is being loaded or waits for Update(); keep calling Update() until not.
+	bool HasPendingUploads();
+	// The cube map of a panorama; stays valid until a later Acquire() or Clear().
+	CubeMapTexture* Acquire(const std::string& path, bool* wasResident = nullptr);
+	// Stop the workers and release everything.
+	void Clear();
+
+	size_t GetSizeInBytes();
+	void ShowInfo();
+
+private:
+	// SkyboxCache Private Types.
+	enum class EntryState
+	{
+		Queued,		// Waiting for a worker.
+		Loading,	// A worker (or Acquire) is building the faces.
+		Ready,		// Faces built on the CPU, not uploaded yet.
+		Resident,	// Cube map on the GPU.
+		Failed
+	};
+	struct Entry
+	{
+		std::string path;
+		EntryState state;
+		CubeMapFaces faces;
+		CubeMapTexture* texture;
+		unsigned int lastUsed;
+	};
+
+	// SkyboxCache Private Methods.
+	Entry* FindEntry(const std::string& path);
+	size_t GetSizeInBytesLocked() const;
+	void WorkerLoop();
+	bool BuildEntryFaces(const std::string& path, CubeMapFaces& faces) const;
+	void MakeResident(Entry& entry);
+	void EnforceCap();
+
+	// SkyboxCache Private Data.
+	size_t capBytes;
+	int faceSize;
+	std::vector<Entry*> entries;
+	Entry* current;
+	unsigned int useCounter;
+	std::mutex mutex;
+	std::condition_variable entryReady;
+	std::vector<std::thread> workers;
+	std::atomic<bool> stopWorkers;
+
+	// Switch latency (time spent in Acquire).
+	int numWarm;
+	int numCold;
+	double warmMs;
+	double coldMs;
+};
+
+#endif
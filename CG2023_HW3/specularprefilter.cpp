@@ -0,0 +1,312 @@
+#include "specularprefilter.h"
+#include "cubemaptexture.h"
+#include "parallel.h"
+#include "texturecache.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+const int SpecularPrefilter::kBaseSize;
+const int SpecularPrefilter::kNumLevels;
+const int SpecularPrefilter::kNumSamples;
+
+// Texel rows handled by one worker task.
+static const int kRowsPerTask = 4;
+
+// Cache file layout: header, then every face's levels from level 0 down.
+static const uint32_t kCacheMagic = 0x564e4550;	// "PENV".
+static const uint32_t kCacheVersion = 1;
+
+struct SpecularCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t baseSize;
+	uint32_t numLevels;
+	uint32_t numSamples;
+	uint32_t sourceFaceSize;
+	uint64_t sourceSize;
+	uint64_t sourceHash;
+};
+
+// A direction of the Phong lobe around +Z, and the source level to read it from.
+struct LobeSample
+{
+	glm::vec3 dir;
+	float lod;
+};
+
+// Van der Corput sequence in base 2.
+static inline float RadicalInverse(uint32_t bits)
+{
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return (float)bits * 2.3283064365386963e-10f;
+}
+
+// Importance sample the lobe (Hammersley points). Each sample reads the source level whose
+// texels cover the solid angle the sample stands for, which keeps the sample count low
+// without aliasing (GPU Gems 3, chapter 20).
+static void GetLobeSamples(const float roughness, const int sourceSize, std::vector<LobeSample>& samples)
+{
+	const float pi = glm::pi<float>();
+	const float power = 2.0f / std::pow(roughness, 4.0f) - 2.0f;
+	const float texelSolidAngle = 4.0f * pi / (6.0f * (float)sourceSize * (float)sourceSize);
+	const int count = SpecularPrefilter::kNumSamples;
+	samples.resize(count);
+	for (int i = 0; i < count; ++i) {
+		const float u = ((float)i + 0.5f) / (float)count;
+		const float phi = 2.0f * pi * RadicalInverse((uint32_t)i);
+		const float cosTheta = std::pow(u, 1.0f / (power + 1.0f));
+		const float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+		const float pdf = (power + 1.0f) / (2.0f * pi) * std::pow(cosTheta, power);
+		const float sampleSolidAngle = 1.0f / ((float)count * pdf);
+		samples[i].dir = glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+		samples[i].lod = 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f;
+	}
+}
+
+// Add weight * bilinear lookup at (s, t) of a face level (clamped at the face edges) to bgr.
+static inline void AddBilinear(const cv::Mat& image, const float s, const float t, const float weight, float bgr[3])
+{
+	const int channels = image.channels();
+	const float px = glm::clamp((s * 0.5f + 0.5f) * (float)image.cols - 0.5f, 0.0f, (float)(image.cols - 1));
+	const float py = glm::clamp((t * 0.5f + 0.5f) * (float)image.rows - 0.5f, 0.0f, (float)(image.rows - 1));
+	const int x0 = (int)px;
+	const int y0 = (int)py;
+	const int x1 = std::min(x0 + 1, image.cols - 1);
+	const int y1 = std::min(y0 + 1, image.rows - 1);
+	const float fx = px - (float)x0;
+	const float fy = py - (float)y0;
+	const unsigned char* r0 = image.ptr<unsigned char>(y0);
+	const unsigned char* r1 = image.ptr<unsigned char>(y1);
+	for (int c = 0; c < 3; ++c) {
+		// Gray sources are replicated, alpha is dropped.
+		const int cc = std::min(c, channels - 1);
+		const float top = (float)r0[x0 * channels + cc] + fx * ((float)r0[x1 * channels + cc] - (float)r0[x0 * channels + cc]);
+		const float bottom = (float)r1[x0 * channels + cc] + fx * ((float)r1[x1 * channels + cc] - (float)r1[x0 * channels + cc]);
+		bgr[c] += weight * (top + fy * (bottom - top));
+	}
+}
+
+// Add weight * trilinear lookup of the source cube map in direction dir to bgr.
+static inline void AddTrilinear(const std::vector<MipChain>& source, const glm::vec3& dir, const float lod,
+								const float weight, float bgr[3])
+{
+	float s, t;
+	const MipChain& chain = source[CubeMapTexture::GetFaceCoords(dir, s, t)];
+	const float level = glm::clamp(lod, 0.0f, (float)(chain.GetNumLevels() - 1));
+	const int level0 = (int)level;
+	const float f = level - (float)level0;
+	AddBilinear(chain.levels[level0], s, t, weight * (1.0f - f), bgr);
+	if (f > 0.0f)
+		AddBilinear(chain.levels[level0 + 1], s, t, weight * f, bgr);
+}
+
+double SpecularPrefilter::Prefilter(const std::vector<MipChain>& source, std::vector<MipChain>& specular)
+{
+	TRACE_ZONE("Prefilter specular");
+	specular.clear();
+	if (source.size() != 6 || source[0].GetNumLevels() == 0)
+		return 0.0;
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	const int sourceSize = source[0].levels[0].cols;
+	const int baseSize = std::min(kBaseSize, sourceSize);
+	const int numLevels = std::min(kNumLevels, MipGenerator::GetNumLevels(baseSize, baseSize));
+	specular.resize(6);
+	for (auto& chain : specular)
+		chain.levels.resize(numLevels);
+
+	std::vector<LobeSample> samples;
+	for (int level = 0; level < numLevels; ++level) {
+		const int size = std::max(1, baseSize >> level);
+		for (auto& chain : specular)
+			chain.levels[level].create(size, size, CV_8UC3);
+		// Level 0 is the mirror reflection: one lookup with the footprint of an output texel.
+		const float roughness = (numLevels > 1) ? (float)level / (float)(numLevels - 1) : 0.0f;
+		const float mirrorLod = std::log2((float)sourceSize / (float)size);
+		if (level > 0)
+			GetLobeSamples(roughness, sourceSize, samples);
+		const float sampleWeight = 1.0f / (float)kNumSamples;
+
+		ParallelFor(0, 6 * size, kRowsPerTask, [&](const int begin, const int end) {
+			for (int i = begin; i < end; ++i) {
+				const int face = i / size;
+				const int row = i % size;
+				const float t = 2.0f * ((float)row + 0.5f) / (float)size - 1.0f;
+				unsigned char* out = specular[face].levels[level].ptr<unsigned char>(row);
+				for (int x = 0; x < size; ++x, out += 3) {
+					const float s = 2.0f * ((float)x + 0.5f) / (float)size - 1.0f;
+					// The lobe is centered on the reflection vector (N = V = R).
+					const glm::vec3 axis = glm::normalize(CubeMapTexture::GetFaceDirection(face, s, t));
+					float bgr[3] = { 0.0f, 0.0f, 0.0f };
+					if (level == 0) {
+						AddTrilinear(source, axis, mirrorLod, 1.0f, bgr);
+					}
+					else {
+						const glm::vec3 up = (std::abs(axis.y) < 0.999f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+						const glm::vec3 tangent = glm::normalize(glm::cross(up, axis));
+						const glm::vec3 bitangent = glm::cross(axis, tangent);
+						for (const auto& sample : samples) {
+							const glm::vec3 dir = tangent * sample.dir.x + bitangent * sample.dir.y + axis * sample.dir.z;
+							AddTrilinear(source, dir, sample.lod, sampleWeight, bgr);
+						}
+					}
+					for (int c = 0; c < 3; ++c)
+						out[c] = (unsigned char)std::min(255.0f, bgr[c] + 0.5f);
+				}
+			}
+		});
+	}
+
+	const auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+double SpecularPrefilter::Build(const std::string& panoramaPath, const std::vector<MipChain>& source,
+								std::vector<MipChain>& specular, bool* cacheHit)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+	const int sourceSize = (source.empty() || source[0].GetNumLevels() == 0) ? 0 : source[0].levels[0].cols;
+	const bool hit = Load(panoramaPath, sourceSize, specular);
+	if (!hit) {
+		Prefilter(source, specular);
+		Save(panoramaPath, sourceSize, specular);
+	}
+	if (cacheHit != nullptr)
+		*cacheHit = hit;
+	const auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+bool SpecularPrefilter::Load(const std::string& panoramaPath, const int sourceSize, std::vector<MipChain>& specular)
+{
+	std::ifstream cacheFile(GetCachePath(panoramaPath, sourceSize), std::ios::binary);
+	if (!cacheFile.is_open() || sourceSize <= 0)
+		return false;
+
+	SpecularCacheHeader header;
+	if (!cacheFile.read((char*)&header, sizeof(header)))
+		return false;
+	// The entry must match what Prefilter() would build now.
+	const int baseSize = std::min(kBaseSize, sourceSize);
+	const int numLevels = std::min(kNumLevels, MipGenerator::GetNumLevels(baseSize, baseSize));
+	if (header.magic != kCacheMagic || header.version != kCacheVersion || header.numSamples != (uint32_t)kNumSamples)
+		return false;
+	if (header.baseSize != (uint32_t)baseSize || header.numLevels != (uint32_t)numLevels
+		|| header.sourceFaceSize != (uint32_t)sourceSize)
+		return false;
+
+	// Stale entry if the panorama changed since the cache was written.
+	uint64_t sourceFileSize = 0;
+	uint64_t sourceHash = 0;
+	if (!TextureCache::GetSourceKey(panoramaPath, sourceFileSize, sourceHash))
+		return false;
+	if (header.sourceSize != sourceFileSize || header.sourceHash != sourceHash)
+		return false;
+
+	specular.resize(6);
+	for (auto& chain : specular) {
+		chain.levels.resize(numLevels);
+		for (int level = 0; level < numLevels; ++level) {
+			const int size = std::max(1, baseSize >> level);
+			cv::Mat& image = chain.levels[level];
+			image.create(size, size, CV_8UC3);
+			if (!cacheFile.read((char*)image.ptr(), (std::streamsize)(image.total() * image.elemSize()))) {
+				specular.clear();
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool SpecularPrefilter::Save(const std::string& panoramaPath, const int sourceSize, const std::vector<MipChain>& specular)
+{
+	if (specular.size() != 6 || specular[0].GetNumLevels() == 0)
+		return false;
+
+	SpecularCacheHeader header;
+	header.magic = kCacheMagic;
+	header.version = kCacheVersion;
+	header.baseSize = (uint32_t)specular[0].levels[0].cols;
+	header.numLevels = (uint32_t)specular[0].GetNumLevels();
+	header.numSamples = (uint32_t)kNumSamples;
+	header.sourceFaceSize = (uint32_t)sourceSize;
+	if (!TextureCache::GetSourceKey(panoramaPath, header.sourceSize, header.sourceHash))
+		return false;
+
+	std::ofstream cacheFile(GetCachePath(panoramaPath, sourceSize), std::ios::binary | std::ios::trunc);
+	if (!cacheFile.is_open()) {
+		std::cerr << "[WARNING] Failed to write specular cache: " << GetCachePath(panoramaPath, sourceSize) << std::endl;
+		return false;
+	}
+	cacheFile.write((const char*)&header, sizeof(header));
+	for (const auto& chain : specular) {
+		// Levels are created by Prefilter() or Load(), hence continuous.
+		for (const auto& image : chain.levels)
+			cacheFile.write((const char*)image.ptr(), (std::streamsize)(image.total() * image.elemSize()));
+	}
+	return cacheFile.good();
+}
+
+float SpecularPrefilter::GetRoughness(const float Ns)
+{
+	// A Blinn-Phong lobe of exponent Ns is close to a Phong lobe of exponent Ns / 4.
+	const float power = std::max(Ns, 0.0f) * 0.25f;
+	return std::pow(2.0f / (power + 2.0f), 0.25f);
+}
+
+void SpecularPrefilter::Benchmark(const std::string& panoramaPath, const int faceSize, const int numRuns)
+{
+	cv::Mat panorama = cv::imread(panoramaPath, cv::IMREAD_COLOR);
+	if (panorama.empty()) {
+		std::cerr << "[ERROR] Failed to load skybox panorama: " << panoramaPath << std::endl;
+		return;
+	}
+	const int size = (faceSize > 0) ? faceSize : std::max(1, panorama.cols / 4);
+	std::vector<cv::Mat> images;
+	CubeMapTexture::ConvertEquirect(panorama, size, images);
+	if (images.size() != 6)
+		return;
+	std::vector<MipChain> source(6);
+	for (int face = 0; face < 6; ++face)
+		MipGenerator::Generate(images[face], MipFilter::Box, source[face]);
+
+	std::vector<MipChain> specular;
+	double bestMs = 0.0;
+	double sumMs = 0.0;
+	for (int run = 0; run < numRuns; ++run) {
+		const double ms = Prefilter(source, specular);
+		bestMs = (run == 0) ? ms : std::min(bestMs, ms);
+		sumMs += ms;
+	}
+	// A cold Build() has to prefilter and write the entry, the next one only reads it.
+	std::remove(GetCachePath(panoramaPath, size).c_str());
+	bool missHit = false;
+	bool hit = false;
+	const double missMs = Build(panoramaPath, source, specular, &missHit);
+	const double hitMs = Build(panoramaPath, source, specular, &hit);
+	size_t bytes = 0;
+	for (const auto& chain : specular)
+		bytes += chain.GetSizeInBytes();
+
+	std::cout << "------------------------------" << std::endl;
+	std::cout << "Specular prefilter: " << panoramaPath << std::endl;
+	std::cout << "Source " << size << " x " << size << " x 6, output " << specular[0].levels[0].cols << " x "
+			  << specular[0].levels[0].cols << " x 6, " << specular[0].GetNumLevels() << " levels, "
+			  << kNumSamples << " samples per texel, " << bytes / 1024 << " KB" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Prefilter (" << GetNumWorkerThreads() << " threads): best " << bestMs << " ms, mean "
+			  << sumMs / numRuns << " ms over " << numRuns << " runs" << std::endl;
+	std::cout << "Build, " << (missHit ? "cache hit" : "cache miss") << " (prefilter + save): " << missMs << " ms" << std::endl;
+	std::cout << "Build, " << (hit ? "cache hit" : "cache miss") << " (hash + load): " << hitMs << " ms" << std::endl;
+	std::cout.unsetf(std::ios_base::floatfield);
+	std::cout << "------------------------------" << std::endl;
+}
@@ -0,0 +1,48 @@
+#ifndef SPECULAR_PREFILTER_H
+#define SPECULAR_PREFILTER_H
+
+#include "headers.h"
+#include "mipgenerator.h"
+
+// SpecularPrefilter Declarations.
+// Glossy reflections of the environment. A small cube map is built on the CPU whose level L
+// holds the environment convolved with the Phong lobe of roughness r = L / (numLevels - 1)
+// (exponent 2 / r^4 - 2, level 0 is the mirror image), so that a fragment reads its reflection
+// with a single textureLod at the level given by its material's Ns.
+// Results are cached next to the panorama ("<panorama>.<face size>.envcache"), keyed by its content hash.
+class SpecularPrefilter
+{
+public:
+	// SpecularPrefilter Public Methods.
+	// Prefilter the mip chains of the six faces of a cube map into "specular" (six chains of
+	// up to kNumLevels levels). Texel rows are spread over the worker threads.
+	// Returns the elapsed time in milliseconds.
+	static double Prefilter(const std::vector<MipChain>& source, std::vector<MipChain>& specular);
+
+	// Load the prefiltered environment of a panorama from the disk cache, or prefilter it and
+	// save it. Returns the elapsed time in milliseconds.
+	static double Build(const std::string& panoramaPath, const std::vector<MipChain>& source,
+						std::vector<MipChain>& specular, bool* cacheHit = nullptr);
+
+	static bool Load(const std::string& panoramaPath, const int sourceSize, std::vector<MipChain>& specular);
+	static bool Save(const std::string& panoramaPath, const int sourceSize, const std::vector<MipChain>& specular);
+	// One entry per source face size: the full image and the streamed skybox light from different sizes.
+	static std::string GetCachePath(const std::string& panoramaPath, const int sourceSize) {
+		return panoramaPath + "." + std::to_string(sourceSize) + ".envcache";
+	}
+
+	// Roughness in [0, 1] matching a Blinn-Phong exponent, and the level to sample for it.
+	static float GetRoughness(const float Ns);
+	static float GetLod(const float Ns, const int numLevels) { return GetRoughness(Ns) * (float)(numLevels - 1); }
+
+	// Time the prefilter, the cache write and the cache read for one panorama.
+	static void Benchmark(const std::string& panoramaPath, const int faceSize = 0, const int numRuns = 3);
+
+	// Level 0 size (or the source face size if smaller), number of roughness levels and
+	// samples per texel of the rough levels.
+	static const int kBaseSize = 128;
+	static const int kNumLevels = 6;
+	static const int kNumSamples = 64;
+};
+
+#endif
@@ -0,0 +1,157 @@
+#include "sphericalharmonics.h"
+#include "parallel.h"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <xmmintrin.h>
+
+// Rows handled by one worker task.
+static const int kRowsPerTask = 16;
+
+// Normalization constants K_i of the real SH basis.
+static const float kBasisConstants[9] = {
+	0.282095f,
+	0.488603f, 0.488603f, 0.488603f,
+	1.092548f, 1.092548f, 0.315392f, 1.092548f, 0.546274f
+};
+
+// Sum of the 4 lanes.
+static inline float HorizontalSum(const __m128 v)
+{
+	float lanes[4];
+	_mm_storeu_ps(lanes, v);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+// Unweighted polynomial terms P_i for one direction.
+static inline void EvalBasis(const float x, const float y, const float z, float basis[9])
+{
+	basis[0] = 1.0f;
+	basis[1] = y;
+	basis[2] = z;
+	basis[3] = x;
+	basis[4] = x * y;
+	basis[5] = y * z;
+	basis[6] = 3.0f * z * z - 1.0f;
+	basis[7] = x * z;
+	basis[8] = x * x - y * y;
+}
+
+double SphericalHarmonics::ProjectEquirect(const cv::Mat& panorama, SH9Color& radiance)
+{
+	TRACE_ZONE("Project SH");
+	radiance = SH9Color();
+	if (panorama.empty() || panorama.depth() != CV_8U || panorama.channels() < 3)
+		return 0.0;
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	const int width = panorama.cols;
+	const int height = panorama.rows;
+	const int channels = panorama.channels();
+	const float pi = glm::pi<float>();
+
+	// cos/sin of the azimuth of every column, shared by all rows.
+	std::vector<float> cosPhi(width), sinPhi(width);
+	for (int x = 0; x < width; ++x) {
+		const float phi = 2.0f * pi * ((float)x + 0.5f) / (float)width;
+		cosPhi[x] = std::cos(phi);
+		sinPhi[x] = std::sin(phi);
+	}
+
+	// One partial sum (9 coefficients x 3 channels, BGR order) per task, reduced in order
+	// afterwards so the result does not depend on the thread schedule.
+	const int numTasks = (height + kRowsPerTask - 1) / kRowsPerTask;
+	std::vector<std::array<double, 27>> partials(numTasks);
+	ParallelFor(0, height, kRowsPerTask, [&](const int begin, const int end) {
+		std::array<double, 27>& partial = partials[begin / kRowsPerTask];
+		partial.fill(0.0);
+		for (int y = begin; y < end; ++y) {
+			// Polar angle from +Y; v = 0 is the top row. Texel solid angle is constant along a row.
+			const float theta = pi * ((float)y + 0.5f) / (float)height;
+			const float sinTheta = std::sin(theta);
+			const float cosTheta = std::cos(theta);
+			const double solidAngle = (double)sinTheta * (2.0 * pi / width) * (pi / height);
+			const unsigned char* row = panorama.ptr<unsigned char>(y);
+
+			__m128 acc[27];
+			for (int i = 0; i < 27; ++i)
+				acc[i] = _mm_setzero_ps();
+			const __m128 vSinTheta = _mm_set1_ps(sinTheta);
+			const __m128 vY = _mm_set1_ps(cosTheta);
+			const __m128 vOne = _mm_set1_ps(1.0f);
+			const __m128 vThree = _mm_set1_ps(3.0f);
+			int x = 0;
+			for (; x + 4 <= width; x += 4) {
+				const __m128 vX = _mm_mul_ps(vSinTheta, _mm_loadu_ps(&cosPhi[x]));
+				const __m128 vZ = _mm_mul_ps(vSinTheta, _mm_loadu_ps(&sinPhi[x]));
+				__m128 basis[9];
+				basis[0] = vOne;
+				basis[1] = vY;
+				basis[2] = vZ;
+				basis[3] = vX;
+				basis[4] = _mm_mul_ps(vX, vY);
+				basis[5] = _mm_mul_ps(vY, vZ);
+				basis[6] = _mm_sub_ps(_mm_mul_ps(vThree, _mm_mul_ps(vZ, vZ)), vOne);
+				basis[7] = _mm_mul_ps(vX, vZ);
+				basis[8] = _mm_sub_ps(_mm_mul_ps(vX, vX), _mm_mul_ps(vY, vY));
+
+				const unsigned char* p = row + x * channels;
+				for (int c = 0; c < 3; ++c) {
+					const __m128 color = _mm_set_ps((float)p[3 * channels + c], (float)p[2 * channels + c],
+													(float)p[channels + c], (float)p[c]);
+					for (int i = 0; i < 9; ++i)
+						acc[c * 9 + i] = _mm_add_ps(acc[c * 9 + i], _mm_mul_ps(color, basis[i]));
+				}
+			}
+			float rowSum[27];
+			for (int i = 0; i < 27; ++i)
+				rowSum[i] = HorizontalSum(acc[i]);
+			for (; x < width; ++x) {
+				float basis[9];
+				EvalBasis(sinTheta * cosPhi[x], cosTheta, sinTheta * sinPhi[x], basis);
+				const unsigned char* p = row + x * channels;
+				for (int c = 0; c < 3; ++c) {
+					for (int i = 0; i < 9; ++i)
+						rowSum[c * 9 + i] += (float)p[c] * basis[i];
+				}
+			}
+			for (int i = 0; i < 27; ++i)
+				partial[i] += (double)rowSum[i] * solidAngle;
+		}
+	});
+
+	std::array<double, 27> total;
+	total.fill(0.0);
+	for (const auto& partial : partials) {
+		for (int i = 0; i < 27; ++i)
+			total[i] += partial[i];
+	}
+	// BGR bytes to RGB in [0, 1], and the basis constants.
+	for (int i = 0; i < 9; ++i) {
+		const double k = (double)kBasisConstants[i] / 255.0;
+		radiance.coeffs[i] = glm::vec3((float)(total[18 + i] * k), (float)(total[9 + i] * k), (float)(total[i] * k));
+	}
+
+	const auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+float SphericalHarmonics::GetIrradianceCoefficients(const SH9Color& radiance, const glm::vec3& ambient, glm::vec4 coeffs[9])
+{
+	// Clamped cosine convolution per band (Ramamoorthi and Hanrahan 2001).
+	const float pi = glm::pi<float>();
+	const float bandFactors[3] = { pi, 2.0f * pi / 3.0f, pi / 4.0f };
+	const int bandOf[9] = { 0, 1, 1, 1, 2, 2, 2, 2, 2 };
+	glm::vec3 irradiance[9];
+	for (int i = 0; i < 9; ++i)
+		irradiance[i] = radiance.coeffs[i] * (bandFactors[bandOf[i]] * kBasisConstants[i] / pi);
+
+	// The mean of the polynomial expansion over the sphere is its constant term.
+	const glm::vec3 luma = glm::vec3(0.2126f, 0.7152f, 0.0722f);
+	const float meanLuminance = glm::dot(irradiance[0], luma);
+	const float scale = (meanLuminance > 1e-6f) ? glm::dot(ambient, luma) / meanLuminance : 0.0f;
+	for (int i = 0; i < 9; ++i)
+		coeffs[i] = glm::vec4(irradiance[i] * scale, 0.0f);
+	return scale;
+}
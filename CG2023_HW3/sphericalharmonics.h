@@ -0,0 +1,37 @@
+#ifndef SPHERICAL_HARMONICS_H
+#define SPHERICAL_HARMONICS_H
+
+#include "headers.h"
+
+// SH9Color Declarations.
+// Bands 0-2 of an RGB function on the sphere. Coefficient i belongs to the real basis
+// function K_i * P_i(x, y, z) with P = 1, y, z, x, xy, yz, 3z^2 - 1, xz, x^2 - y^2.
+struct SH9Color
+{
+	glm::vec3 coeffs[9];
+
+	SH9Color() {
+		for (int i = 0; i < 9; ++i)
+			coeffs[i] = glm::vec3(0.0f);
+	}
+};
+
+// SphericalHarmonics Declarations.
+class SphericalHarmonics
+{
+public:
+	// SphericalHarmonics Public Methods.
+	// Project an 8-bit BGR(A) equirectangular panorama (same direction mapping as the skybox)
+	// onto SH9. Rows are spread over the worker threads and accumulated with SSE.
+	// Returns the elapsed time in milliseconds.
+	static double ProjectEquirect(const cv::Mat& panorama, SH9Color& radiance);
+
+	// Convolve radiance with the clamped cosine and fold in K_i / PI, so that the diffuse
+	// irradiance in direction n is sum_i coeffs[i] * P_i(n): nine multiply-adds per fragment.
+	// The result is scaled so that its mean over the sphere has the luminance of "ambient",
+	// keeping the tint and direction of the environment. Returns that scale, so that other
+	// lighting taken from the same environment can match.
+	static float GetIrradianceCoefficients(const SH9Color& radiance, const glm::vec3& ambient, glm::vec4 coeffs[9]);
+};
+
+#endif
@@ -0,0 +1,227 @@
+#include "texturearray.h"
+#include "material.h"
+#include "mipgenerator.h"
+#include "textureresidency.h"
+
+#include <algorithm>
+
+TextureArray::TextureArray(const int width, const int height, const int channels, const int layers)
+{
+	arrayWidth = width;
+	arrayHeight = height;
+	numChannels = channels;
+	numLayers = layers;
+	numMipLevels = MipGenerator::GetNumLevels(width, height);
+	sizeInBytes = 0;
+
+	GLint internalFormat = GL_RGB8;
+	if (numChannels == 1)
+		internalFormat = GL_R8;
+	else if (numChannels == 4)
+		internalFormat = GL_RGBA8;
+
+	// Allocate every level of every layer; SetLayer() fills them in.
+	glGenTextures(1, &textureObj);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureObj);
+	int w = arrayWidth;
+	int h = arrayHeight;
+	for (int level = 0; level < numMipLevels; ++level) {
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, w, h, numLayers,
+						0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+		sizeInBytes += (size_t)w * (size_t)h * (size_t)numChannels * (size_t)numLayers;
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, numMipLevels - 1);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	TextureResidency::AddFixedBytes(sizeInBytes);
+}
+
+TextureArray::~TextureArray()
+{
+	TextureResidency::RemoveFixedBytes(sizeInBytes);
+	glDeleteTextures(1, &textureObj);
+}
+
+void TextureArray::SetLayer(const int layer, const cv::Mat& image)
+{
+	MipChain chain;
+	MipGenerator::Generate(image, MipFilter::Kaiser, chain);
+
+	GLenum format = GL_BGR;
+	if (numChannels == 1)
+		format = GL_RED;
+	else if (numChannels == 4)
+		format = GL_BGRA;
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureObj);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int level = 0; level < chain.GetNumLevels() && level < numMipLevels; ++level) {
+		const cv::Mat& levelImage = chain.levels[level];
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levelImage.cols, levelImage.rows, 1,
+						format, GL_UNSIGNED_BYTE, levelImage.ptr());
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void TextureArray::Bind(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureObj);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+TextureArrayBuilder::TextureArrayBuilder()
+{
+	numResampled = 0;
+}
+
+TextureArrayBuilder::~TextureArrayBuilder()
+{
+	Clear();
+}
+
+void TextureArrayBuilder::AddMaterial(PhongMaterial* material)
+{
+	if (material != nullptr && material->GetMapKd() != nullptr && material->GetMapKd()->IsValid())
+		materials.push_back(material);
+}
+
+void TextureArrayBuilder::Build()
+{
+	TRACE_ZONE("Build texture arrays");
+	for (auto array : arrays)
+		delete array;
+	arrays.clear();
+	buckets.clear();
+	numResampled = 0;
+
+	// Assign every distinct texture (by file path) to a size bucket.
+	for (PhongMaterial* material : materials) {
+		ImageTexture* texture = material->GetMapKd();
+		const int width = NextPowerOfTwo(texture->GetWidth());
+		const int height = NextPowerOfTwo(texture->GetHeight());
+		Bucket* bucket = nullptr;
+		for (auto& b : buckets) {
+			if (b.width == width && b.height == height && b.channels == texture->GetNumChannels()) {
+				bucket = &b;
+				break;
+			}
+		}
+		if (bucket == nullptr) {
+			Bucket b;
+			b.width = width;
+			b.height = height;
+			b.channels = texture->GetNumChannels();
+			b.array = nullptr;
+			buckets.push_back(b);
+			bucket = &buckets.back();
+		}
+		bool found = false;
+		for (const ImageTexture* t : bucket->textures) {
+			if (t->GetPath() == texture->GetPath()) {
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			bucket->textures.push_back(texture);
+	}
+
+	// One array per bucket, of the textures that can be read back; a texture that cannot stays
+	// a 2D texture of its own.
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	for (auto& bucket : buckets) {
+		if ((int)bucket.textures.size() > maxLayers) {
+			std::cerr << "[WARNING] Texture array bucket " << bucket.width << " x " << bucket.height
+					  << " exceeds " << maxLayers << " layers" << std::endl;
+			bucket.textures.resize(maxLayers);
+		}
+		std::vector<cv::Mat> images;
+		images.reserve(bucket.textures.size());
+		std::vector<ImageTexture*> readable;
+		for (ImageTexture* texture : bucket.textures) {
+			cv::Mat image;
+			if (!texture->ReadImage(image) || image.empty()) {
+				std::cerr << "[WARNING] Failed to read " << texture->GetPath() << " back: left out of the texture arrays" << std::endl;
+				continue;
+			}
+			images.push_back(image);
+			readable.push_back(texture);
+		}
+		bucket.textures = readable;
+		bucket.array = nullptr;
+		if (bucket.textures.empty())
+			continue;
+		bucket.array = new TextureArray(bucket.width, bucket.height, bucket.channels, (int)bucket.textures.size());
+		arrays.push_back(bucket.array);
+		for (int layer = 0; layer < (int)images.size(); ++layer) {
+			const cv::Mat& image = images[layer];
+			if (image.cols == bucket.width && image.rows == bucket.height) {
+				bucket.array->SetLayer(layer, image);
+			}
+			else {
+				cv::Mat resampled;
+				cv::resize(image, resampled, cv::Size(bucket.width, bucket.height), 0, 0, cv::INTER_LINEAR);
+				ImageTexture::AddCopiedBytes(resampled.total() * resampled.elemSize());
+				bucket.array->SetLayer(layer, resampled);
+				++numResampled;
+			}
+			images[layer].release();
+		}
+	}
+	buckets.erase(std::remove_if(buckets.begin(), buckets.end(), [](const Bucket& b) { return b.array == nullptr; }),
+				  buckets.end());
+
+	// Point every material at its layer.
+	for (PhongMaterial* material : materials) {
+		material->SetMapKdLayer(nullptr, 0);
+		for (const auto& bucket : buckets) {
+			for (int layer = 0; layer < (int)bucket.textures.size(); ++layer) {
+				if (bucket.textures[layer]->GetPath() == material->GetMapKd()->GetPath())
+					material->SetMapKdLayer(bucket.array, layer);
+			}
+		}
+	}
+}
+
+void TextureArrayBuilder::Clear()
+{
+	for (PhongMaterial* material : materials)
+		material->SetMapKdLayer(nullptr, 0);
+	materials.clear();
+	buckets.clear();
+	for (auto array : arrays)
+		delete array;
+	arrays.clear();
+}
+
+void TextureArrayBuilder::ShowInfo() const
+{
+	size_t totalBytes = 0;
+	int numLayers = 0;
+	for (const auto& bucket : buckets) {
+		std::cout << "Texture array " << bucket.width << " x " << bucket.height << " x " << bucket.channels
+				  << ": " << bucket.textures.size() << " layers" << std::endl;
+		totalBytes += bucket.array->GetSizeInBytes();
+		numLayers += (int)bucket.textures.size();
+	}
+	std::cout << "Texture arrays: " << arrays.size() << " arrays, " << numLayers << " layers, "
+			  << numResampled << " resampled, " << totalBytes / 1024 << " KB" << std::endl;
+}
+
+int TextureArrayBuilder::NextPowerOfTwo(const int value)
+{
+	int p = 1;
+	while (p < value)
+		p *= 2;
+	return p;
+}
@@ -0,0 +1,80 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include "headers.h"
+#include "imagetexture.h"
+
+class PhongMaterial;
+
+// TextureArray Declarations.
+// A GL_TEXTURE_2D_ARRAY whose layers all have the same size and channel count.
+class TextureArray
+{
+public:
+	// TextureArray Public Methods.
+	TextureArray(const int width, const int height, const int channels, const int layers);
+	~TextureArray();
+
+	// Fill one layer with a level 0 image of exactly the array size; mip levels are built on the CPU.
+	void SetLayer(const int layer, const cv::Mat& image);
+	void Bind(GLenum textureUnit);
+
+	int GetWidth() const { return arrayWidth; }
+	int GetHeight() const { return arrayHeight; }
+	int GetNumLayers() const { return numLayers; }
+	size_t GetSizeInBytes() const { return sizeInBytes; }
+
+private:
+	// TextureArray Private Data.
+	GLuint textureObj;
+	int arrayWidth;
+	int arrayHeight;
+	int numChannels;
+	int numLayers;
+	int numMipLevels;
+	size_t sizeInBytes;
+};
+
+// ------------------------------------------------------------------------------------------------
+
+// TextureArrayBuilder Declarations.
+// Groups the diffuse textures of a scene into texture arrays. Textures are bucketed by
+// channel count and power-of-two size; a texture whose size is not a power of two is
+// resampled to its bucket size, which keeps normalized UVs and wrap modes unchanged.
+class TextureArrayBuilder
+{
+public:
+	// TextureArrayBuilder Public Methods.
+	TextureArrayBuilder();
+	~TextureArrayBuilder();
+
+	void AddMaterial(PhongMaterial* material);
+	// Create the arrays and assign every registered material its array and layer.
+	void Build();
+	void Clear();
+
+	int GetNumArrays() const { return (int)arrays.size(); }
+	void ShowInfo() const;
+
+private:
+	// TextureArrayBuilder Private Types.
+	struct Bucket
+	{
+		int width;
+		int height;
+		int channels;
+		std::vector<ImageTexture*> textures;
+		TextureArray* array;
+	};
+
+	// TextureArrayBuilder Private Methods.
+	static int NextPowerOfTwo(const int value);
+
+	// TextureArrayBuilder Private Data.
+	std::vector<PhongMaterial*> materials;
+	std::vector<Bucket> buckets;
+	std::vector<TextureArray*> arrays;
+	int numResampled;
+};
+
+#endif
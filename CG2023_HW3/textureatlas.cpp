@@ -0,0 +1,226 @@
+#include "textureatlas.h"
+#include "textureresidency.h"
+#include "mipgenerator.h"
+
+#include <algorithm>
+#include <cstring>
+
+static int RoundUp(const int value, const int multiple)
+{
+	return ((value + multiple - 1) / multiple) * multiple;
+}
+
+TextureAtlas::TextureAtlas()
+{
+	textureObj = 0;
+	atlasWidth = 0;
+	atlasHeight = 0;
+	numChannels = 0;
+	numMipLevels = 0;
+	atlasBytes = 0;
+	sourceBytes = 0;
+	usedTexels = 0;
+}
+
+TextureAtlas::~TextureAtlas()
+{
+	TextureResidency::RemoveFixedBytes(atlasBytes);
+	glDeleteTextures(1, &textureObj);
+	regions.clear();
+}
+
+bool TextureAtlas::Build(const std::vector<ImageTexture*>& textures, const int gutterLevels)
+{
+	TRACE_ZONE("Build atlas");
+	regions.clear();
+	numChannels = 0;
+	sourceBytes = 0;
+	usedTexels = 0;
+
+	// Collect the distinct textures; several materials may reference the same image file.
+	for (ImageTexture* texture : textures) {
+		if (texture == nullptr || !texture->IsValid() || Contains(texture))
+			continue;
+		cv::Mat image;
+		if (!texture->ReadImage(image))
+			continue;
+		if (numChannels == 0)
+			numChannels = image.channels();
+		if (image.channels() != numChannels) {
+			std::cerr << "[WARNING] Texture atlas skipped: mixed channel counts in " << texture->GetPath() << std::endl;
+			regions.clear();
+			return false;
+		}
+		Region region;
+		region.texture = texture;
+		region.image = image;
+		region.x = region.y = 0;
+		region.width = image.cols;
+		region.height = image.rows;
+		regions.push_back(region);
+		sourceBytes += image.total() * image.elemSize() * 4 / 3;
+		usedTexels += image.total();
+	}
+	// Nothing to save with fewer than two textures.
+	if (regions.size() < 2) {
+		regions.clear();
+		return false;
+	}
+
+	// Tallest first gives the tightest shelves.
+	std::sort(regions.begin(), regions.end(), [](const Region& a, const Region& b) {
+		return a.height > b.height;
+	});
+
+	// Try every power-of-two width and keep the smallest atlas.
+	GLint maxTextureSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	const int gutter = 1 << gutterLevels;
+	size_t bestArea = std::numeric_limits<size_t>::max();
+	int bestWidth = 0;
+	for (int width = gutter; width <= maxTextureSize; width *= 2) {
+		int height = 0;
+		if (!PackShelves(regions, gutter, width, height) || height > maxTextureSize)
+			continue;
+		const size_t area = (size_t)width * (size_t)height;
+		if (area < bestArea) {
+			bestArea = area;
+			bestWidth = width;
+		}
+	}
+	if (bestWidth == 0) {
+		std::cerr << "[WARNING] Texture atlas skipped: textures do not fit in " << maxTextureSize << "^2" << std::endl;
+		regions.clear();
+		return false;
+	}
+	atlasWidth = bestWidth;
+	PackShelves(regions, gutter, atlasWidth, atlasHeight);
+
+	// Compose level 0. Each region is extended by half a gutter on every side with
+	// wrapped texels, which keeps GL_REPEAT-like filtering across its own edges.
+	cv::Mat atlas(atlasHeight, atlasWidth, CV_MAKETYPE(CV_8U, numChannels));
+	std::memset(atlas.ptr(), 0, atlas.total() * atlas.elemSize());
+	const int border = gutter / 2;
+	for (const Region& region : regions) {
+		const cv::Mat& image = region.image;
+		const size_t pixelBytes = image.elemSize();
+		for (int y = region.y - border; y < region.y + region.height + border; ++y) {
+			const int sy = ((y - region.y) % region.height + region.height) % region.height;
+			const unsigned char* src = image.ptr(sy);
+			unsigned char* dst = atlas.ptr(y);
+			for (int x = region.x - border; x < region.x + region.width + border; ++x) {
+				const int sx = ((x - region.x) % region.width + region.width) % region.width;
+				std::memcpy(dst + x * pixelBytes, src + sx * pixelBytes, pixelBytes);
+			}
+		}
+	}
+	ImageTexture::AddCopiedBytes(atlas.total() * atlas.elemSize());
+
+	// Only the levels that still have at least one gutter texel between regions are kept.
+	MipChain chain;
+	MipGenerator::Generate(atlas, MipFilter::Box, chain, gutterLevels);
+	numMipLevels = chain.GetNumLevels();
+
+	GLenum format = GL_BGR;
+	GLint internalFormat = GL_RGB;
+	if (numChannels == 1) {
+		format = GL_RED;
+		internalFormat = GL_RED;
+	}
+	else if (numChannels == 4) {
+		format = GL_BGRA;
+		internalFormat = GL_RGBA;
+	}
+	if (textureObj == 0)
+		glGenTextures(1, &textureObj);
+	glBindTexture(GL_TEXTURE_2D, textureObj);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	TextureResidency::RemoveFixedBytes(atlasBytes);
+	atlasBytes = 0;
+	for (int level = 0; level < numMipLevels; ++level) {
+		const cv::Mat& image = chain.levels[level];
+		glTexImage2D(GL_TEXTURE_2D, level, internalFormat, image.cols, image.rows,
+						0, format, GL_UNSIGNED_BYTE, image.ptr());
+		atlasBytes += image.total() * image.elemSize();
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	TextureResidency::AddFixedBytes(atlasBytes);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numMipLevels - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// The CPU copies were only needed for composing.
+	for (Region& region : regions)
+		region.image.release();
+
+	return true;
+}
+
+void TextureAtlas::Bind(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_2D, textureObj);
+}
+
+bool TextureAtlas::Contains(const ImageTexture* texture) const
+{
+	if (texture == nullptr)
+		return false;
+	for (const Region& region : regions) {
+		if (region.texture == texture || region.texture->GetPath() == texture->GetPath())
+			return true;
+	}
+	return false;
+}
+
+glm::vec4 TextureAtlas::GetUVTransform(const ImageTexture* texture) const
+{
+	for (const Region& region : regions) {
+		if (region.texture == texture || region.texture->GetPath() == texture->GetPath()) {
+			return glm::vec4((float)region.width / (float)atlasWidth, (float)region.height / (float)atlasHeight,
+							 (float)region.x / (float)atlasWidth, (float)region.y / (float)atlasHeight);
+		}
+	}
+	return glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+}
+
+void TextureAtlas::ShowInfo(const int numTexturedSubMeshes) const
+{
+	const double occupancy = 100.0 * (double)usedTexels / ((double)atlasWidth * (double)atlasHeight);
+	std::cout << "Texture atlas: " << regions.size() << " textures in " << atlasWidth << " x " << atlasHeight
+			  << " (" << numMipLevels << " levels)" << std::endl;
+	std::cout << "Atlas occupancy: " << std::fixed << std::setprecision(1) << occupancy << "%" << std::endl;
+	std::cout << "Atlas memory: " << atlasBytes / 1024 << " KB (separate textures: " << sourceBytes / 1024 << " KB)" << std::endl;
+	std::cout.unsetf(std::ios_base::floatfield);
+	std::cout << "Texture binds per frame: " << numTexturedSubMeshes << " -> 1 ("
+			  << std::max(0, numTexturedSubMeshes - 1) << " eliminated)" << std::endl;
+}
+
+bool TextureAtlas::PackShelves(std::vector<Region>& regions, const int gutter, const int atlasWidth, int& usedHeight)
+{
+	// Region origins and sizes are rounded to the gutter size, with one gutter between regions.
+	int x = gutter;
+	int y = gutter;
+	int shelfHeight = 0;
+	for (Region& region : regions) {
+		const int cellWidth = RoundUp(region.width, gutter) + gutter;
+		const int cellHeight = RoundUp(region.height, gutter) + gutter;
+		if (cellWidth + gutter > atlasWidth)
+			return false;
+		if (x + cellWidth > atlasWidth) {
+			x = gutter;
+			y += shelfHeight;
+			shelfHeight = 0;
+		}
+		region.x = x;
+		region.y = y;
+		x += cellWidth;
+		shelfHeight = std::max(shelfHeight, cellHeight);
+	}
+	usedHeight = y + shelfHeight;
+	return true;
+}
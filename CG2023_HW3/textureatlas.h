@@ -0,0 +1,59 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include "headers.h"
+#include "imagetexture.h"
+
+// TextureAtlas Declarations.
+// Packs the diffuse textures of one model into a single texture so that the whole
+// model draws with one bind. Each packed texture gets a UV transform
+// (xy: scale, zw: offset) that maps its [0, 1] range into its atlas region.
+class TextureAtlas
+{
+public:
+	// TextureAtlas Public Methods.
+	TextureAtlas();
+	~TextureAtlas();
+
+	// Pack the textures (duplicates are packed once). Every region is surrounded by a
+	// gutter of 2^gutterLevels texels and aligned to the same size, so the first
+	// gutterLevels mip levels never mix two regions.
+	bool Build(const std::vector<ImageTexture*>& textures, const int gutterLevels = 4);
+
+	void Bind(GLenum textureUnit);
+	bool Contains(const ImageTexture* texture) const;
+	glm::vec4 GetUVTransform(const ImageTexture* texture) const;
+
+	int GetWidth() const { return atlasWidth; }
+	int GetHeight() const { return atlasHeight; }
+	int GetNumRegions() const { return (int)regions.size(); }
+
+	// Print occupancy, memory and the number of texture binds saved per frame.
+	void ShowInfo(const int numTexturedSubMeshes) const;
+
+private:
+	// TextureAtlas Private Types.
+	struct Region
+	{
+		const ImageTexture* texture;
+		cv::Mat image;		// Level 0, read back from the texture while building.
+		int x, y;			// First texel of the texture inside the atlas (without gutter).
+		int width, height;
+	};
+
+	// TextureAtlas Private Methods.
+	static bool PackShelves(std::vector<Region>& regions, const int gutter, const int atlasWidth, int& usedHeight);
+
+	// TextureAtlas Private Data.
+	GLuint textureObj;
+	int atlasWidth;
+	int atlasHeight;
+	int numChannels;
+	int numMipLevels;
+	size_t atlasBytes;
+	size_t sourceBytes;
+	size_t usedTexels;
+	std::vector<Region> regions;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "texturecache.h"
+
+// Cache file layout: header, then every level's pixels from level 0 down to 1x1.
+static const uint32_t kCacheMagic = 0x4350494d;	// "MIPC".
+// Version 2: levels are stored top row first (no vertical flip).
+static const uint32_t kCacheVersion = 2;
+
+struct TextureCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t filter;
+	uint32_t channels;
+	uint32_t width;
+	uint32_t height;
+	uint32_t numLevels;
+	uint32_t reserved;
+	uint64_t sourceSize;
+	uint64_t sourceHash;
+};
+
+bool TextureCache::Load(const std::string& sourcePath, const MipFilter filter, MipChain& chain)
+{
+	std::ifstream cacheFile(GetCachePath(sourcePath), std::ios::binary);
+	if (!cacheFile.is_open())
+		return false;
+
+	TextureCacheHeader header;
+	if (!cacheFile.read((char*)&header, sizeof(header)))
+		return false;
+	if (header.magic != kCacheMagic || header.version != kCacheVersion || header.filter != (uint32_t)filter)
+		return false;
+	if (header.channels == 0 || header.channels > 4 || header.width == 0 || header.height == 0)
+		return false;
+	if (header.numLevels != (uint32_t)MipGenerator::GetNumLevels(header.width, header.height))
+		return false;
+
+	// Stale entry if the source image changed since the cache was written.
+	uint64_t sourceSize = 0;
+	uint64_t sourceHash = 0;
+	if (!GetSourceKey(sourcePath, sourceSize, sourceHash))
+		return false;
+	if (header.sourceSize != sourceSize || header.sourceHash != sourceHash)
+		return false;
+
+	const int type = CV_MAKETYPE(CV_8U, (int)header.channels);
+	int width = (int)header.width;
+	int height = (int)header.height;
+	chain.levels.resize(header.numLevels);
+	for (uint32_t level = 0; level < header.numLevels; ++level) {
+		cv::Mat& image = chain.levels[level];
+		image.create(height, width, type);
+		const size_t bytes = image.total() * image.elemSize();
+		if (!cacheFile.read((char*)image.ptr(), (std::streamsize)bytes)) {
+			chain.levels.clear();
+			return false;
+		}
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+	}
+	return true;
+}
+
+bool TextureCache::Save(const std::string& sourcePath, const MipFilter filter, const MipChain& chain)
+{
+	if (chain.levels.empty())
+		return false;
+
+	TextureCacheHeader header;
+	header.magic = kCacheMagic;
+	header.version = kCacheVersion;
+	header.filter = (uint32_t)filter;
+	header.channels = (uint32_t)chain.levels[0].channels();
+	header.width = (uint32_t)chain.levels[0].cols;
+	header.height = (uint32_t)chain.levels[0].rows;
+	header.numLevels = (uint32_t)chain.levels.size();
+	header.reserved = 0;
+	if (!GetSourceKey(sourcePath, header.sourceSize, header.sourceHash))
+		return false;
+
+	std::ofstream cacheFile(GetCachePath(sourcePath), std::ios::binary | std::ios::trunc);
+	if (!cacheFile.is_open()) {
+		std::cerr << "[WARNING] Failed to write texture cache: " << GetCachePath(sourcePath) << std::endl;
+		return false;
+	}
+	cacheFile.write((const char*)&header, sizeof(header));
+	for (const auto& image : chain.levels) {
+		// Levels are created by MipGenerator, hence continuous.
+		cacheFile.write((const char*)image.ptr(), (std::streamsize)(image.total() * image.elemSize()));
+	}
+	return cacheFile.good();
+}
+
+uint64_t TextureCache::HashBytes(const void* data, const size_t size, uint64_t hash)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool TextureCache::GetSourceKey(const std::string& sourcePath, uint64_t& size, uint64_t& hash)
+{
+	// Hash the encoded file: much cheaper than decoding it.
+	std::ifstream sourceFile(sourcePath, std::ios::binary);
+	if (!sourceFile.is_open())
+		return false;
+	std::vector<char> content((std::istreambuf_iterator<char>(sourceFile)), std::istreambuf_iterator<char>());
+	size = (uint64_t)content.size();
+	hash = HashBytes(content.data(), content.size());
+	return true;
+}
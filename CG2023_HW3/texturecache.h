@@ -0,0 +1,26 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "headers.h"
+#include "mipgenerator.h"
+
+#include <cstdint>
+
+// TextureCache Declarations.
+// Stores prebuilt mip chains next to the source image ("<image>.mipcache").
+// An entry is only valid for the exact source file content and filter it was built from.
+class TextureCache
+{
+public:
+	// TextureCache Public Methods.
+	static bool Load(const std::string& sourcePath, const MipFilter filter, MipChain& chain);
+	static bool Save(const std::string& sourcePath, const MipFilter filter, const MipChain& chain);
+	static std::string GetCachePath(const std::string& sourcePath) { return sourcePath + ".mipcache"; }
+
+	// 64-bit FNV-1a hash of a block of memory.
+	static uint64_t HashBytes(const void* data, const size_t size, uint64_t hash = 14695981039346656037ull);
+	// Size and hash of a file's content; cache entries built from it store both.
+	static bool GetSourceKey(const std::string& sourcePath, uint64_t& size, uint64_t& hash);
+};
+
+#endif
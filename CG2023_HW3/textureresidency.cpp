@@ -0,0 +1,138 @@
+#include "textureresidency.h"
+#include "imagetexture.h"
+
+size_t TextureResidency::budgetBytes = (size_t)512 * 1024 * 1024;
+unsigned int TextureResidency::frameIndex = 0;
+TextureResidency::Counters TextureResidency::counters = { 0, 0, 0, 0, 0, 0, 0 };
+std::list<ImageTexture*> TextureResidency::lru;
+std::unordered_map<ImageTexture*, TextureResidency::Entry> TextureResidency::entries;
+
+void TextureResidency::SetBudget(const size_t bytes)
+{
+	budgetBytes = bytes;
+	EnforceBudget();
+}
+
+void TextureResidency::Register(ImageTexture* texture)
+{
+	if (texture == nullptr || entries.count(texture) != 0)
+		return;
+	lru.push_front(texture);
+	Entry entry;
+	entry.lruPos = lru.begin();
+	entry.bytes = texture->GetResidentBytes();
+	entry.lastBoundFrame = frameIndex;
+	entries[texture] = entry;
+	counters.numTextures++;
+	counters.residentBytes += entry.bytes;
+	if (entry.bytes > 0)
+		counters.numResident++;
+	EnforceBudget();
+}
+
+void TextureResidency::Unregister(ImageTexture* texture)
+{
+	auto found = entries.find(texture);
+	if (found == entries.end())
+		return;
+	counters.numTextures--;
+	counters.residentBytes -= found->second.bytes;
+	if (found->second.bytes > 0)
+		counters.numResident--;
+	lru.erase(found->second.lruPos);
+	entries.erase(found);
+}
+
+void TextureResidency::Touch(ImageTexture* texture)
+{
+	auto found = entries.find(texture);
+	if (found == entries.end())
+		return;
+
+	// Bring back whatever was released since the last bind.
+	if (!texture->IsFullyResident()) {
+		if (texture->Restore())
+			counters.reloads++;
+		UpdateSize(texture);
+	}
+
+	Entry& entry = found->second;
+	lru.splice(lru.begin(), lru, entry.lruPos);
+	entry.lastBoundFrame = frameIndex;
+	EnforceBudget();
+}
+
+void TextureResidency::UpdateSize(ImageTexture* texture)
+{
+	auto found = entries.find(texture);
+	if (found == entries.end())
+		return;
+	Entry& entry = found->second;
+	const size_t bytes = texture->GetResidentBytes();
+	if (entry.bytes > 0)
+		counters.numResident--;
+	if (bytes > 0)
+		counters.numResident++;
+	counters.residentBytes = counters.residentBytes - entry.bytes + bytes;
+	entry.bytes = bytes;
+}
+
+void TextureResidency::AddFixedBytes(const size_t bytes)
+{
+	counters.fixedBytes += bytes;
+	counters.residentBytes += bytes;
+	EnforceBudget();
+}
+
+void TextureResidency::RemoveFixedBytes(const size_t bytes)
+{
+	counters.fixedBytes -= bytes;
+	counters.residentBytes -= bytes;
+}
+
+void TextureResidency::ShowInfo()
+{
+	std::cout << "------------------------------" << std::endl;
+	std::cout << "Texture residency" << std::endl;
+	std::cout << "Budget: " << budgetBytes / (1024 * 1024) << " MB" << std::endl;
+	std::cout << "Resident: " << counters.residentBytes / (1024 * 1024) << " MB ("
+			  << counters.fixedBytes / (1024 * 1024) << " MB atlases/arrays)" << std::endl;
+	std::cout << "Textures: " << counters.numResident << " / " << counters.numTextures << " resident" << std::endl;
+	std::cout << "Evictions: " << counters.evictions << " textures, " << counters.mipEvictions << " mip levels" << std::endl;
+	std::cout << "Reloads: " << counters.reloads << std::endl;
+	std::cout << "------------------------------" << std::endl;
+}
+
+void TextureResidency::EnforceBudget()
+{
+	while (counters.residentBytes > budgetBytes) {
+		// First give up top mip levels, one level per texture per pass, oldest first.
+		bool progress = false;
+		for (auto it = lru.rbegin(); it != lru.rend() && counters.residentBytes > budgetBytes; ++it) {
+			ImageTexture* texture = *it;
+			if (entries[texture].lastBoundFrame == frameIndex || !texture->CanDropTopLevel())
+				continue;
+			texture->DropTopLevel();
+			counters.mipEvictions++;
+			UpdateSize(texture);
+			progress = true;
+		}
+		if (progress)
+			continue;
+
+		// Only small levels left: release whole textures, oldest first.
+		for (auto it = lru.rbegin(); it != lru.rend() && counters.residentBytes > budgetBytes; ++it) {
+			ImageTexture* texture = *it;
+			if (entries[texture].lastBoundFrame == frameIndex || entries[texture].bytes == 0)
+				continue;
+			texture->Evict();
+			counters.evictions++;
+			UpdateSize(texture);
+			progress = true;
+		}
+		if (!progress) {
+			// Everything left is in use this frame.
+			break;
+		}
+	}
+}
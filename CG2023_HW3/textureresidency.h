@@ -0,0 +1,69 @@
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include "headers.h"
+
+#include <list>
+#include <unordered_map>
+
+class ImageTexture;
+
+// TextureResidency Declarations.
+// Keeps the GPU memory of all ImageTextures under a budget. When a bind would exceed it,
+// the least recently bound textures first lose their top mip level, then are evicted
+// entirely. Textures bound in the current frame are never touched. An evicted or
+// reduced texture is reloaded (from its mip cache) the next time it is bound.
+// Derived textures (atlases, texture arrays) are counted but never evicted.
+class TextureResidency
+{
+public:
+	// TextureResidency Public Types.
+	struct Counters
+	{
+		size_t residentBytes;	// Managed textures plus fixed allocations.
+		size_t fixedBytes;
+		int numTextures;
+		int numResident;		// Managed textures with GPU storage.
+		int evictions;			// Whole textures released.
+		int mipEvictions;		// Top mip levels released.
+		int reloads;
+	};
+
+	// TextureResidency Public Methods.
+	static void SetBudget(const size_t bytes);
+	static size_t GetBudget() { return budgetBytes; }
+
+	static void Register(ImageTexture* texture);
+	static void Unregister(ImageTexture* texture);
+	// Call before binding: restores the texture if needed and marks it most recently used.
+	static void Touch(ImageTexture* texture);
+	// Call whenever the GPU size of a registered texture changed.
+	static void UpdateSize(ImageTexture* texture);
+	static void AddFixedBytes(const size_t bytes);
+	static void RemoveFixedBytes(const size_t bytes);
+	static void BeginFrame() { ++frameIndex; }
+
+	static const Counters& GetCounters() { return counters; }
+	static void ShowInfo();
+
+private:
+	// TextureResidency Private Types.
+	struct Entry
+	{
+		std::list<ImageTexture*>::iterator lruPos;
+		size_t bytes;
+		unsigned int lastBoundFrame;
+	};
+
+	// TextureResidency Private Methods.
+	static void EnforceBudget();
+
+	// TextureResidency Private Data.
+	static size_t budgetBytes;
+	static unsigned int frameIndex;
+	static Counters counters;
+	static std::list<ImageTexture*> lru;	// Most recently bound first.
+	static std::unordered_map<ImageTexture*, Entry> entries;
+};
+
+#endif
@@ -1,89 +1,185 @@
-#ifndef TRIANGLEMESH_H
-#define TRIANGLEMESH_H
-
-#include "headers.h"
-#include "material.h"
-
-// VertexPTN Declarations.
-struct VertexPTN
-{
-	VertexPTN() {
-		position = glm::vec3(0.0f, 0.0f, 0.0f);
-		normal = glm::vec3(0.0f, 1.0f, 0.0f);
-		texcoord = glm::vec2(0.0f, 0.0f);
-	}
-	VertexPTN(glm::vec3 p, glm::vec3 n, glm::vec2 uv) {
-		position = p;
-		normal = n;
-		texcoord = uv;
-	}
-	glm::vec3 position;
-	glm::vec3 normal;
-	glm::vec2 texcoord;
-};
-
-// SubMesh Declarations.
-struct SubMesh
-{
-	SubMesh() {
-		material = nullptr;
-		iboId = 0;
-	}
-	PhongMaterial* material;
-	GLuint iboId;
-	std::vector<unsigned int> vertexIndices;
-};
-
-
-// TriangleMesh Declarations.
-class TriangleMesh
-{
-public:
-	// TriangleMesh Public Methods.
-	TriangleMesh();
-	~TriangleMesh();
-
-	// Load the model from an *.OBJ file.
-	bool LoadFromFile(const std::string& filePath, const bool normalized = true);
-
-	// Create Buffers.
-	void CreateBuffers();
-	// Render a single subMesh.
-	void RenderSubMesh(SubMesh subMesh);
-
-	// Show model information.
-	void ShowInfo();
-
-	// -------------------------------------------------------
-	// Feel free to add your methods or data here.
-	// -------------------------------------------------------
-	int GetNumVertices() const { return numVertices; }
-	int GetNumTriangles() const { return numTriangles; }
-	int GetNumSubMeshes() const { return (int)subMeshes.size(); }
-	std::vector<SubMesh> GetSubMeshes() const { return subMeshes; }
-
-	glm::vec3 GetObjCenter() const { return objCenter; }
-	glm::vec3 GetObjExtent() const { return objExtent; }
-
-private:
-	// -------------------------------------------------------
-	// Feel free to add your methods or data here.
-	// -------------------------------------------------------
-
-	// TriangleMesh Private Data.
-	GLuint vboId;
-
-	std::vector<VertexPTN> vertices;
-	std::vector<SubMesh> subMeshes;
-	// For supporting multiple materials per object, move to SubMesh.
-	// GLuint iboId;
-	// std::vector<unsigned int> vertexIndices;
-
-	int numVertices;
-	int numTriangles;
-	glm::vec3 objCenter;
-	glm::vec3 objExtent;
-};
-
-
-#endif
+#ifndef TRIANGLEMESH_H
+#define TRIANGLEMESH_H
+
+#include "headers.h"
+#include "material.h"
+#include "textureatlas.h"
+#include "vertexlayout.h"
+#include "aabb.h"
+
+#include <cstdint>
+#include <unordered_map>
+
+// VertexPTN Declarations.
+struct VertexPTN
+{
+	VertexPTN() {
+		position = glm::vec3(0.0f, 0.0f, 0.0f);
+		normal = glm::vec3(0.0f, 1.0f, 0.0f);
+		texcoord = glm::vec2(0.0f, 0.0f);
+	}
+	VertexPTN(glm::vec3 p, glm::vec3 n, glm::vec2 uv) {
+		position = p;
+		normal = n;
+		texcoord = uv;
+	}
+	// Attribute layout: position (0), normal (1), texcoord (2).
+	static void SetLayout(const GLuint vboId) {
+		const VertexAttribute attributes[] = {
+			VERTEX_ATTRIBUTE(0, VertexPTN, position),
+			VERTEX_ATTRIBUTE(1, VertexPTN, normal),
+			VERTEX_ATTRIBUTE(2, VertexPTN, texcoord)
+		};
+		SetVertexLayout<VertexPTN>(vboId, attributes);
+	}
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texcoord;
+};
+
+// InstanceData Declarations.
+// Per-instance attributes of an instanced draw; a matrix takes one location per column.
+struct InstanceData
+{
+	// Attribute layout: world matrix (3 to 6), normal matrix (7 to 10).
+	static void SetLayout(const GLuint vboId) {
+		const size_t column = sizeof(glm::vec4);
+		const size_t world = offsetof(InstanceData, worldMatrix);
+		const size_t normal = offsetof(InstanceData, normalMatrix);
+		const VertexAttribute attributes[] = {
+			{ 3, 4, world }, { 4, 4, world + column }, { 5, 4, world + 2 * column }, { 6, 4, world + 3 * column },
+			{ 7, 4, normal }, { 8, 4, normal + column }, { 9, 4, normal + 2 * column }, { 10, 4, normal + 3 * column }
+		};
+		SetInstanceLayout<InstanceData>(vboId, attributes);
+	}
+	glm::mat4x4 worldMatrix;
+	glm::mat4x4 normalMatrix;		// Inverse transpose of worldMatrix.
+};
+
+// SubMesh Declarations.
+struct SubMesh
+{
+	SubMesh() {
+		material = nullptr;
+		firstIndex = 0;
+	}
+	PhongMaterial* material;
+	// Start of the subMesh's range in the mesh's index buffer.
+	GLuint firstIndex;
+	std::vector<unsigned int> vertexIndices;
+	// Of its vertices in model space, after normalization.
+	Aabb bounds;
+};
+
+// DrawCommand Declarations.
+// A subMesh reduced to what drawing it takes, compiled once by TriangleMesh::CompileDrawList().
+struct DrawCommand
+{
+	enum Flags
+	{
+		HasMapKd = 1,
+		InTextureArray = 2
+	};
+	GLsizei numIndices;
+	GLuint firstIndex;
+	int materialSlot;				// Entry in the material buffer.
+	uint32_t flags;
+	// Small ordinals of mapKd and mapKdArray within the mesh, for sort keys (0 if none).
+	uint16_t mapKdKey;
+	uint16_t arrayKey;
+	ImageTexture* mapKd;
+	TextureArray* mapKdArray;
+	const PhongMaterial* material;	// For the per-draw uniform path.
+};
+
+
+// TriangleMesh Declarations.
+class TriangleMesh
+{
+public:
+	// TriangleMesh Public Methods.
+	TriangleMesh();
+	~TriangleMesh();
+
+	// Load the model from an *.OBJ file.
+	bool LoadFromFile(const std::string& filePath, const bool normalized = true);
+
+	// Create Buffers and the vertex array object that records their layout.
+	void CreateBuffers();
+	// Pack the diffuse textures into one atlas and set each material's UV transform.
+	bool BuildTextureAtlas();
+	// Compile the draw list and the material buffer from the subMeshes. Call again when the
+	// materials change (their atlas regions or texture arrays).
+	void CompileDrawList();
+	// Bind the block of the material buffer holding subMeshes [block * N, block * N + N),
+	// N = PhongShadingDemoShaderProg::maxMaterialsPerBlock.
+	void BindMaterialBlock(const int block) const;
+	// Render a single subMesh (its range of the index buffer).
+	void RenderSubMesh(const SubMesh& subMesh);
+	// Upload the world matrices of the copies drawn by an instanced draw (and their normal
+	// matrices) to the instance buffer, which the vertex array object reads per instance.
+	void SetInstances(const std::vector<glm::mat4x4>& worldMatrices);
+	int GetNumInstances() const { return numInstances; }
+
+	// Show model information.
+	void ShowInfo();
+
+	// -------------------------------------------------------
+	// Feel free to add your methods or data here.
+	// -------------------------------------------------------
+	int GetNumVertices() const { return numVertices; }
+	int GetNumTriangles() const { return numTriangles; }
+	int GetNumSubMeshes() const { return (int)subMeshes.size(); }
+	const std::vector<SubMesh>& GetSubMeshes() const { return subMeshes; }
+	// One command per subMesh, in subMesh order.
+	const std::vector<DrawCommand>& GetDrawList() const { return drawList; }
+	// Ordinal of a texture of the mesh (mapKd or texture array) for sort keys, 0 if unknown.
+	uint16_t GetTextureKey(const void* texture) const;
+	TextureAtlas* GetAtlas() const { return atlas; }
+	// The vertex array object, which also holds the index buffer of all subMeshes.
+	GLuint GetVaoId() const { return vaoId; }
+	GLuint GetIboId() const { return iboId; }
+
+	glm::vec3 GetObjCenter() const { return objCenter; }
+	glm::vec3 GetObjExtent() const { return objExtent; }
+	// Bounds of all subMeshes, in model space.
+	const Aabb& GetBounds() const { return bounds; }
+
+private:
+	// -------------------------------------------------------
+	// Feel free to add your methods or data here.
+	// -------------------------------------------------------
+	void UpdateMaterialBuffer();
+
+	// TriangleMesh Private Data.
+	GLuint vaoId;
+	GLuint vboId;
+	GLuint iboId;
+	TextureAtlas* atlas;
+	// Material buffer: numMaterialBlocks blocks, materialBlockStride bytes apart.
+	GLuint materialUbo;
+	GLintptr materialBlockStride;
+	int numMaterialBlocks;
+	std::vector<DrawCommand> drawList;
+	std::unordered_map<const void*, uint16_t> textureKeys;
+	// Instance buffer, with room for instanceCapacity instances.
+	GLuint instanceVbo;
+	int numInstances;
+	int instanceCapacity;
+	std::vector<InstanceData> instanceData;
+
+	std::vector<VertexPTN> vertices;
+	std::vector<SubMesh> subMeshes;
+	// For supporting multiple materials per object, move to SubMesh.
+	// GLuint iboId;
+	// std::vector<unsigned int> vertexIndices;
+
+	int numVertices;
+	int numTriangles;
+	glm::vec3 objCenter;
+	glm::vec3 objExtent;
+	Aabb bounds;
+};
+
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include "headers.h"
+
+#include <cstddef>
+
+// VertexAttribute Declarations.
+// One float attribute of an interleaved vertex struct. Build them with VERTEX_ATTRIBUTE so
+// that the number of components and the offset come from the struct member itself.
+struct VertexAttribute
+{
+	GLuint location;
+	GLint numComponents;
+	size_t offset;
+};
+
+#define VERTEX_ATTRIBUTE(location, Vertex, member) \
+	VertexAttribute{ (location), (GLint)(sizeof(Vertex::member) / sizeof(float)), offsetof(Vertex, member) }
+
+// Record a vertex buffer and the layout of its vertices in the bound vertex array object.
+template <typename Vertex, size_t N>
+void SetVertexLayout(const GLuint vboId, const VertexAttribute (&attributes)[N])
+{
+	glBindBuffer(GL_ARRAY_BUFFER, vboId);
+	for (const auto& attribute : attributes) {
+		glEnableVertexAttribArray(attribute.location);
+		glVertexAttribPointer(attribute.location, attribute.numComponents, GL_FLOAT, GL_FALSE,
+							  sizeof(Vertex), (const GLvoid*)attribute.offset);
+	}
+}
+
+// The same for a buffer of per-instance data: the attributes advance once per instance.
+template <typename Instance, size_t N>
+void SetInstanceLayout(const GLuint vboId, const VertexAttribute (&attributes)[N])
+{
+	SetVertexLayout<Instance>(vboId, attributes);
+	for (const auto& attribute : attributes)
+		glVertexAttribDivisor(attribute.location, 1);
+}
+
+#endif
@@ -0,0 +1,553 @@
+#include "virtualtexture.h"
+#include "texturecache.h"
+#include "textureresidency.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+const int VirtualTexture::kTileSize;
+const int VirtualTexture::kSlotSize;
+const int VirtualTexture::kDefaultPages;
+const int VirtualTexture::kMaxUploadsPerFrame;
+const int VirtualTexture::kMaxLevels;
+
+// Screen rays traced per frame along the longer viewport side to find the visible tiles.
+static const int kFeedbackGrid = 96;
+
+// Tile file layout: header, then the tiles of every level (finest first) in row order,
+// kSlotSize x kSlotSize BGR texels each.
+static const uint32_t kTileMagic = 0x58455456;	// "VTEX".
+static const uint32_t kTileVersion = 1;
+
+struct TileFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t numLevels;
+	uint32_t tileSize;
+	uint64_t sourceSize;
+	uint64_t sourceHash;
+};
+
+static const size_t kSlotBytes = (size_t)VirtualTexture::kSlotSize * VirtualTexture::kSlotSize * 3;
+
+static int RoundToPowerOfTwo(const int n)
+{
+	return 1 << (int)std::lround(std::log2((double)std::max(1, n)));
+}
+
+// Equirectangular coordinates of a direction, same mapping as the cube map conversion.
+static inline glm::vec2 DirectionToUV(const glm::vec3& dir)
+{
+	const float invPi = glm::one_over_pi<float>();
+	float u = std::atan2(dir.z, dir.x) * 0.5f * invPi;
+	if (u < 0.0f)
+		u += 1.0f;
+	const float v = std::acos(glm::clamp(dir.y / glm::length(dir), -1.0f, 1.0f)) * invPi;
+	return glm::vec2(u, v);
+}
+
+VirtualTexture::VirtualTexture(const std::string& path, const int numPages)
+{
+	panoramaPath = path;
+	width = 0;
+	height = 0;
+	numLevels = 0;
+	totalTiles = 0;
+	rootTile = -1;
+	atlasObj = 0;
+	pageTableObj = 0;
+	pagesPerRow = 0;
+	pageTableHeight = 0;
+	pageTableDirty = false;
+	frameIndex = 0;
+	numMissing = 0;
+	stopWorker = false;
+	peakLoadedTiles = 0;
+	numUploads = 0;
+	numEvictions = 0;
+	openMs = 0.0;
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	if (!PrepareTiles(panoramaPath))
+		return;
+	tilePath = GetTilePath(panoramaPath);
+	std::ifstream file(tilePath, std::ios::binary);
+	TileFileHeader header;
+	if (!file.is_open() || !file.read((char*)&header, sizeof(header))) {
+		std::cerr << "[ERROR] Failed to read tile file: " << tilePath << std::endl;
+		return;
+	}
+	width = (int)header.width;
+	height = (int)header.height;
+	numLevels = (int)header.numLevels;
+
+	// Tile layout of every level; the page table stacks the levels vertically.
+	for (int level = 0; level < numLevels; ++level) {
+		const int levelWidth = std::max(1, width >> level);
+		const int levelHeight = std::max(1, height >> level);
+		tilesX.push_back(std::max(1, levelWidth / kTileSize));
+		tilesY.push_back(std::max(1, (levelHeight + kTileSize - 1) / kTileSize));
+		levelFirstTile.push_back(totalTiles);
+		pageTableRows.push_back(pageTableHeight);
+		totalTiles += tilesX[level] * tilesY[level];
+		pageTableHeight += tilesY[level];
+	}
+	rootTile = totalTiles - 1;
+	tileStates.assign(totalTiles, TileState::Absent);
+	tilePages.assign(totalTiles, -1);
+	tileWanted.assign(totalTiles, 0);
+
+	// Page atlas: a fixed grid of slots, no mip levels (the page table picks the level).
+	pagesPerRow = (int)std::ceil(std::sqrt((double)std::max(1, numPages)));
+	const int pageRows = (std::max(1, numPages) + pagesPerRow - 1) / pagesPerRow;
+	pages.resize(pagesPerRow * pageRows);
+	for (auto& page : pages) {
+		page.tile = -1;
+		page.lastUsed = 0;
+	}
+	glGenTextures(1, &atlasObj);
+	glBindTexture(GL_TEXTURE_2D, atlasObj);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, pagesPerRow * kSlotSize, pageRows * kSlotSize, 0, GL_BGR, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	pageTable.assign((size_t)tilesX[0] * pageTableHeight * 4, 0);
+	glGenTextures(1, &pageTableObj);
+	glBindTexture(GL_TEXTURE_2D, pageTableObj);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, tilesX[0], pageTableHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// The coarsest level is a single tile: load it now and keep it, so every lookup has a fallback.
+	LoadedTile root;
+	root.tile = rootTile;
+	if (!ReadTile(file, rootTile, root.pixels)) {
+		std::cerr << "[ERROR] Failed to read tile file: " << tilePath << std::endl;
+		return;
+	}
+	UploadTile(root);
+	RebuildPageTable();
+	TextureResidency::AddFixedBytes(GetGpuBytes());
+
+	worker = std::thread(&VirtualTexture::WorkerLoop, this);
+	const auto end = std::chrono::high_resolution_clock::now();
+	openMs = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+VirtualTexture::~VirtualTexture()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopWorker = true;
+	}
+	requestReady.notify_all();
+	if (worker.joinable())
+		worker.join();
+	if (atlasObj != 0)
+		TextureResidency::RemoveFixedBytes(GetGpuBytes());
+	glDeleteTextures(1, &atlasObj);
+	glDeleteTextures(1, &pageTableObj);
+}
+
+void VirtualTexture::Update(const glm::mat4x4& invViewProj, const int viewportWidth, const int viewportHeight)
+{
+	TRACE_ZONE("Update virtual texture");
+	if (!IsValid())
+		return;
+	++frameIndex;
+
+	missingTiles.clear();
+	MarkVisibleTiles(invViewProj, viewportWidth, viewportHeight);
+	for (int tile = 0; tile < totalTiles; ++tile) {
+		if (tileWanted[tile] == frameIndex && tilePages[tile] < 0)
+			missingTiles.push_back(tile);
+	}
+	numMissing = (int)missingTiles.size();
+	// Coarse tiles first: they replace the blurriest fallbacks and cover the most pixels.
+	std::sort(missingTiles.begin(), missingTiles.end(), [this](const int a, const int b) {
+		int levelA, levelB, x, y;
+		GetTileCoords(a, levelA, x, y);
+		GetTileCoords(b, levelB, x, y);
+		return (levelA != levelB) ? levelA > levelB : a < b;
+	});
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// The queue only holds what the current view needs.
+		for (const int tile : requests) {
+			if (tileStates[tile] == TileState::Queued)
+				tileStates[tile] = TileState::Absent;
+		}
+		requests.clear();
+		for (const int tile : missingTiles) {
+			if (tileStates[tile] == TileState::Absent) {
+				tileStates[tile] = TileState::Queued;
+				requests.push_back(tile);
+			}
+		}
+		const size_t count = std::min(loaded.size(), (size_t)kMaxUploadsPerFrame);
+		for (size_t i = 0; i < count; ++i)
+			uploads.push_back(std::move(loaded[i]));
+		loaded.erase(loaded.begin(), loaded.begin() + count);
+	}
+	requestReady.notify_all();
+
+	for (const auto& tile : uploads)
+		UploadTile(tile);
+	uploads.clear();
+	if (pageTableDirty)
+		RebuildPageTable();
+}
+
+void VirtualTexture::Bind(GLenum atlasUnit, GLenum pageTableUnit)
+{
+	glActiveTexture(atlasUnit);
+	glBindTexture(GL_TEXTURE_2D, atlasObj);
+	glActiveTexture(pageTableUnit);
+	glBindTexture(GL_TEXTURE_2D, pageTableObj);
+}
+
+size_t VirtualTexture::GetGpuBytes() const
+{
+	return pages.size() * kSlotBytes + pageTable.size();
+}
+
+size_t VirtualTexture::GetPeakCpuBytes() const
+{
+	// Loaded tiles waiting for upload, plus the one the worker is reading.
+	return (peakLoadedTiles + 1) * kSlotBytes + pageTable.size();
+}
+
+void VirtualTexture::ShowInfo() const
+{
+	int numResident = 0;
+	for (const auto& page : pages) {
+		if (page.tile >= 0)
+			++numResident;
+	}
+	std::cout << "Virtual texture: " << width << " x " << height << ", " << numLevels << " levels, "
+			  << totalTiles << " tiles of " << kTileSize << " x " << kTileSize << std::endl;
+	std::cout << "Pages: " << numResident << " / " << pages.size() << " resident, " << numUploads << " uploads, "
+			  << numEvictions << " evictions, " << numMissing << " visible tiles missing" << std::endl;
+	std::cout << "Memory: GPU " << GetGpuBytes() / 1024 << " KB, CPU peak " << GetPeakCpuBytes() / 1024
+			  << " KB, opened in " << openMs << " ms" << std::endl;
+}
+
+bool VirtualTexture::PrepareTiles(const std::string& panoramaPath, bool* baked, double* bakeMs)
+{
+	TRACE_ZONE("Bake tiles");
+	const auto start = std::chrono::high_resolution_clock::now();
+	if (baked != nullptr)
+		*baked = false;
+	if (bakeMs != nullptr)
+		*bakeMs = 0.0;
+	uint64_t sourceSize = 0;
+	uint64_t sourceHash = 0;
+	if (!TextureCache::GetSourceKey(panoramaPath, sourceSize, sourceHash)) {
+		std::cerr << "[ERROR] Failed to load skybox panorama: " << panoramaPath << std::endl;
+		return false;
+	}
+
+	// Up to date if it was baked from the same panorama content.
+	{
+		std::ifstream file(GetTilePath(panoramaPath), std::ios::binary);
+		TileFileHeader header;
+		if (file.is_open() && file.read((char*)&header, sizeof(header))
+			&& header.magic == kTileMagic && header.version == kTileVersion && header.tileSize == (uint32_t)kTileSize
+			&& header.sourceSize == sourceSize && header.sourceHash == sourceHash)
+			return true;
+	}
+
+	cv::Mat image = cv::imread(panoramaPath, cv::IMREAD_COLOR);
+	if (image.empty()) {
+		std::cerr << "[ERROR] Failed to load skybox panorama: " << panoramaPath << std::endl;
+		return false;
+	}
+	// Power-of-two sizes keep a tile's ancestors exactly one page table texel each.
+	const int virtualWidth = std::max(kTileSize, RoundToPowerOfTwo(image.cols));
+	const int virtualHeight = RoundToPowerOfTwo(image.rows);
+	if (virtualWidth != image.cols || virtualHeight != image.rows) {
+		cv::Mat resized;
+		const int filter = (virtualWidth < image.cols) ? cv::INTER_AREA : cv::INTER_LINEAR;
+		cv::resize(image, resized, cv::Size(virtualWidth, virtualHeight), 0, 0, filter);
+		image = resized;
+	}
+	int levels = 1;
+	while ((virtualWidth >> (levels - 1)) > kTileSize && levels < kMaxLevels)
+		++levels;
+
+	const std::string tilePath = GetTilePath(panoramaPath);
+	std::ofstream file(tilePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "[WARNING] Failed to write tile file: " << tilePath << std::endl;
+		return false;
+	}
+	// The header goes in last, so an interrupted bake is never taken for a valid file.
+	TileFileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	file.write((const char*)&header, sizeof(header));
+
+	std::vector<unsigned char> slot(kSlotBytes);
+	for (int level = 0; level < levels; ++level) {
+		const int w = image.cols;
+		const int h = image.rows;
+		const int numX = std::max(1, w / kTileSize);
+		const int numY = std::max(1, (h + kTileSize - 1) / kTileSize);
+		for (int ty = 0; ty < numY; ++ty) {
+			for (int tx = 0; tx < numX; ++tx) {
+				// 1 texel border: u wraps around, v clamps at the poles.
+				unsigned char* out = slot.data();
+				for (int j = 0; j < kSlotSize; ++j) {
+					const int y = glm::clamp(ty * kTileSize + j - 1, 0, h - 1);
+					const unsigned char* row = image.ptr<unsigned char>(y);
+					for (int i = 0; i < kSlotSize; ++i, out += 3) {
+						const int x = ((tx * kTileSize + i - 1) % w + w) % w;
+						out[0] = row[3 * x];
+						out[1] = row[3 * x + 1];
+						out[2] = row[3 * x + 2];
+					}
+				}
+				file.write((const char*)slot.data(), (std::streamsize)slot.size());
+			}
+		}
+		if (level + 1 < levels) {
+			cv::Mat next;
+			cv::resize(image, next, cv::Size(std::max(1, w / 2), std::max(1, h / 2)), 0, 0, cv::INTER_AREA);
+			image = next;
+		}
+	}
+
+	header.magic = kTileMagic;
+	header.version = kTileVersion;
+	header.width = (uint32_t)virtualWidth;
+	header.height = (uint32_t)virtualHeight;
+	header.numLevels = (uint32_t)levels;
+	header.tileSize = (uint32_t)kTileSize;
+	header.sourceSize = sourceSize;
+	header.sourceHash = sourceHash;
+	file.seekp(0);
+	file.write((const char*)&header, sizeof(header));
+	if (!file.good()) {
+		std::cerr << "[WARNING] Failed to write tile file: " << tilePath << std::endl;
+		return false;
+	}
+
+	const auto end = std::chrono::high_resolution_clock::now();
+	if (baked != nullptr)
+		*baked = true;
+	if (bakeMs != nullptr)
+		*bakeMs = std::chrono::duration<double, std::milli>(end - start).count();
+	return true;
+}
+
+void VirtualTexture::GetTileCoords(const int tile, int& level, int& tx, int& ty) const
+{
+	level = numLevels - 1;
+	while (level > 0 && levelFirstTile[level] > tile)
+		--level;
+	const int index = tile - levelFirstTile[level];
+	tx = index % tilesX[level];
+	ty = index / tilesX[level];
+}
+
+void VirtualTexture::MarkVisibleTiles(const glm::mat4x4& invViewProj, const int viewportWidth, const int viewportHeight)
+{
+	const int w = std::max(1, viewportWidth);
+	const int h = std::max(1, viewportHeight);
+	const int step = std::max(1, (std::max(w, h) + kFeedbackGrid - 1) / kFeedbackGrid);
+	auto uvAt = [&](const float px, const float py) {
+		const glm::vec4 ray = invViewProj * glm::vec4(2.0f * px / (float)w - 1.0f, 2.0f * py / (float)h - 1.0f, 1.0f, 1.0f);
+		return DirectionToUV(glm::vec3(ray) / ray.w);
+	};
+
+	for (int y = 0; y < h + step - 1; y += step) {
+		for (int x = 0; x < w + step - 1; x += step) {
+			// Sample pixel centers up to the last row and column.
+			const float px = (float)std::min(x, w - 1) + 0.5f;
+			const float py = (float)std::min(y, h - 1) + 0.5f;
+			const glm::vec2 uv = uvAt(px, py);
+			// Level from the texel footprint of one pixel, as the shader computes it.
+			glm::vec2 dx = uvAt(px + 1.0f, py) - uv;
+			glm::vec2 dy = uvAt(px, py + 1.0f) - uv;
+			dx.x -= std::floor(dx.x + 0.5f);
+			dy.x -= std::floor(dy.x + 0.5f);
+			const glm::vec2 size = glm::vec2((float)width, (float)height);
+			const float footprint = std::max(glm::length(dx * size), glm::length(dy * size));
+			const float lod = std::log2(std::max(footprint, 1.0f));
+			const int level = std::min((int)lod, numLevels - 1);
+
+			const int tx = std::min((int)(uv.x * (float)(width >> level)) / kTileSize, tilesX[level] - 1);
+			const int ty = std::min((int)(uv.y * (float)std::max(1, height >> level)) / kTileSize, tilesY[level] - 1);
+			const int tile = GetTileIndex(level, tx, ty);
+			if (tileWanted[tile] == frameIndex)
+				continue;
+			tileWanted[tile] = frameIndex;
+			// Keep the page in use, or the ancestor the shader falls back to.
+			for (int l = level; l < numLevels; ++l) {
+				const int ancestor = GetTileIndex(l, std::min(tx >> (l - level), tilesX[l] - 1),
+												  std::min(ty >> (l - level), tilesY[l] - 1));
+				if (tilePages[ancestor] >= 0) {
+					pages[tilePages[ancestor]].lastUsed = frameIndex;
+					break;
+				}
+			}
+		}
+	}
+	// The root is the last fallback of every tile.
+	pages[tilePages[rootTile]].lastUsed = frameIndex;
+}
+
+void VirtualTexture::UploadTile(const LoadedTile& tile)
+{
+	TRACE_ZONE("Upload tile");
+	const int page = AllocatePage();
+	if (page < 0) {
+		// Every page is in use this frame; the tile is requested again if still visible.
+		tileStates[tile.tile] = TileState::Absent;
+		return;
+	}
+	pages[page].tile = tile.tile;
+	pages[page].lastUsed = frameIndex;
+	tilePages[tile.tile] = page;
+	tileStates[tile.tile] = TileState::Resident;
+
+	glBindTexture(GL_TEXTURE_2D, atlasObj);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, (page % pagesPerRow) * kSlotSize, (page / pagesPerRow) * kSlotSize,
+					kSlotSize, kSlotSize, GL_BGR, GL_UNSIGNED_BYTE, tile.pixels.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	++numUploads;
+	pageTableDirty = true;
+}
+
+int VirtualTexture::AllocatePage()
+{
+	int victim = -1;
+	for (int i = 0; i < (int)pages.size(); ++i) {
+		if (pages[i].tile < 0)
+			return i;
+		if (pages[i].tile == rootTile || pages[i].lastUsed == frameIndex)
+			continue;
+		if (victim < 0 || pages[i].lastUsed < pages[victim].lastUsed)
+			victim = i;
+	}
+	if (victim >= 0) {
+		tilePages[pages[victim].tile] = -1;
+		tileStates[pages[victim].tile] = TileState::Absent;
+		pages[victim].tile = -1;
+		++numEvictions;
+	}
+	return victim;
+}
+
+void VirtualTexture::RebuildPageTable()
+{
+	// Coarse to fine: a tile without a page inherits the entry of its parent.
+	const int tableWidth = tilesX[0];
+	for (int level = numLevels - 1; level >= 0; --level) {
+		for (int ty = 0; ty < tilesY[level]; ++ty) {
+			for (int tx = 0; tx < tilesX[level]; ++tx) {
+				unsigned char* entry = &pageTable[((size_t)(pageTableRows[level] + ty) * tableWidth + tx) * 4];
+				const int page = tilePages[GetTileIndex(level, tx, ty)];
+				if (page >= 0 || level == numLevels - 1) {
+					entry[0] = (unsigned char)(std::max(page, 0) % pagesPerRow);
+					entry[1] = (unsigned char)(std::max(page, 0) / pagesPerRow);
+					entry[2] = (unsigned char)level;
+					entry[3] = 255;
+				}
+				else {
+					const int parentX = std::min(tx / 2, tilesX[level + 1] - 1);
+					const int parentY = std::min(ty / 2, tilesY[level + 1] - 1);
+					const unsigned char* parent = &pageTable[((size_t)(pageTableRows[level + 1] + parentY) * tableWidth + parentX) * 4];
+					std::memcpy(entry, parent, 4);
+				}
+			}
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, pageTableObj);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tableWidth, pageTableHeight, GL_RGBA, GL_UNSIGNED_BYTE, pageTable.data());
+	glBindTexture(GL_TEXTURE_2D, 0);
+	pageTableDirty = false;
+}
+
+bool VirtualTexture::ReadLevel(const int maxWidth, cv::Mat& image) const
+{
+	if (!IsValid())
+		return false;
+	int level = 0;
+	while (level + 1 < numLevels && (width >> level) > maxWidth)
+		++level;
+	const int w = std::max(1, width >> level);
+	const int h = std::max(1, height >> level);
+	image.create(h, w, CV_8UC3);
+
+	std::ifstream file(tilePath, std::ios::binary);
+	std::vector<unsigned char> pixels;
+	for (int ty = 0; ty < tilesY[level]; ++ty) {
+		for (int tx = 0; tx < tilesX[level]; ++tx) {
+			if (!ReadTile(file, GetTileIndex(level, tx, ty), pixels)) {
+				std::cerr << "[ERROR] Failed to read tile file: " << tilePath << std::endl;
+				return false;
+			}
+			const int rows = std::min(kTileSize, h - ty * kTileSize);
+			const int cols = std::min(kTileSize, w - tx * kTileSize);
+			for (int j = 0; j < rows; ++j) {
+				const unsigned char* src = &pixels[((size_t)(j + 1) * kSlotSize + 1) * 3];
+				std::memcpy(image.ptr<unsigned char>(ty * kTileSize + j) + tx * kTileSize * 3, src, (size_t)cols * 3);
+			}
+		}
+	}
+	return true;
+}
+
+bool VirtualTexture::ReadTile(std::ifstream& file, const int tile, std::vector<unsigned char>& pixels)
+{
+	TRACE_ZONE("Read tile");
+	pixels.resize(kSlotBytes);
+	file.seekg((std::streamoff)(sizeof(TileFileHeader) + (size_t)tile * kSlotBytes));
+	return (bool)file.read((char*)pixels.data(), (std::streamsize)kSlotBytes);
+}
+
+void VirtualTexture::WorkerLoop()
+{
+	TRACE_THREAD_NAME("Tile streamer");
+	std::ifstream file(tilePath, std::ios::binary);
+	while (true) {
+		int tile = -1;
+		{
+			// Wait for a request, but do not run ahead of the uploads.
+			std::unique_lock<std::mutex> lock(mutex);
+			requestReady.wait(lock, [this]() {
+				return stopWorker || (!requests.empty() && loaded.size() < (size_t)(2 * kMaxUploadsPerFrame));
+			});
+			if (stopWorker)
+				return;
+			tile = requests.front();
+			requests.pop_front();
+			tileStates[tile] = TileState::Loading;
+		}
+		LoadedTile result;
+		result.tile = tile;
+		const bool ok = ReadTile(file, tile, result.pixels);
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!ok) {
+			std::cerr << "[ERROR] Failed to read tile " << tile << " of " << tilePath << std::endl;
+			tileStates[tile] = TileState::Absent;
+			file.clear();
+			continue;
+		}
+		loaded.push_back(std::move(result));
+		peakLoadedTiles = std::max(peakLoadedTiles, loaded.size());
+	}
+}
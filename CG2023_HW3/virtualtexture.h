@@ -0,0 +1,138 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include "headers.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// VirtualTexture Declarations.
+// Streams a large equirectangular panorama in tiles instead of decoding and uploading it whole.
+// The panorama is baked once into a tile file next to it ("<panorama>.tiles"): a power-of-two
+// mip pyramid cut into kTileSize tiles, each stored with a 1 texel border (u wraps, v clamps)
+// so that tiles filter seamlessly. At run time only the tiles visible from the camera, at the
+// level the shader will read, are loaded by a worker thread and uploaded into a fixed atlas of
+// pages, with the least recently used pages recycled. A page table (one texel per tile of every
+// level) gives the shader the page of a tile, or of its nearest resident ancestor, so there is
+// always something to draw: the single tile of the coarsest level is loaded up front and pinned.
+class VirtualTexture
+{
+public:
+	// VirtualTexture Public Methods.
+	VirtualTexture(const std::string& panoramaPath, const int numPages = kDefaultPages);
+	~VirtualTexture();
+
+	bool IsValid() const { return atlasObj != 0; }
+	// Work out the tiles a view needs (invViewProj maps NDC to skybox space), queue the missing
+	// ones, upload up to kMaxUploadsPerFrame loaded tiles and refresh the page table.
+	void Update(const glm::mat4x4& invViewProj, const int viewportWidth, const int viewportHeight);
+	void Bind(GLenum atlasUnit, GLenum pageTableUnit);
+
+	// Assemble the finest level at most maxWidth wide from the tile file (without the borders).
+	bool ReadLevel(const int maxWidth, cv::Mat& image) const;
+
+	std::string GetPanoramaPath() const { return panoramaPath; }
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	int GetNumLevels() const { return numLevels; }
+	// First page table row of each level.
+	const std::vector<int>& GetPageTableRows() const { return pageTableRows; }
+	// True when every tile the last Update() asked for is resident.
+	bool IsComplete() const { return numMissing == 0; }
+	// Atlas and page table.
+	size_t GetGpuBytes() const;
+	// Largest amount of tile data held on the CPU at once, plus the page table copy.
+	size_t GetPeakCpuBytes() const;
+	double GetOpenTime() const { return openMs; }
+	void ShowInfo() const;
+
+	// Build the tile file of a panorama unless an up-to-date one exists. This is the only
+	// step that decodes the whole image. Returns false on failure.
+	static bool PrepareTiles(const std::string& panoramaPath, bool* baked = nullptr, double* bakeMs = nullptr);
+	static std::string GetTilePath(const std::string& panoramaPath) { return panoramaPath + ".tiles"; }
+
+	static const int kTileSize = 128;
+	static const int kSlotSize = kTileSize + 2;
+	static const int kDefaultPages = 256;
+	static const int kMaxUploadsPerFrame = 8;
+	static const int kMaxLevels = 16;
+
+private:
+	// VirtualTexture Private Types.
+	enum class TileState : uint8_t
+	{
+		Absent,
+		Queued,		// In the request queue.
+		Loading,	// Being read by the worker, or waiting for its upload.
+		Resident
+	};
+	struct Page
+	{
+		int tile;				// -1 if free.
+		unsigned int lastUsed;
+	};
+	struct LoadedTile
+	{
+		int tile;
+		std::vector<unsigned char> pixels;
+	};
+
+	// VirtualTexture Private Methods.
+	int GetTileIndex(const int level, const int tx, const int ty) const {
+		return levelFirstTile[level] + ty * tilesX[level] + tx;
+	}
+	void GetTileCoords(const int tile, int& level, int& tx, int& ty) const;
+	void MarkVisibleTiles(const glm::mat4x4& invViewProj, const int viewportWidth, const int viewportHeight);
+	void UploadTile(const LoadedTile& loaded);
+	int AllocatePage();
+	void RebuildPageTable();
+	static bool ReadTile(std::ifstream& file, const int tile, std::vector<unsigned char>& pixels);
+	void WorkerLoop();
+
+	// VirtualTexture Private Data.
+	std::string panoramaPath;
+	std::string tilePath;
+	int width;
+	int height;
+	int numLevels;
+	int totalTiles;
+	int rootTile;
+	std::vector<int> tilesX;
+	std::vector<int> tilesY;
+	std::vector<int> levelFirstTile;
+	std::vector<int> pageTableRows;
+	std::vector<TileState> tileStates;
+	std::vector<int> tilePages;
+	std::vector<unsigned int> tileWanted;	// Frame in which a view last needed the tile.
+	std::vector<int> missingTiles;			// Scratch lists of Update(), kept to avoid reallocating.
+	std::vector<LoadedTile> uploads;
+
+	GLuint atlasObj;
+	GLuint pageTableObj;
+	int pagesPerRow;
+	std::vector<Page> pages;
+	std::vector<unsigned char> pageTable;
+	int pageTableHeight;
+	bool pageTableDirty;
+	unsigned int frameIndex;
+	int numMissing;
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable requestReady;
+	std::deque<int> requests;
+	std::vector<LoadedTile> loaded;
+	std::atomic<bool> stopWorker;
+
+	// Statistics.
+	size_t peakLoadedTiles;
+	int numUploads;
+	int numEvictions;
+	double openMs;
+};
+
+#endif